@@ -7,10 +7,42 @@
 #include <thread>
 #include "network/tcp.h"
 #include "utils/file_manager.h"
+#include "utils/log_decoder.h"
+#include "utils/log_writer.h"
+#include "utils/delivery_table.h"
+#include "utils/batch_pipeline.h"
+#include "network/protocol.h"
+#include "network/compression.h"
 #include "log.h"
+#include "backend_test.h"
+
+#define BACKEND_TEST 0
 
 namespace fs = std::filesystem;
 
+// the writer's backlog above which clients get no more credit
+constexpr size_t max_backlog_bytes = 64 * 1024 * 1024;
+// a frame announcing more than this is taken as malformed
+constexpr unsigned max_frame_size = 256 * 1024 * 1024;
+
+// tells a framed client how much was taken and how busy the writer is
+void send_ack(SOCKET sock_fd, log_writer& writer, size_t records, unsigned dictionary_id, unsigned long long sequence) {
+    size_t lines, bytes;
+    writer.backlog(lines, bytes);
+
+    network::protocol::ack ack;
+    ack.records_ = static_cast<unsigned>(records);
+    ack.queue_depth_ = static_cast<unsigned>(lines);
+    ack.credit_ = static_cast<unsigned>(bytes < max_backlog_bytes ? max_backlog_bytes - bytes : 0);
+    ack.dictionary_ = dictionary_id;
+    ack.sequence_ = sequence;
+
+    std::string reply;
+    network::protocol::append_ack(reply, ack);
+    if (send(sock_fd, reply.data(), static_cast<int>(reply.size()), 0) == SOCKET_ERROR)
+        LOGD("client left before the ack");
+}
+
 std::string get_current_date() {
     auto now = std::chrono::system_clock::now();
     auto in_time_t = std::chrono::system_clock::to_time_t(now);
@@ -40,8 +72,114 @@ void save_logs(const std::string& logs) {
     }
 }
 
-int main() {
-    network::tcp_server server(8080);
+// reads until size bytes are in or the client closed its side, returns how many came
+size_t recv_up_to(SOCKET sock_fd, char* data, size_t size) {
+    size_t received = 0;
+    while (received < size) {
+        int result = recv(sock_fd, data + received, static_cast<int>(size - received), 0);
+        if (result < 1) break;
+        received += result;
+    }
+    return received;
+}
+
+// completes the frame whose first bytes frame may already hold, false at the end
+// of the connection or on a malformed or truncated frame
+bool read_frame(SOCKET sock_fd, std::string& frame) {
+    network::protocol::frame_header header;
+    size_t have = frame.size();
+    frame.resize(sizeof(header));
+    have += recv_up_to(sock_fd, &frame[have], sizeof(header) - have);
+    if (have == 0)
+        return false;
+
+    memcpy(&header, frame.data(), sizeof(header));
+    if (have < sizeof(header) || !network::protocol::is_framed(frame.data(), frame.size())
+        || header.version_ != network::protocol::version || header.length_ > max_frame_size) {
+        LOGW("client sent a malformed frame header");
+        return false;
+    }
+
+    frame.resize(sizeof(header) + header.length_);
+    if (recv_up_to(sock_fd, &frame[sizeof(header)], header.length_) != header.length_) {
+        LOGW("client sent a truncated frame");
+        return false;
+    }
+    return true;
+}
+
+// batches are written and acked while the connection is still being read,
+// the rest is decoded once the client closed its side
+void serve(SOCKET sock_fd, log_writer& writer, const network::compression::dictionary& dictionary,
+    delivery_table& deliveries) {
+    std::string data(sizeof(network::protocol::magic), '\0');
+    data.resize(recv_up_to(sock_fd, &data[0], data.size()));
+
+    // legacy clients do not read, the connection just closes
+    if (!network::protocol::is_framed(data.data(), data.size())) {
+        constexpr int buffer_size = 1024;
+        char buffer[buffer_size];
+        int result;
+        while ((result = recv(sock_fd, buffer, buffer_size, 0)) > 0)
+            data.append(buffer, result);
+        LOGD("received " << data.size() << " bytes from a legacy client");
+        if (data.empty())
+            return;
+
+        std::vector<log_entry> entries;
+        log_decoder decoder;
+        decoder.decode(data, entries);
+        writer.add(entries);
+        return;
+    }
+
+    batch_pipeline pipeline(writer, deliveries, &dictionary, [&](size_t records, unsigned long long sequence) {
+        send_ack(sock_fd, writer, records, dictionary.id(), sequence);
+    });
+
+    std::string loose; // frames outside a batch
+    while (read_frame(sock_fd, data)) {
+        const network::protocol::frame_header* header = reinterpret_cast<const network::protocol::frame_header*>(data.data());
+        if (header->type_ == network::protocol::frame_type::batch)
+            pipeline.push(std::move(data));
+        else
+            loose += data;
+        data.clear();
+    }
+    pipeline.finish();
+
+    if (!loose.empty()) {
+        std::vector<log_entry> entries;
+        log_decoder decoder(&dictionary);
+        if (!decoder.decode(loose, entries))
+            LOGW("client sent malformed or truncated logs");
+        size_t records = entries.size();
+        writer.add(entries);
+        send_ack(sock_fd, writer, records, dictionary.id(), 0);
+    }
+}
+
+int main(int argc, char* argv[]) {
+#if BACKEND_TEST
+    backend_test();
+    return 0;
+#endif
+
+    // several instances run side by side on different ports
+    unsigned short port = argc > 1 ? static_cast<unsigned short>(std::stoi(argv[1])) : 8080;
+    network::tcp_server server(port);
+
+    // lines from all clients are written in time stamp order within this window; a
+    // batch is acked once it is in the journal, what a crash left there is written first
+    std::chrono::milliseconds reorder_window(argc > 2 ? std::stoi(argv[2]) : 500);
+    log_writer writer(reorder_window, save_logs, "backend-" + std::to_string(port) + ".journal");
+
+    // the compression dictionary clients were given, see network::compression::train
+    network::compression::dictionary dictionary;
+    if (argc > 3 && !dictionary.load(argv[3]))
+        LOGW("failed to load compression dictionary " << argv[3]);
+
+    delivery_table deliveries;
 
     if (!server.listen()) {
         LOGE("failed to start listening");
@@ -50,19 +188,12 @@ int main() {
 
     while (true) {
         SOCKET sock_fd = server.accept();
+        if (sock_fd == INVALID_SOCKET) continue;
         LOGD("new client connected");
         
-        std::thread([=] {
-            std::string logs;
-            while (true) {
-                constexpr int buffer_size = 1024;
-                char buffer[buffer_size] = { 0 };
-                int result = recv(sock_fd, buffer, buffer_size - 1, 0);
-                if (result < 1) break;
-                logs.append(buffer, result);
-            }
-            LOGD("logs from client:\n" << logs);
-            save_logs(logs);
+        std::thread([sock_fd, &writer, &dictionary, &deliveries] {
+            serve(sock_fd, writer, dictionary, deliveries);
+            closesocket(sock_fd);
         }).detach();
     }
 
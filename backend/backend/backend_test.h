@@ -0,0 +1,209 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "utils/batch_pipeline.h"
+#include "utils/delivery_table.h"
+#include "utils/log_decoder.h"
+#include "utils/log_writer.h"
+#include "network/compression.h"
+#include "network/protocol.h"
+#include "logs/level.h"
+
+// one sequenced batch of already formatted lines, as a client sends it
+static std::string make_batch(unsigned long long client_id, unsigned long long sequence, const std::vector<std::string>& lines)
+{
+    std::string batch;
+    size_t frame = network::protocol::begin_batch(batch, client_id, sequence);
+    for (const std::string& line : lines) {
+        size_t text = network::protocol::begin_frame(batch, network::protocol::frame_type::text);
+        batch += line;
+        network::protocol::end_frame(batch, text);
+    }
+    network::protocol::end_frame(batch, frame);
+    return batch;
+}
+
+// one sequenced batch of records of call site 42, defining the site first if define_site
+static std::string make_records_batch(unsigned long long client_id, unsigned long long sequence, size_t records, bool define_site)
+{
+    namespace protocol = network::protocol;
+    std::string batch;
+    size_t frame = protocol::begin_batch(batch, client_id, sequence);
+    if (define_site) {
+        size_t sites = protocol::begin_frame(batch, protocol::frame_type::sites);
+        protocol::put(batch, 42u);
+        protocol::put(batch, static_cast<unsigned char>(logs::level::info));
+        protocol::put(batch, 1u);
+        protocol::put_string(batch, "backend_test.h");
+        protocol::put_string(batch, "backend_test");
+        protocol::put_string(batch, "site defined once");
+        protocol::end_frame(batch, sites);
+    }
+    size_t list = protocol::begin_frame(batch, protocol::frame_type::records);
+    for (size_t i = 0; i < records; i++) {
+        protocol::put(batch, 42u);
+        protocol::put(batch, 1000000000LL);
+        protocol::put(batch, 0u);
+    }
+    protocol::end_frame(batch, list);
+    protocol::end_frame(batch, frame);
+    return batch;
+}
+
+// frames wrapped into one compressed frame without a dictionary
+static std::string make_compressed(const std::string& frames)
+{
+    namespace protocol = network::protocol;
+    std::string compressed;
+    network::compression::compressor compressor;
+    size_t frame = protocol::begin_frame(compressed, protocol::frame_type::compressed);
+    protocol::put(compressed, 0u);
+    protocol::put(compressed, static_cast<unsigned>(frames.size()));
+    compressor.compress(frames.data(), frames.size(), nullptr, compressed);
+    protocol::end_frame(compressed, frame);
+    return compressed;
+}
+
+void backend_test() {
+    std::cout << "==== test for batch_pipeline ====\n";
+
+    std::mutex saved_mutex;
+    std::string saved;
+    log_writer writer(std::chrono::milliseconds(0), [&](const std::string& lines) {
+        std::lock_guard<std::mutex> lock(saved_mutex);
+        saved += lines;
+    });
+    delivery_table deliveries;
+
+    std::vector<std::pair<size_t, unsigned long long>> acks;
+    {
+        batch_pipeline pipeline(writer, deliveries, nullptr, [&](size_t records, unsigned long long sequence) {
+            acks.emplace_back(records, sequence);
+        });
+
+        // the batch frame itself is whole, its last text frame is cut short
+        std::string truncated = make_batch(7, 1, { "first line\n", "second line\n" });
+        truncated.resize(truncated.size() - 5);
+        unsigned length = static_cast<unsigned>(truncated.size() - sizeof(network::protocol::frame_header));
+        memcpy(&truncated[offsetof(network::protocol::frame_header, length_)], &length, sizeof(length));
+        pipeline.push(truncated);
+
+        // the client sends it again in one piece
+        pipeline.push(make_batch(7, 1, { "first line\n", "second line\n" }));
+        pipeline.push(make_batch(7, 1, { "first line\n", "second line\n" }));
+
+        // a connection defines a call site once, later batches on it only use the id
+        pipeline.push(make_records_batch(7, 2, 1, true));
+        pipeline.push(make_records_batch(7, 3, 2, false));
+        pipeline.finish();
+    }
+
+    std::cout << "acks (records, sequence):";
+    for (auto& ack : acks)
+        std::cout << " (" << ack.first << ", " << ack.second << ")";
+    std::cout << " (expected (0, 0) (2, 1) (2, 1) (1, 2) (2, 3))\n";
+
+    std::lock_guard<std::mutex> lock(saved_mutex);
+    size_t first = 0, second = 0;
+    for (size_t at = saved.find("first line"); at != std::string::npos; at = saved.find("first line", at + 1))
+        first++;
+    for (size_t at = saved.find("second line"); at != std::string::npos; at = saved.find("second line", at + 1))
+        second++;
+    std::cout << "written: first line " << first << " times, second line " << second << " times (expected 1, 1)\n";
+
+    size_t defined = 0, unknown = 0;
+    for (size_t at = saved.find("site defined once"); at != std::string::npos; at = saved.find("site defined once", at + 1))
+        defined++;
+    for (size_t at = saved.find("unknown call site"); at != std::string::npos; at = saved.find("unknown call site", at + 1))
+        unknown++;
+    std::cout << "records of a site defined by an earlier batch: " << defined << " rendered, " << unknown << " unknown (expected 3, 0)\n";
+
+    // a batch is acked once it is in the journal, not after the reorder window
+    std::remove("backend_test.journal.0");
+    std::remove("backend_test.journal.1");
+    long long acked_after = -1;
+    size_t journal_bytes = 0;
+    {
+        std::string held;
+        log_writer slow_writer(std::chrono::milliseconds(60000), [&](const std::string& lines) { held += lines; }, "backend_test.journal");
+        delivery_table slow_deliveries;
+        auto started = std::chrono::steady_clock::now();
+        {
+            batch_pipeline pipeline(slow_writer, slow_deliveries, nullptr, [&](size_t records, unsigned long long sequence) {
+                if (sequence)
+                    acked_after = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+            });
+            pipeline.push(make_batch(9, 1, { "journaled line\n" }));
+            pipeline.finish();
+        }
+
+        // what a backend that died now would leave behind
+        std::filesystem::copy_file("backend_test.journal.0", "backend_test_crashed.journal.0",
+            std::filesystem::copy_options::overwrite_existing);
+    }
+    journal_bytes = static_cast<size_t>(std::filesystem::file_size("backend_test.journal.0"));
+    std::cout << "acked after " << acked_after << " ms (expected well under the 60000 ms window), journal after saving "
+        << journal_bytes << " bytes (expected 0)\n";
+
+    // the next start writes what the journal holds
+    std::string replayed;
+    {
+        log_writer next_writer(std::chrono::milliseconds(0), [&](const std::string& lines) { replayed += lines; }, "backend_test_crashed.journal");
+    }
+    std::cout << "replayed from the journal: " << replayed << " (expected journaled line)\n";
+
+    for (const char* path : { "backend_test.journal.0", "backend_test.journal.1", "backend_test_crashed.journal.0", "backend_test_crashed.journal.1" })
+        std::remove(path);
+
+    std::cout << "==== test for delivery_table ====\n";
+    {
+        delivery_table table;
+        for (unsigned long long sequence = 1; sequence <= 5000; sequence++) {
+            table.begin(1, sequence);
+            table.written(1, sequence);
+        }
+        // too old to be remembered: written again rather than taken as delivered
+        bool forgotten_fresh = table.begin(1, 1) == delivery_table::state::fresh;
+        table.abandon(1, 1);
+        bool recent_written = table.begin(1, 5000) == delivery_table::state::written;
+
+        table.begin(2, 1); // still being written
+        table.sweep(std::chrono::steady_clock::now() + std::chrono::hours(1));
+        std::cout << "forgotten batch fresh " << forgotten_fresh << ", recent batch written " << recent_written
+            << " (expected 1 1), clients after an idle hour " << table.clients_count() << " (expected 1, the one writing)\n";
+    }
+
+    std::cout << "==== test for log_decoder ====\n";
+    {
+        namespace protocol = network::protocol;
+        std::string text;
+        size_t frame = protocol::begin_frame(text, protocol::frame_type::text);
+        text += "compressed line\n";
+        protocol::end_frame(text, frame);
+
+        std::string batched;
+        frame = protocol::begin_batch(batched, 5, 1);
+        batched += make_compressed(text);
+        protocol::end_frame(batched, frame);
+
+        std::string batch_in_batch;
+        frame = protocol::begin_batch(batch_in_batch, 5, 2);
+        batch_in_batch += make_batch(5, 3, { "nested line\n" });
+        protocol::end_frame(batch_in_batch, frame);
+
+        std::vector<log_entry> entries;
+        bool compressed_in_batch = log_decoder().decode(batched, entries);
+        bool twice_compressed = log_decoder().decode(make_compressed(make_compressed(text)), entries);
+        bool nested_batch = log_decoder().decode(batch_in_batch, entries);
+        bool batch_in_compressed = log_decoder().decode(make_compressed(make_batch(5, 4, { "hidden line\n" })), entries);
+        std::cout << "compressed in a batch " << compressed_in_batch << " with " << entries.size() << " line"
+            << " (expected 1 with 1), compressed twice " << twice_compressed << ", batch in a batch " << nested_batch
+            << ", batch in compressed " << batch_in_compressed << " (expected 0 0 0)\n";
+    }
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Asynchronous console sink behind the LOG* macros of log.h.
+// Callers push a finished line onto a lock-free queue and return, one writer
+// thread takes everything queued and writes it to stdout in a single fwrite,
+// so threads never wait on the stream lock or on a flush per line.
+namespace console {
+
+    enum level : int { debug, info, warning, error, off };
+
+    class log_sink {
+    private:
+        // the text follows the node in the same allocation
+        struct node {
+            std::atomic<node*> next_{ nullptr };
+            size_t size_ = 0;
+
+            const char* text() const { return reinterpret_cast<const char*>(this + 1); }
+            char* text() { return reinterpret_cast<char*>(this + 1); }
+        };
+
+        // intrusive multi-producer / single-consumer queue, head_ is the newest node
+        std::atomic<node*> head_;
+        node* tail_;
+        node stub_;
+
+        std::atomic<int> level_;
+        std::atomic<bool> sleeping_{ false };
+        std::atomic<bool> stopped_{ false };
+        std::mutex wake_mutex_;
+        std::condition_variable wake_cv_;
+        // once the writer is joined, shutdown and late pushers take turns as the consumer
+        std::mutex drain_mutex_;
+        bool drained_ = false; // guarded by drain_mutex_
+        std::string batch_;
+        std::thread writer_;
+
+        node* pop()
+        {
+            node* tail = tail_;
+            node* next = tail->next_.load(std::memory_order_acquire);
+            if (tail == &stub_) {
+                if (!next) return nullptr;
+                tail_ = tail = next;
+                next = next->next_.load(std::memory_order_acquire);
+            }
+            if (next) {
+                tail_ = next;
+                return tail;
+            }
+
+            // the last node can only go once the stub is behind it
+            if (tail != head_.load(std::memory_order_acquire)) return nullptr; // a push is half done
+            link(&stub_);
+            next = tail->next_.load(std::memory_order_acquire);
+            if (next) {
+                tail_ = next;
+                return tail;
+            }
+            return nullptr;
+        }
+
+        void link(node* n)
+        {
+            n->next_.store(nullptr, std::memory_order_relaxed);
+            node* previous = head_.exchange(n, std::memory_order_acq_rel);
+            previous->next_.store(n, std::memory_order_release);
+        }
+
+        bool empty() const
+        {
+            return tail_ == &stub_ && !stub_.next_.load(std::memory_order_acquire);
+        }
+
+        // returns false when nothing was queued
+        bool write_batch()
+        {
+            batch_.clear();
+            while (node* n = pop()) {
+                batch_.append(n->text(), n->size_);
+                n->~node();
+                ::operator delete(n);
+            }
+            if (batch_.empty()) return false;
+
+            fwrite(batch_.data(), 1, batch_.size(), stdout);
+            fflush(stdout);
+            return true;
+        }
+
+        void run()
+        {
+            while (!stopped_.load(std::memory_order_acquire)) {
+                if (write_batch()) continue;
+
+                // pairs with the fence in push: either it sees sleeping_ or this sees its node
+                std::unique_lock<std::mutex> lock(wake_mutex_);
+                sleeping_.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (empty() && !stopped_.load(std::memory_order_acquire))
+                    wake_cv_.wait_for(lock, std::chrono::milliseconds(100));
+                sleeping_.store(false, std::memory_order_relaxed);
+            }
+            write_batch();
+        }
+
+    public:
+        log_sink(int min_level)
+            : head_(&stub_), tail_(&stub_), level_(min_level)
+        {
+            writer_ = std::thread(&log_sink::run, this);
+        }
+
+        log_sink(const log_sink&) = delete;
+        log_sink& operator=(const log_sink&) = delete;
+
+        bool enabled(int log_level) const
+        {
+            return log_level >= level_.load(std::memory_order_relaxed);
+        }
+
+        void set_level(int log_level)
+        {
+            level_.store(log_level, std::memory_order_relaxed);
+        }
+
+        // one allocation per line: the node carries it to the writer thread, which frees it
+        void push(std::string_view text)
+        {
+            if (stopped_.load(std::memory_order_acquire)) {
+                // after shutdown (static destruction) lines are written directly
+                fwrite(text.data(), 1, text.size(), stdout);
+                return;
+            }
+
+            node* n = new (::operator new(sizeof(node) + text.size())) node;
+            n->size_ = text.size();
+            memcpy(n->text(), text.data(), text.size());
+            link(n);
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (stopped_.load(std::memory_order_relaxed)) {
+                // shutdown started while the line was linked, its last drain may be over;
+                // if it is not, the fences make it see the line
+                std::lock_guard<std::mutex> lock(drain_mutex_);
+                if (drained_) write_batch();
+                return;
+            }
+            if (sleeping_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                wake_cv_.notify_one();
+            }
+        }
+
+        // writes what is queued and stops the writer, later lines go straight to stdout
+        void shutdown()
+        {
+            if (stopped_.exchange(true)) return;
+            // pairs with the fence in push: either it sees stopped_ or the drain below sees its line
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+                wake_cv_.notify_one();
+            }
+            if (writer_.joinable()) writer_.join();
+
+            // lines pushed past the writer's last drain
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            drained_ = true;
+            write_batch();
+        }
+    };
+
+    // the sink is never destroyed, so logging from static destructors stays safe;
+    // the guard only drains it at exit
+    inline log_sink& sink(int min_level = info)
+    {
+        static log_sink* instance = new log_sink(min_level);
+        struct drain_at_exit {
+            ~drain_at_exit() { instance->shutdown(); }
+        };
+        static drain_at_exit guard;
+        return *instance;
+    }
+
+    inline void set_level(level log_level)
+    {
+        sink().set_level(log_level);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// lowest level compiled into the binary: 0 - debug, 1 - info, 2 - warning, 3 - error
+#ifndef LOGS_MIN_LEVEL
+#ifdef _DEBUG
+#define LOGS_MIN_LEVEL 0
+#else
+#define LOGS_MIN_LEVEL 1
+#endif
+#endif
+
+namespace logs {
+	enum class level : unsigned char {
+		debug = 0,
+		info = 1,
+		warning = 2,
+		error = 3,
+	};
+
+	constexpr level min_level = static_cast<level>(LOGS_MIN_LEVEL);
+
+	constexpr bool enabled(level log_level)
+	{
+		return log_level >= min_level;
+	}
+
+	constexpr const char* level_tag(level log_level)
+	{
+		switch (log_level) {
+		case level::debug: return " [D] ";
+		case level::info: return " [I] ";
+		case level::warning: return " [W] ";
+		case level::error: return " [E] ";
+		}
+		return " [?] ";
+	}
+}
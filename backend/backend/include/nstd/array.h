@@ -1,14 +1,42 @@
 #pragma once
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace nstd {
-    template<class T>
+    namespace detail {
+        // moves count constructed elements into raw storage at to, from is left raw
+        template<class T>
+        void relocate(T* from, size_t count, T* to);
+    }
+
+    // Elements live in raw storage: only [0, size()) is constructed, growth moves
+    // them over (copies when the move may throw) and trivially copyable ones are
+    // moved with a single memcpy. Storage comes from Alloc, any std::allocator
+    // compatible allocator such as arena_allocator.
+    template<class T, class Alloc = std::allocator<T>>
     class array {
     private:
+        using traits = std::allocator_traits<Alloc>;
+
         T* data_ = nullptr;
         size_t size_ = 0;
-        size_t capacity_ = 1;
+        size_t capacity_ = 0;
+        Alloc alloc_;
+
+    private:
+        T* allocate(size_t capacity);
+        void deallocate(T* data, size_t capacity);
+
+        void reallocate(size_t capacity);
+        void destroy(size_t from, size_t to);
+        size_t grown_capacity(size_t needed) const;
 
     public:
-        array(size_t size);
+        array(size_t size, const Alloc& alloc = Alloc());
+        explicit array(const Alloc& alloc);
         array();
         ~array();
 
@@ -19,12 +47,27 @@ namespace nstd {
         array& operator=(array&& other) noexcept;
 
         void push_back(const T& value);
+        void push_back(T&& value);
+        template<class... Args>
+        T& emplace_back(Args&&... args);
+        void pop_back();
+
+        // the elements from index on move up / down by one
+        template<class... Args>
+        T& emplace(size_t index, Args&&... args);
+        void erase(size_t index);
 
         void resize(size_t size);
+        void reserve(size_t capacity);
+        void shrink_to_fit();
+        void clear();
 
         size_t size() const;
+        size_t capacity() const;
+        bool empty() const;
 
         T* data() const;
+        Alloc get_allocator() const;
 
         class iterator {
         private:
@@ -39,7 +82,7 @@ namespace nstd {
             }
 
             T& operator*() { return *current_; }
-            T* operator->() { return *current_; }
+            T* operator->() { return current_; }
 
             bool operator==(const iterator& other) const { return current_ == other.current_; }
             bool operator!=(const iterator& other) const { return current_ != other.current_; }
@@ -56,64 +99,131 @@ namespace nstd {
 }
 
 namespace nstd {
-    template<class T>
-    inline array<T>::array()
+    template<class T, class Alloc>
+    inline T* array<T, Alloc>::allocate(size_t capacity)
     {
-        data_ = new T[capacity_]; // capacity_ == 1
+        if (!capacity) return nullptr;
+        return traits::allocate(alloc_, capacity);
     }
 
-    template<class T>
-    inline array<T>::array(size_t size)
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::deallocate(T* data, size_t capacity)
     {
-        capacity_ = size * 2;
-        size_ = size;
-        data_ = new T[capacity_];
+        if (data)
+            traits::deallocate(alloc_, data, capacity);
     }
 
     template<class T>
-    inline array<T>::~array()
+    inline void detail::relocate(T* from, size_t count, T* to)
     {
-        if (data_)
-            delete[] data_;
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            if (count)
+                memcpy(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(T));
+        }
+        else {
+            for (size_t i = 0; i < count; i++) {
+                new (to + i) T(std::move_if_noexcept(from[i]));
+                from[i].~T();
+            }
+        }
     }
-    template<class T>
-    inline array<T>::array(const array<T>& other)
-        : size_(other.size_), capacity_(other.capacity_) {
-        data_ = new T[capacity_];
+
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::reallocate(size_t capacity)
+    {
+        T* new_data = allocate(capacity);
+        detail::relocate(data_, size_, new_data);
+        deallocate(data_, capacity_);
+        data_ = new_data;
+        capacity_ = capacity;
+    }
+
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::destroy(size_t from, size_t to)
+    {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            for (size_t i = from; i < to; i++)
+                data_[i].~T();
+        }
+    }
+
+    template<class T, class Alloc>
+    inline size_t array<T, Alloc>::grown_capacity(size_t needed) const
+    {
+        size_t doubled = capacity_ ? capacity_ * 2 : 4;
+        return doubled > needed ? doubled : needed;
+    }
+
+    template<class T, class Alloc>
+    inline array<T, Alloc>::array()
+    {
+    }
+
+    template<class T, class Alloc>
+    inline array<T, Alloc>::array(size_t size, const Alloc& alloc)
+        : alloc_(alloc)
+    {
+        resize(size);
+    }
+
+    template<class T, class Alloc>
+    inline array<T, Alloc>::array(const Alloc& alloc)
+        : alloc_(alloc)
+    {
+    }
+
+    template<class T, class Alloc>
+    inline array<T, Alloc>::~array()
+    {
+        destroy(0, size_);
+        deallocate(data_, capacity_);
+    }
+    template<class T, class Alloc>
+    inline array<T, Alloc>::array(const array<T, Alloc>& other)
+        : alloc_(traits::select_on_container_copy_construction(other.alloc_)) {
+        data_ = allocate(other.size_);
+        size_ = other.size_;
+        capacity_ = other.size_;
         for (size_t i = 0; i < size_; i++) {
-            data_[i] = other.data_[i];
+            new (data_ + i) T(other.data_[i]);
         }
     }
 
-    template<class T>
-    inline array<T>& array<T>::operator=(const array<T>& other) {
+    template<class T, class Alloc>
+    inline array<T, Alloc>& array<T, Alloc>::operator=(const array<T, Alloc>& other) {
         if (this != &other) {
-            delete[] data_;
-            size_ = other.size_;
-            capacity_ = other.capacity_;
-            data_ = new T[capacity_];
-            for (size_t i = 0; i < size_; i++) {
-                data_[i] = other.data_[i];
+            clear();
+            if (other.size_ > capacity_) {
+                deallocate(data_, capacity_);
+                data_ = allocate(other.size_);
+                capacity_ = other.size_;
+            }
+            for (size_t i = 0; i < other.size_; i++) {
+                new (data_ + i) T(other.data_[i]);
             }
+            size_ = other.size_;
         }
         return *this;
     }
 
-    template<class T>
-    inline array<T>::array(array<T>&& other) noexcept
-        : data_(other.data_), size_(other.size_), capacity_(other.capacity_) {
+    template<class T, class Alloc>
+    inline array<T, Alloc>::array(array<T, Alloc>&& other) noexcept
+        : data_(other.data_), size_(other.size_), capacity_(other.capacity_), alloc_(other.alloc_) {
         other.data_ = nullptr;
         other.size_ = 0;
         other.capacity_ = 0;
     }
 
-    template<class T>
-    inline array<T>& array<T>::operator=(array<T>&& other) noexcept {
+    template<class T, class Alloc>
+    inline array<T, Alloc>& array<T, Alloc>::operator=(array<T, Alloc>&& other) noexcept {
         if (this != &other) {
-            delete[] data_;
+            // the storage moves over with the allocator it came from
+            destroy(0, size_);
+            deallocate(data_, capacity_);
             data_ = other.data_;
             size_ = other.size_;
             capacity_ = other.capacity_;
+            alloc_ = other.alloc_;
             other.data_ = nullptr;
             other.size_ = 0;
             other.capacity_ = 0;
@@ -122,71 +232,145 @@ namespace nstd {
     }
 
 
-    template<class T>
-    inline void array<T>::push_back(const T& value)
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::push_back(const T& value)
     {
-        if (size_ >= capacity_)
-        {
-            capacity_ = capacity_ * 2;
-            T* newData = new T[capacity_];
+        emplace_back(value);
+    }
 
-            for (size_t i = 0; i < size_; i++) {
-                newData[i] = data_[i];
-            }
-            delete[] data_;
-            data_ = newData;
-        }
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::push_back(T&& value)
+    {
+        emplace_back(std::move(value));
+    }
 
-        data_[size_++] = value;
+    template<class T, class Alloc>
+    template<class... Args>
+    inline T& array<T, Alloc>::emplace_back(Args&&... args)
+    {
+        if (size_ < capacity_)
+            return *new (data_ + size_++) T(std::forward<Args>(args)...);
+
+        // the new element first: args may point into the elements about to move
+        size_t capacity = grown_capacity(size_ + 1);
+        T* new_data = allocate(capacity);
+        T* created = new (new_data + size_) T(std::forward<Args>(args)...);
+        detail::relocate(data_, size_, new_data);
+        deallocate(data_, capacity_);
+        data_ = new_data;
+        capacity_ = capacity;
+        size_++;
+        return *created;
     }
 
-    template<class T>
-    inline void array<T>::resize(size_t size)
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::pop_back()
     {
-        if (size > capacity_) {
-            capacity_ = size * 2;
-            T* newData = new T[capacity_];
-            size_t copy_size;
+        destroy(size_ - 1, size_);
+        size_--;
+    }
 
-            if (size > size_) {
-                copy_size = size_;
-            }
-            else {
-                copy_size = size;
-            }
+    template<class T, class Alloc>
+    template<class... Args>
+    inline T& array<T, Alloc>::emplace(size_t index, Args&&... args)
+    {
+        if (index == size_)
+            return emplace_back(std::forward<Args>(args)...);
+
+        // built first, args may refer to an element that is about to move
+        T value(std::forward<Args>(args)...);
+        emplace_back(std::move(data_[size_ - 1]));
+        for (size_t i = size_ - 2; i > index; i--)
+            data_[i] = std::move(data_[i - 1]);
+        data_[index] = std::move(value);
+        return data_[index];
+    }
 
-            for (size_t i = 0; i < copy_size; i++) {
-                newData[i] = data_[i];
-            }
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::erase(size_t index)
+    {
+        for (size_t i = index + 1; i < size_; i++)
+            data_[i - 1] = std::move(data_[i]);
+        pop_back();
+    }
+
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::resize(size_t size)
+    {
+        if (size > capacity_)
+            reallocate(grown_capacity(size));
 
-            delete[] data_;
-            data_ = newData;
+        if (size > size_) {
+            for (size_t i = size_; i < size; i++)
+                new (data_ + i) T();
+        }
+        else {
+            destroy(size, size_);
         }
 
         size_ = size;
     }
 
-    template<class T>
-    inline T& array<T>::operator[](size_t index)
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::reserve(size_t capacity)
+    {
+        if (capacity > capacity_)
+            reallocate(capacity);
+    }
+
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::shrink_to_fit()
+    {
+        if (size_ < capacity_)
+            reallocate(size_);
+    }
+
+    template<class T, class Alloc>
+    inline void array<T, Alloc>::clear()
+    {
+        destroy(0, size_);
+        size_ = 0;
+    }
+
+    template<class T, class Alloc>
+    inline T& array<T, Alloc>::operator[](size_t index)
     {
         return data_[index];
     }
 
-    template<class T>
-    inline const T& array<T>::operator[](size_t index) const
+    template<class T, class Alloc>
+    inline const T& array<T, Alloc>::operator[](size_t index) const
     {
         return data_[index];
     }
 
-    template<class T>
-    inline size_t array<T>::size() const
+    template<class T, class Alloc>
+    inline size_t array<T, Alloc>::size() const
     {
         return size_;
     }
 
-    template<class T>
-    T* array<T>::data() const
+    template<class T, class Alloc>
+    inline size_t array<T, Alloc>::capacity() const
+    {
+        return capacity_;
+    }
+
+    template<class T, class Alloc>
+    inline bool array<T, Alloc>::empty() const
+    {
+        return size_ == 0;
+    }
+
+    template<class T, class Alloc>
+    T* array<T, Alloc>::data() const
     {
         return data_;
     }
-}
\ No newline at end of file
+
+    template<class T, class Alloc>
+    inline Alloc array<T, Alloc>::get_allocator() const
+    {
+        return alloc_;
+    }
+}
@@ -0,0 +1,302 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include "array.h"
+#include "hash.h"
+#include "pair.h"
+
+namespace nstd {
+    namespace detail {
+        // index of the first of count sorted keys that is not less than key. The
+        // loop always runs log2(count) times and picks the half with a conditional
+        // move, so there is no branch to mispredict on a random lookup.
+        template<class K, class Q, class Compare>
+        size_t branchless_lower_bound(const K* keys, size_t count, const Q& key, const Compare& compare);
+    }
+
+    // Map for small, read-mostly tables: keys sorted in one nstd::array and values
+    // in another at the same index, so a lookup only walks the keys and iteration
+    // is two linear scans. Inserting or erasing one key moves everything after it;
+    // bulk construction sorts once. With a transparent Compare (std::less<>)
+    // lookups take any key type Compare accepts.
+    template<class K, class V, class Compare = std::less<K>>
+    class flat_map {
+    private:
+        array<K> keys_;
+        array<V> values_;
+        Compare compare_;
+
+    private:
+        template<class Q>
+        size_t index_of(const Q& key) const;
+        template<class Q>
+        size_t position_of(const Q& key) const;
+        void assign_sorted(array<pair<K, V>>& items);
+
+    public:
+        class iterator {
+        private:
+            flat_map* map_;
+            size_t index_;
+
+        public:
+            // what an iterator points at, built on the fly from the two arrays
+            struct entry {
+                const K& key_;
+                V& value_;
+                entry* operator->() { return this; }
+            };
+
+            iterator(flat_map* map, size_t index) : map_(map), index_(index) {}
+
+            iterator& operator++() {
+                ++index_;
+                return *this;
+            }
+
+            entry operator*() { return entry{ map_->keys_[index_], map_->values_[index_] }; }
+            entry operator->() { return **this; }
+
+            bool operator==(const iterator& other) const { return index_ == other.index_; }
+            bool operator!=(const iterator& other) const { return index_ != other.index_; }
+        };
+
+    public:
+        flat_map();
+        // unsorted input, a repeated key keeps its first value
+        flat_map(std::initializer_list<pair<K, V>> items);
+        template<class It>
+        flat_map(It first, It last);
+
+        V& at(const K& key);
+        V& operator[](const K& key);
+
+        bool insert(const K& key, const V& value);
+        bool insert(const pair<K, V>& item);
+        // merges a whole batch with one sort instead of shifting per key
+        template<class It>
+        void insert(It first, It last);
+        bool erase(const K& key);
+        void clear();
+        void reserve(size_t size);
+
+        V* find(const K& key);
+        bool contains(const K& key) const;
+
+        template<class Q, class C = Compare, class = std::enable_if_t<is_transparent<C>::value>>
+        V* find(const Q& key);
+        template<class Q, class C = Compare, class = std::enable_if_t<is_transparent<C>::value>>
+        bool contains(const Q& key) const;
+
+        size_t size() const;
+        bool empty() const;
+
+        // the sorted keys and their values, index i of one belongs to index i of the other
+        const array<K>& keys() const;
+        const array<V>& values() const;
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, keys_.size()); }
+    };
+}
+
+namespace nstd {
+    template<class K, class Q, class Compare>
+    inline size_t detail::branchless_lower_bound(const K* keys, size_t count, const Q& key, const Compare& compare)
+    {
+        if (!count) return 0;
+
+        const K* base = keys;
+        while (count > 1) {
+            size_t half = count / 2;
+            base = compare(base[half], key) ? base + half : base;
+            count -= half;
+        }
+        return static_cast<size_t>(base - keys) + compare(*base, key);
+    }
+
+    template<class K, class V, class Compare>
+    template<class Q>
+    inline size_t flat_map<K, V, Compare>::position_of(const Q& key) const
+    {
+        return detail::branchless_lower_bound(keys_.data(), keys_.size(), key, compare_);
+    }
+
+    // the index of key, or size() when it is missing
+    template<class K, class V, class Compare>
+    template<class Q>
+    inline size_t flat_map<K, V, Compare>::index_of(const Q& key) const
+    {
+        size_t position = position_of(key);
+        if (position < keys_.size() && !compare_(key, keys_[position]))
+            return position;
+        return keys_.size();
+    }
+
+    template<class K, class V, class Compare>
+    inline void flat_map<K, V, Compare>::assign_sorted(array<pair<K, V>>& items)
+    {
+        // stable, so of equal keys the one that came first stays in front and is kept
+        std::stable_sort(items.data(), items.data() + items.size(), [this](const pair<K, V>& left, const pair<K, V>& right) {
+            return compare_(left.key_, right.key_);
+        });
+
+        keys_.clear();
+        values_.clear();
+        keys_.reserve(items.size());
+        values_.reserve(items.size());
+        for (size_t i = 0; i < items.size(); i++) {
+            if (i && !compare_(items[i - 1].key_, items[i].key_))
+                continue;
+            keys_.push_back(std::move(items[i].key_));
+            values_.push_back(std::move(items[i].value_));
+        }
+    }
+
+    template<class K, class V, class Compare>
+    inline flat_map<K, V, Compare>::flat_map()
+    {
+    }
+
+    template<class K, class V, class Compare>
+    inline flat_map<K, V, Compare>::flat_map(std::initializer_list<pair<K, V>> items)
+        : flat_map(items.begin(), items.end())
+    {
+    }
+
+    template<class K, class V, class Compare>
+    template<class It>
+    inline flat_map<K, V, Compare>::flat_map(It first, It last)
+    {
+        insert(first, last);
+    }
+
+    template<class K, class V, class Compare>
+    inline V& flat_map<K, V, Compare>::at(const K& key)
+    {
+        size_t position = position_of(key);
+        if (position == keys_.size() || compare_(key, keys_[position])) {
+            keys_.emplace(position, key);
+            values_.emplace(position);
+        }
+        return values_[position];
+    }
+
+    template<class K, class V, class Compare>
+    inline V& flat_map<K, V, Compare>::operator[](const K& key)
+    {
+        return at(key);
+    }
+
+    template<class K, class V, class Compare>
+    inline bool flat_map<K, V, Compare>::insert(const K& key, const V& value)
+    {
+        size_t position = position_of(key);
+        if (position < keys_.size() && !compare_(key, keys_[position]))
+            return false;
+
+        keys_.emplace(position, key);
+        values_.emplace(position, value);
+        return true;
+    }
+
+    template<class K, class V, class Compare>
+    inline bool flat_map<K, V, Compare>::insert(const pair<K, V>& item)
+    {
+        return insert(item.key_, item.value_);
+    }
+
+    template<class K, class V, class Compare>
+    template<class It>
+    inline void flat_map<K, V, Compare>::insert(It first, It last)
+    {
+        // the keys already here go first so that they win over repeats in the batch
+        array<pair<K, V>> items;
+        items.reserve(keys_.size());
+        for (size_t i = 0; i < keys_.size(); i++)
+            items.emplace_back(keys_[i], values_[i]);
+        for (; first != last; ++first)
+            items.emplace_back(*first);
+        assign_sorted(items);
+    }
+
+    template<class K, class V, class Compare>
+    inline bool flat_map<K, V, Compare>::erase(const K& key)
+    {
+        size_t index = index_of(key);
+        if (index == keys_.size()) return false;
+
+        keys_.erase(index);
+        values_.erase(index);
+        return true;
+    }
+
+    template<class K, class V, class Compare>
+    inline void flat_map<K, V, Compare>::clear()
+    {
+        keys_.clear();
+        values_.clear();
+    }
+
+    template<class K, class V, class Compare>
+    inline void flat_map<K, V, Compare>::reserve(size_t size)
+    {
+        keys_.reserve(size);
+        values_.reserve(size);
+    }
+
+    template<class K, class V, class Compare>
+    inline V* flat_map<K, V, Compare>::find(const K& key)
+    {
+        size_t index = index_of(key);
+        return index == keys_.size() ? nullptr : &values_[index];
+    }
+
+    template<class K, class V, class Compare>
+    inline bool flat_map<K, V, Compare>::contains(const K& key) const
+    {
+        return index_of(key) != keys_.size();
+    }
+
+    template<class K, class V, class Compare>
+    template<class Q, class C, class>
+    inline V* flat_map<K, V, Compare>::find(const Q& key)
+    {
+        size_t index = index_of(key);
+        return index == keys_.size() ? nullptr : &values_[index];
+    }
+
+    template<class K, class V, class Compare>
+    template<class Q, class C, class>
+    inline bool flat_map<K, V, Compare>::contains(const Q& key) const
+    {
+        return index_of(key) != keys_.size();
+    }
+
+    template<class K, class V, class Compare>
+    inline size_t flat_map<K, V, Compare>::size() const
+    {
+        return keys_.size();
+    }
+
+    template<class K, class V, class Compare>
+    inline bool flat_map<K, V, Compare>::empty() const
+    {
+        return keys_.empty();
+    }
+
+    template<class K, class V, class Compare>
+    inline const array<K>& flat_map<K, V, Compare>::keys() const
+    {
+        return keys_;
+    }
+
+    template<class K, class V, class Compare>
+    inline const array<V>& flat_map<K, V, Compare>::values() const
+    {
+        return values_;
+    }
+}
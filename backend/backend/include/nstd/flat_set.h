@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <type_traits>
+#include "array.h"
+#include "flat_map.h"
+#include "hash.h"
+
+namespace nstd {
+
+    // flat_map without values: the sorted keys in one nstd::array, searched with
+    // the same branchless lower bound and iterated in order.
+    template<class K, class Compare = std::less<K>>
+    class flat_set {
+    private:
+        array<K> keys_;
+        Compare compare_;
+
+    private:
+        template<class Q>
+        size_t index_of(const Q& key) const;
+        template<class Q>
+        size_t position_of(const Q& key) const;
+        void sort_unique();
+
+    public:
+        flat_set();
+        // unsorted input, repeats are dropped
+        flat_set(std::initializer_list<K> keys);
+        template<class It>
+        flat_set(It first, It last);
+
+        bool insert(const K& key);
+        template<class It>
+        void insert(It first, It last);
+        bool erase(const K& key);
+        void clear();
+        void reserve(size_t size);
+
+        bool contains(const K& key) const;
+        template<class Q, class C = Compare, class = std::enable_if_t<is_transparent<C>::value>>
+        bool contains(const Q& key) const;
+
+        size_t size() const;
+        bool empty() const;
+
+        const K* begin() const { return keys_.data(); }
+        const K* end() const { return keys_.data() + keys_.size(); }
+    };
+}
+
+namespace nstd {
+    template<class K, class Compare>
+    template<class Q>
+    inline size_t flat_set<K, Compare>::position_of(const Q& key) const
+    {
+        return detail::branchless_lower_bound(keys_.data(), keys_.size(), key, compare_);
+    }
+
+    template<class K, class Compare>
+    template<class Q>
+    inline size_t flat_set<K, Compare>::index_of(const Q& key) const
+    {
+        size_t position = position_of(key);
+        if (position < keys_.size() && !compare_(key, keys_[position]))
+            return position;
+        return keys_.size();
+    }
+
+    template<class K, class Compare>
+    inline void flat_set<K, Compare>::sort_unique()
+    {
+        K* first = keys_.data();
+        std::sort(first, first + keys_.size(), compare_);
+
+        size_t kept = 0;
+        for (size_t i = 0; i < keys_.size(); i++) {
+            if (kept && !compare_(first[kept - 1], first[i]))
+                continue;
+            if (kept != i)
+                first[kept] = std::move(first[i]);
+            kept++;
+        }
+        while (keys_.size() > kept)
+            keys_.pop_back();
+    }
+
+    template<class K, class Compare>
+    inline flat_set<K, Compare>::flat_set()
+    {
+    }
+
+    template<class K, class Compare>
+    inline flat_set<K, Compare>::flat_set(std::initializer_list<K> keys)
+        : flat_set(keys.begin(), keys.end())
+    {
+    }
+
+    template<class K, class Compare>
+    template<class It>
+    inline flat_set<K, Compare>::flat_set(It first, It last)
+    {
+        insert(first, last);
+    }
+
+    template<class K, class Compare>
+    inline bool flat_set<K, Compare>::insert(const K& key)
+    {
+        size_t position = position_of(key);
+        if (position < keys_.size() && !compare_(key, keys_[position]))
+            return false;
+
+        keys_.emplace(position, key);
+        return true;
+    }
+
+    template<class K, class Compare>
+    template<class It>
+    inline void flat_set<K, Compare>::insert(It first, It last)
+    {
+        for (; first != last; ++first)
+            keys_.push_back(*first);
+        sort_unique();
+    }
+
+    template<class K, class Compare>
+    inline bool flat_set<K, Compare>::erase(const K& key)
+    {
+        size_t index = index_of(key);
+        if (index == keys_.size()) return false;
+
+        keys_.erase(index);
+        return true;
+    }
+
+    template<class K, class Compare>
+    inline void flat_set<K, Compare>::clear()
+    {
+        keys_.clear();
+    }
+
+    template<class K, class Compare>
+    inline void flat_set<K, Compare>::reserve(size_t size)
+    {
+        keys_.reserve(size);
+    }
+
+    template<class K, class Compare>
+    inline bool flat_set<K, Compare>::contains(const K& key) const
+    {
+        return index_of(key) != keys_.size();
+    }
+
+    template<class K, class Compare>
+    template<class Q, class C, class>
+    inline bool flat_set<K, Compare>::contains(const Q& key) const
+    {
+        return index_of(key) != keys_.size();
+    }
+
+    template<class K, class Compare>
+    inline size_t flat_set<K, Compare>::size() const
+    {
+        return keys_.size();
+    }
+
+    template<class K, class Compare>
+    inline bool flat_set<K, Compare>::empty() const
+    {
+        return keys_.empty();
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace nstd {
+
+    // std::hash unless a key type needs something else. std::string keys hash
+    // through string_view, which gives the same value, so a lookup can pass a
+    // string_view or a const char* straight from a network buffer and no
+    // temporary std::string gets built.
+    template<class K>
+    struct hash {
+        size_t operator()(const K& key) const { return std::hash<K>{}(key); }
+    };
+
+    template<>
+    struct hash<std::string> {
+        using is_transparent = void;
+
+        size_t operator()(std::string_view key) const { return std::hash<std::string_view>{}(key); }
+    };
+
+    // a Hash with is_transparent takes lookup keys of other types than the key type
+    template<class Hash, class = void>
+    struct is_transparent : std::false_type {};
+
+    template<class Hash>
+    struct is_transparent<Hash, std::void_t<typename Hash::is_transparent>> : std::true_type {};
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "ring_wait.h"
+
+namespace nstd {
+
+    // Bounded queue for any number of producers and consumers (Vyukov's array
+    // queue). Every cell carries a sequence number: a cell is free for the
+    // producer that claims position pos when its sequence is pos, and holds that
+    // producer's element once it is pos + 1. Claiming is one compare-exchange on
+    // the shared position, so threads never wait for each other unless the ring
+    // is full or empty. A batch claims the run of ready cells in front of it with
+    // that same single compare-exchange and notifies once.
+    template<class T, class Wait = spin_wait>
+    class mpmc_ring {
+    private:
+        struct cell {
+            std::atomic<size_t> sequence_;
+            union {
+                T value_;
+            };
+
+            cell() {}
+            ~cell() {}
+        };
+
+        cell* cells_;
+        size_t mask_;
+
+        alignas(cache_line) std::atomic<size_t> enqueue_{ 0 };
+        Wait not_empty_;
+
+        alignas(cache_line) std::atomic<size_t> dequeue_{ 0 };
+        Wait not_full_;
+
+    private:
+        // claims up to want cells from pos on, 0 when the ring is full / empty
+        size_t claim_push(size_t& pos, size_t want);
+        size_t claim_pop(size_t& pos, size_t want);
+        bool has_room() const;
+        bool has_elements() const;
+
+    public:
+        // capacity is rounded up to a power of two, at least 2
+        explicit mpmc_ring(size_t capacity);
+        ~mpmc_ring();
+
+        mpmc_ring(const mpmc_ring& other) = delete;
+        mpmc_ring& operator=(const mpmc_ring& other) = delete;
+
+        bool try_push(const T& value);
+        bool try_push(T&& value);
+        // moves out the first items that fit, returns how many
+        size_t try_push_n(T* items, size_t count);
+        void push(const T& value);
+        void push(T&& value);
+        void push_n(T* items, size_t count);
+
+        bool try_pop(T& out);
+        size_t try_pop_n(T* out, size_t max);
+        void pop(T& out);
+        // waits for at least one element
+        size_t pop_n(T* out, size_t max);
+
+        // a snapshot, stale as soon as it returns
+        size_t size() const;
+        bool empty() const;
+        size_t capacity() const;
+    };
+}
+
+namespace nstd {
+    template<class T, class Wait>
+    inline mpmc_ring<T, Wait>::mpmc_ring(size_t capacity)
+    {
+        size_t rounded = 2;
+        while (rounded < capacity)
+            rounded *= 2;
+        cells_ = new cell[rounded];
+        mask_ = rounded - 1;
+        for (size_t i = 0; i < rounded; i++)
+            cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+
+    template<class T, class Wait>
+    inline mpmc_ring<T, Wait>::~mpmc_ring()
+    {
+        size_t enqueue = enqueue_.load(std::memory_order_relaxed);
+        for (size_t i = dequeue_.load(std::memory_order_relaxed); i != enqueue; i++)
+            cells_[i & mask_].value_.~T();
+        delete[] cells_;
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::claim_push(size_t& pos, size_t want)
+    {
+        pos = enqueue_.load(std::memory_order_relaxed);
+        for (;;) {
+            // a cell whose sequence is its position stays free until enqueue_ passes it,
+            // so the run counted here is still free if the exchange succeeds
+            size_t free = 0;
+            while (free < want && cells_[(pos + free) & mask_].sequence_.load(std::memory_order_acquire) == pos + free)
+                free++;
+
+            if (free) {
+                if (enqueue_.compare_exchange_weak(pos, pos + free, std::memory_order_relaxed))
+                    return free;
+                continue; // pos was reloaded by the exchange
+            }
+
+            size_t sequence = cells_[pos & mask_].sequence_.load(std::memory_order_acquire);
+            if (static_cast<ptrdiff_t>(sequence - pos) < 0)
+                return 0; // the consumer of the previous lap is not done with it
+            pos = enqueue_.load(std::memory_order_relaxed);
+        }
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::claim_pop(size_t& pos, size_t want)
+    {
+        pos = dequeue_.load(std::memory_order_relaxed);
+        for (;;) {
+            size_t ready = 0;
+            while (ready < want && cells_[(pos + ready) & mask_].sequence_.load(std::memory_order_acquire) == pos + ready + 1)
+                ready++;
+
+            if (ready) {
+                if (dequeue_.compare_exchange_weak(pos, pos + ready, std::memory_order_relaxed))
+                    return ready;
+                continue;
+            }
+
+            size_t sequence = cells_[pos & mask_].sequence_.load(std::memory_order_acquire);
+            if (static_cast<ptrdiff_t>(sequence - (pos + 1)) < 0)
+                return 0; // its producer has not published yet
+            pos = dequeue_.load(std::memory_order_relaxed);
+        }
+    }
+
+    template<class T, class Wait>
+    inline bool mpmc_ring<T, Wait>::has_room() const
+    {
+        size_t pos = enqueue_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence_.load(std::memory_order_acquire) == pos;
+    }
+
+    template<class T, class Wait>
+    inline bool mpmc_ring<T, Wait>::has_elements() const
+    {
+        size_t pos = dequeue_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence_.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    template<class T, class Wait>
+    inline bool mpmc_ring<T, Wait>::try_push(const T& value)
+    {
+        T copy(value);
+        return try_push_n(&copy, 1) == 1;
+    }
+
+    template<class T, class Wait>
+    inline bool mpmc_ring<T, Wait>::try_push(T&& value)
+    {
+        return try_push_n(&value, 1) == 1;
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::try_push_n(T* items, size_t count)
+    {
+        size_t pushed = 0;
+        while (pushed < count) {
+            size_t pos;
+            size_t claimed = claim_push(pos, count - pushed);
+            if (!claimed) break;
+
+            for (size_t i = 0; i < claimed; i++) {
+                cell& target = cells_[(pos + i) & mask_];
+                new (&target.value_) T(std::move(items[pushed++]));
+                target.sequence_.store(pos + i + 1, std::memory_order_release);
+            }
+        }
+        if (pushed)
+            not_empty_.notify();
+        return pushed;
+    }
+
+    template<class T, class Wait>
+    inline void mpmc_ring<T, Wait>::push(const T& value)
+    {
+        T copy(value);
+        push_n(&copy, 1);
+    }
+
+    template<class T, class Wait>
+    inline void mpmc_ring<T, Wait>::push(T&& value)
+    {
+        push_n(&value, 1);
+    }
+
+    template<class T, class Wait>
+    inline void mpmc_ring<T, Wait>::push_n(T* items, size_t count)
+    {
+        while (count) {
+            size_t pushed = try_push_n(items, count);
+            items += pushed;
+            count -= pushed;
+            if (count)
+                not_full_.wait_until([this] { return has_room(); });
+        }
+    }
+
+    template<class T, class Wait>
+    inline bool mpmc_ring<T, Wait>::try_pop(T& out)
+    {
+        return try_pop_n(&out, 1) == 1;
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::try_pop_n(T* out, size_t max)
+    {
+        size_t popped = 0;
+        while (popped < max) {
+            size_t pos;
+            size_t claimed = claim_pop(pos, max - popped);
+            if (!claimed) break;
+
+            for (size_t i = 0; i < claimed; i++) {
+                cell& target = cells_[(pos + i) & mask_];
+                out[popped++] = std::move(target.value_);
+                target.value_.~T();
+                // free for the producer one lap later
+                target.sequence_.store(pos + i + mask_ + 1, std::memory_order_release);
+            }
+        }
+        if (popped)
+            not_full_.notify();
+        return popped;
+    }
+
+    template<class T, class Wait>
+    inline void mpmc_ring<T, Wait>::pop(T& out)
+    {
+        pop_n(&out, 1);
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::pop_n(T* out, size_t max)
+    {
+        if (!max) return 0;
+
+        size_t popped = try_pop_n(out, max);
+        while (!popped) {
+            not_empty_.wait_until([this] { return has_elements(); });
+            popped = try_pop_n(out, max);
+        }
+        return popped;
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::size() const
+    {
+        size_t dequeue = dequeue_.load(std::memory_order_acquire);
+        size_t enqueue = enqueue_.load(std::memory_order_acquire);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    template<class T, class Wait>
+    inline bool mpmc_ring<T, Wait>::empty() const
+    {
+        return size() == 0;
+    }
+
+    template<class T, class Wait>
+    inline size_t mpmc_ring<T, Wait>::capacity() const
+    {
+        return mask_ + 1;
+    }
+}
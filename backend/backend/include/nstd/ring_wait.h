@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NSTD_RING_PAUSE() _mm_pause()
+#else
+#define NSTD_RING_PAUSE() std::this_thread::yield()
+#endif
+
+namespace nstd {
+
+    // indices written by different threads sit this far apart so they never share a line
+    constexpr size_t cache_line = 64;
+
+    // How a ring waits for room or for elements. wait_until(ready) returns once
+    // ready() holds; notify() is called by the other side after every publish.
+
+    // Burns the core: pause for a while, then yield. Lowest latency, for threads
+    // that own a core anyway, like the recv threads.
+    struct spin_wait {
+        template<class Ready>
+        void wait_until(Ready ready)
+        {
+            for (unsigned attempt = 0; !ready(); attempt++) {
+                if (attempt < 64)
+                    NSTD_RING_PAUSE();
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        void notify() {}
+    };
+
+    // Spins briefly, then sleeps on a condition variable. notify() stays a fence
+    // and a load as long as nobody sleeps, the mutex is only taken to wake someone.
+    struct blocking_wait {
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::atomic<unsigned> sleepers_{ 0 };
+
+        template<class Ready>
+        void wait_until(Ready ready)
+        {
+            for (unsigned attempt = 0; attempt < 64; attempt++) {
+                if (ready()) return;
+                NSTD_RING_PAUSE();
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            sleepers_.fetch_add(1, std::memory_order_relaxed);
+            // pairs with the fence in notify(): either ready() sees the publish or notify sees the sleeper
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            while (!ready())
+                wake_.wait(lock);
+            sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void notify()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                wake_.notify_all();
+            }
+        }
+    };
+}
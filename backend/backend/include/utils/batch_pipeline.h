@@ -0,0 +1,67 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "utils/log_decoder.h"
+#include "utils/log_writer.h"
+#include "utils/delivery_table.h"
+#include "network/compression.h"
+
+// Serves the batches of one connection in three stages on threads of their own:
+// the connection's thread reads batch frames off the socket and pushes them, a
+// parser decodes them and hands the lines to the writer's journal, an acker acks
+// each batch the writer took (a retransmit another connection is still handing over
+// waits for it). While one batch is being journaled the next one is decoded and a
+// third one read, so network, CPU and disk overlap instead of taking turns, and a
+// client may keep a window of batches in flight on one connection.
+class batch_pipeline {
+public:
+    // answers one batch, sequence 0 - not written, the client sends it again
+    using ack_function = std::function<void(size_t records, unsigned long long sequence)>;
+
+    batch_pipeline(log_writer& writer, delivery_table& deliveries,
+        const network::compression::dictionary* dictionary, ack_function ack);
+    ~batch_pipeline();
+
+    batch_pipeline(const batch_pipeline&) = delete;
+    batch_pipeline& operator=(const batch_pipeline&) = delete;
+
+    // takes one whole batch frame, blocks while the parser is max_queued batches behind
+    void push(std::string frame);
+    // returns once every pushed batch is acked
+    void finish();
+
+private:
+    static constexpr size_t max_queued = 16;
+
+    struct parsed_batch {
+        unsigned long long client_id;
+        unsigned long long sequence; // 0 - acked at once as not written
+        delivery_table::state state;
+        size_t records;
+    };
+
+    log_writer& writer;
+    delivery_table& deliveries;
+    const network::compression::dictionary* dictionary;
+    const ack_function ack;
+    log_decoder decoder; // parser only, keeps the call sites the connection defined
+
+    // the stages start with the first batch, a connection without one costs no threads
+    std::mutex mutex;
+    std::condition_variable cv; // either queue changed
+    std::deque<std::string> frames;  // read, not parsed
+    std::deque<parsed_batch> parsed; // with the writer, not acked
+    bool reading_done = false;
+    bool parsing_done = false;
+    std::thread parser;
+    std::thread acker;
+
+    parsed_batch parse(const std::string& frame);
+    unsigned long long settle(const parsed_batch& batch);
+    void parse_loop();
+    void ack_loop();
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include "nstd/concurrent_unordered_map.h"
+
+// Remembers which (client id, sequence) batches were written, so a batch the
+// client sends again because its ack was lost is acked without a second write.
+// Each client keeps its last remembered_batches sequences; an older one is
+// unknown again and written as fresh, a duplicate rather than a lost batch.
+// A client idle for idle_timeout is forgotten, a restarted client comes back
+// under a new id. Clients are striped over the shards of the map, so connections
+// of different clients do not wait for each other.
+class delivery_table {
+public:
+    enum class state {
+        fresh,     // the caller writes the batch, then calls written or abandon
+        writing,   // another connection is writing it
+        written,
+    };
+
+    state begin(unsigned long long client_id, unsigned long long sequence);
+    void written(unsigned long long client_id, unsigned long long sequence);
+    void abandon(unsigned long long client_id, unsigned long long sequence);
+
+    // for a batch in the writing state, true once it has been written
+    bool wait(unsigned long long client_id, unsigned long long sequence, std::chrono::milliseconds timeout);
+
+    // forgets the clients idle since before now - idle_timeout, begin does it every sweep_interval
+    void sweep(std::chrono::steady_clock::time_point now);
+    size_t clients_count() const { return clients.size(); }
+
+private:
+    static constexpr size_t remembered_batches = 4096;
+    static constexpr std::chrono::minutes idle_timeout{ 10 };
+    static constexpr std::chrono::seconds sweep_interval{ 10 };
+
+    struct client_state {
+        std::unordered_map<unsigned long long, bool> batches; // sequence -> written
+        std::deque<unsigned long long> written_order;
+        size_t writing = 0; // batches in the writing state
+        std::chrono::steady_clock::time_point last_seen;
+    };
+
+    nstd::concurrent_unordered_map<unsigned long long, client_state> clients;
+    std::atomic<long long> next_sweep{ 0 }; // steady_clock ticks
+
+    // only wait() sleeps on the cv, the others lock its mutex only when someone does
+    std::atomic<size_t> waiters{ 0 };
+    std::mutex wait_mutex;
+    std::condition_variable cv;
+
+    static state find(const client_state& client, unsigned long long sequence);
+    state find(unsigned long long client_id, unsigned long long sequence);
+    void notify_waiters();
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "network/compression.h"
+#include "network/protocol.h"
+
+struct log_entry {
+    long long time_stamp; // ns since the epoch, 0 - already formatted text without one
+    std::string line;
+};
+
+// Turns what one client connection or one batch delivered into log file lines.
+// Framed data (network/protocol.h) is rendered with the call site dictionary
+// the client sent along, anything else is taken as legacy plain text.
+// Compressed frames are unpacked with the backend's dictionary, if they name one.
+class log_decoder {
+private:
+    const network::compression::dictionary* dictionary;
+
+    struct site {
+        unsigned char level;
+        unsigned line;
+        std::string file;
+        std::string function;
+        std::string format;
+    };
+
+    // kept across decode calls: a client defines a site once per connection,
+    // in the first batch on it that uses the site, and may define an id again
+    std::unordered_map<unsigned, site> sites;
+
+    // from the batch frame of the last decode call, 0 - the data is not a sequenced batch
+    unsigned long long batch_client = 0;
+    unsigned long long batch_sequence = 0;
+    bool missing_dictionary = false;
+
+    long long cached_second = -1;
+    std::string cached_time;
+
+    // what holds the frames being decoded: a batch may carry compressed frames,
+    // nothing nests deeper than that
+    enum class frames_scope { top, batch, compressed };
+
+    void append_time(std::string& out, long long time_stamp);
+    bool decode_frames(network::protocol::reader& frames, std::vector<log_entry>& out, frames_scope scope);
+
+public:
+    explicit log_decoder(const network::compression::dictionary* dictionary = nullptr);
+
+    // appends one entry per record to out, returns false if the data was cut or malformed;
+    // one decoder serves one connection, so later batches see the sites of earlier ones
+    bool decode(const std::string& data, std::vector<log_entry>& out);
+
+    unsigned long long client_id() const { return batch_client; }
+    unsigned long long sequence() const { return batch_sequence; }
+    // the batch was compressed with a dictionary this backend does not hold
+    bool needs_dictionary() const { return missing_dictionary; }
+};
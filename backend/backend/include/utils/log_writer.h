@@ -0,0 +1,88 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/log_decoder.h"
+
+// Writes decoded lines in time stamp order across all connections. Urgent
+// records overtake batched ones on the wire, so every line waits up to
+// reorder_window after its arrival for older lines from other connections.
+// A line older than what is already written goes out as soon as it is due.
+// With a journal every add reaches a file before add returns, so a batch can be
+// acked at once instead of after the window: the next start writes what the
+// journal of a crashed backend still holds.
+class log_writer {
+private:
+    struct pending_entry {
+        long long time_stamp;
+        unsigned long long order; // arrival order breaks ties
+        int journal_slot; // -1 - not journaled
+        std::chrono::steady_clock::time_point due;
+        std::string line;
+    };
+
+    struct later {
+        bool operator()(const pending_entry& a, const pending_entry& b) const {
+            if (a.time_stamp != b.time_stamp) return a.time_stamp > b.time_stamp;
+            return a.order > b.order;
+        }
+    };
+
+    const std::chrono::milliseconds reorder_window;
+    const std::function<void(const std::string&)> save;
+
+    std::priority_queue<pending_entry, std::vector<pending_entry>, later> queue;
+    size_t queued_bytes = 0; // lines waiting in queue or being saved
+
+    // lines held for the window are expected, only those past it count as backlog;
+    // every add has the same window, so arrivals are due in order
+    std::deque<std::pair<std::chrono::steady_clock::time_point, size_t>> arrivals;
+    size_t due_lines = 0;
+    size_t written_lines = 0;
+    unsigned long long next_order = 0;
+
+    // two files taken in turns: adds go to the current one until it is full, a file
+    // is emptied once all of its lines are saved (lines saved since the last time
+    // it was emptied are written again after a crash)
+    struct journal_file {
+        std::string path;
+        size_t bytes = 0;
+        size_t unsaved = 0; // lines
+    };
+    journal_file journals[2];
+    std::ofstream journal; // the current file, empty path - no journal
+    int journal_slot = -1;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread writer;
+
+    void run();
+    void advance_due(std::chrono::steady_clock::time_point now);
+    void replay_journal(journal_file& file, int slot);
+    void open_journal(int slot, bool truncate);
+    void release_journal();
+
+public:
+    // journal_path - files journal_path.0 and journal_path.1, empty - no journal
+    log_writer(std::chrono::milliseconds window, std::function<void(const std::string&)> save_lines,
+        const std::string& journal_path = "");
+    ~log_writer();
+
+    log_writer(const log_writer&) = delete;
+    log_writer& operator=(const log_writer&) = delete;
+
+    // the lines are in the journal (if there is one) once it returns
+    void add(std::vector<log_entry>& entries);
+
+    // lines overdue for writing and bytes not written yet, clients pace themselves by them
+    void backlog(size_t& lines, size_t& bytes);
+};
@@ -56,6 +56,13 @@ namespace network {
         SOCKET client_fd = ::accept(listen_fd_, (SOCKADDR*)&client_addr, &client_size);
         if (client_fd == INVALID_SOCKET) {
             LOGE("accept failed with error: " << WSAGetLastError());
+            return client_fd;
+        }
+
+        // acks are small and go out one per batch, none may wait for the one before
+        int no_delay = 1;
+        if (setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay)) == SOCKET_ERROR) {
+            LOGW("setsockopt failed with error: " << WSAGetLastError());
         }
         return client_fd;
     }
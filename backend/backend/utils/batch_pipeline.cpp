@@ -0,0 +1,132 @@
+#include "utils/batch_pipeline.h"
+#include "log.h"
+
+// how long a retransmitted batch waits for the connection still writing it
+constexpr std::chrono::milliseconds duplicate_wait(10000);
+
+batch_pipeline::batch_pipeline(log_writer& writer, delivery_table& deliveries,
+    const network::compression::dictionary* dictionary, ack_function ack)
+    : writer(writer), deliveries(deliveries), dictionary(dictionary), ack(std::move(ack)), decoder(dictionary) {
+}
+
+batch_pipeline::~batch_pipeline() {
+    finish();
+}
+
+void batch_pipeline::push(std::string frame) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!parser.joinable()) {
+            parser = std::thread(&batch_pipeline::parse_loop, this);
+            acker = std::thread(&batch_pipeline::ack_loop, this);
+        }
+        cv.wait(lock, [this] { return frames.size() < max_queued; });
+        frames.push_back(std::move(frame));
+    }
+    cv.notify_all();
+}
+
+void batch_pipeline::finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        reading_done = true;
+    }
+    cv.notify_all();
+    if (parser.joinable())
+        parser.join();
+    if (acker.joinable())
+        acker.join();
+}
+
+// a sequenced batch goes to the writer only if no connection wrote it or is writing it
+batch_pipeline::parsed_batch batch_pipeline::parse(const std::string& frame) {
+    std::vector<log_entry> entries;
+    bool decoded = decoder.decode(frame, entries);
+    if (!decoded)
+        LOGW("client sent a malformed or truncated batch");
+
+    parsed_batch batch = { decoder.client_id(), decoder.sequence(), delivery_table::state::fresh, entries.size() };
+    if (!batch.sequence) {
+        writer.add(entries);
+        return batch;
+    }
+
+    batch.state = deliveries.begin(batch.client_id, batch.sequence);
+    if (batch.state != delivery_table::state::fresh)
+        return batch;
+
+    // nothing of it is written, the client sends it again - without the dictionary,
+    // or whole: a part written and acked would be lost with the rest
+    if (!decoded) {
+        deliveries.abandon(batch.client_id, batch.sequence);
+        batch.sequence = 0;
+        batch.records = 0;
+        return batch;
+    }
+
+    writer.add(entries);
+    return batch;
+}
+
+// a batch is acked once the writer took it (into its journal, if it keeps one),
+// not after its reorder window, and taken only once however often the client sends it
+unsigned long long batch_pipeline::settle(const parsed_batch& batch) {
+    if (!batch.sequence)
+        return 0;
+
+    switch (batch.state) {
+    case delivery_table::state::fresh:
+        deliveries.written(batch.client_id, batch.sequence);
+        return batch.sequence;
+
+    case delivery_table::state::writing:
+        LOGD("batch " << batch.sequence << " is being written by another connection");
+        return deliveries.wait(batch.client_id, batch.sequence, duplicate_wait) ? batch.sequence : 0;
+
+    default:
+        LOGD("batch " << batch.sequence << " was written before");
+        return batch.sequence;
+    }
+}
+
+void batch_pipeline::parse_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this] { return !frames.empty() || reading_done; });
+        if (frames.empty())
+            break;
+
+        std::string frame = std::move(frames.front());
+        frames.pop_front();
+        lock.unlock();
+        cv.notify_all();
+
+        parsed_batch batch = parse(frame);
+
+        lock.lock();
+        cv.wait(lock, [this] { return parsed.size() < max_queued; });
+        parsed.push_back(batch);
+        cv.notify_all();
+    }
+
+    parsing_done = true;
+    cv.notify_all();
+}
+
+void batch_pipeline::ack_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        cv.wait(lock, [this] { return !parsed.empty() || parsing_done; });
+        if (parsed.empty())
+            break;
+
+        parsed_batch batch = parsed.front();
+        parsed.pop_front();
+        lock.unlock();
+        cv.notify_all();
+
+        // acks leave in the order the batches came, the client relies on it
+        ack(batch.records, settle(batch));
+        lock.lock();
+    }
+}
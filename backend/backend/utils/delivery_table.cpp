@@ -0,0 +1,95 @@
+#include "utils/delivery_table.h"
+#include <vector>
+
+delivery_table::state delivery_table::find(const client_state& client, unsigned long long sequence) {
+    auto found = client.batches.find(sequence);
+    if (found == client.batches.end())
+        return state::fresh;
+    return found->second ? state::written : state::writing;
+}
+
+delivery_table::state delivery_table::find(unsigned long long client_id, unsigned long long sequence) {
+    state current = state::fresh;
+    clients.update(client_id, [&](client_state& client) { current = find(client, sequence); });
+    return current;
+}
+
+delivery_table::state delivery_table::begin(unsigned long long client_id, unsigned long long sequence) {
+    auto now = std::chrono::steady_clock::now();
+    long long due = next_sweep.load(std::memory_order_relaxed);
+    if (now.time_since_epoch().count() >= due && next_sweep.compare_exchange_strong(due,
+        (now + sweep_interval).time_since_epoch().count(), std::memory_order_relaxed))
+        sweep(now);
+
+    state current = state::fresh;
+    clients.upsert(client_id, [&](client_state& client) {
+        client.last_seen = now;
+        current = find(client, sequence);
+        if (current == state::fresh) {
+            client.batches[sequence] = false;
+            client.writing++;
+        }
+    });
+    return current;
+}
+
+void delivery_table::written(unsigned long long client_id, unsigned long long sequence) {
+    clients.upsert(client_id, [&](client_state& client) {
+        bool& done = client.batches[sequence];
+        if (!done && client.writing)
+            client.writing--;
+        done = true;
+        client.written_order.push_back(sequence);
+
+        // a forgotten sequence is unknown again, a late retransmit of it is written once more
+        while (client.written_order.size() > remembered_batches) {
+            client.batches.erase(client.written_order.front());
+            client.written_order.pop_front();
+        }
+    });
+    notify_waiters();
+}
+
+void delivery_table::abandon(unsigned long long client_id, unsigned long long sequence) {
+    clients.update(client_id, [&](client_state& client) {
+        auto found = client.batches.find(sequence);
+        if (found == client.batches.end() || found->second)
+            return;
+        client.batches.erase(found);
+        client.writing--;
+    });
+    notify_waiters();
+}
+
+void delivery_table::notify_waiters() {
+    // a waiter counts itself before it looks at the state, so either it sees the
+    // change or this sees it and wakes it under the mutex it waits with
+    if (!waiters.load())
+        return;
+    std::lock_guard<std::mutex> lock(wait_mutex);
+    cv.notify_all();
+}
+
+bool delivery_table::wait(unsigned long long client_id, unsigned long long sequence, std::chrono::milliseconds timeout) {
+    waiters.fetch_add(1);
+    std::unique_lock<std::mutex> lock(wait_mutex);
+    cv.wait_for(lock, timeout, [&] { return find(client_id, sequence) != state::writing; });
+    bool done = find(client_id, sequence) == state::written;
+    lock.unlock();
+    waiters.fetch_sub(1);
+    return done;
+}
+
+void delivery_table::sweep(std::chrono::steady_clock::time_point now) {
+    auto idle_since = now - idle_timeout;
+    auto idle = [idle_since](const client_state& client) { return !client.writing && client.last_seen < idle_since; };
+
+    std::vector<unsigned long long> candidates;
+    clients.for_each([&](const unsigned long long& client_id, const client_state& client) {
+        if (idle(client))
+            candidates.push_back(client_id);
+    });
+    // a client may have come back since for_each saw it
+    for (unsigned long long client_id : candidates)
+        clients.erase_if(client_id, idle);
+}
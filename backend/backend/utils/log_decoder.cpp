@@ -0,0 +1,162 @@
+#include "utils/log_decoder.h"
+#include "network/protocol.h"
+#include "logs/format.h"
+#include "log.h"
+#include <ctime>
+
+namespace protocol = network::protocol;
+
+// a compressed frame claiming more than this is taken as malformed
+constexpr unsigned max_raw_size = 256 * 1024 * 1024;
+
+log_decoder::log_decoder(const network::compression::dictionary* dictionary)
+    : dictionary(dictionary) {
+}
+
+void log_decoder::append_time(std::string& out, long long time_stamp) {
+    long long second = time_stamp / 1000000000LL;
+    if (second != cached_second) {
+        std::time_t time = static_cast<std::time_t>(second);
+        std::tm buf{};
+        localtime_s(&buf, &time);
+
+        char text[32];
+        std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &buf);
+        cached_time = text;
+        cached_second = second;
+    }
+    out += cached_time;
+}
+
+bool log_decoder::decode(const std::string& data, std::vector<log_entry>& out) {
+    batch_client = 0;
+    batch_sequence = 0;
+    missing_dictionary = false;
+
+    if (!protocol::is_framed(data.data(), data.size())) {
+        // legacy clients end their text with a NUL
+        size_t size = data.size();
+        while (size && data[size - 1] == '\0') size--;
+        out.push_back({ 0, data.substr(0, size) });
+        return true;
+    }
+
+    protocol::reader frames(data.data(), data.size());
+    return decode_frames(frames, out, frames_scope::top);
+}
+
+bool log_decoder::decode_frames(protocol::reader& frames, std::vector<log_entry>& out, frames_scope scope) {
+    protocol::frame_header header;
+    protocol::reader payload(nullptr, 0);
+
+    while (frames.next_frame(header, payload)) {
+        switch (header.type_) {
+        case protocol::frame_type::sites:
+            while (!payload.at_end()) {
+                unsigned id;
+                site s;
+                std::string_view file, function, format;
+                if (!payload.get(id) || !payload.get(s.level) || !payload.get(s.line)
+                    || !payload.get_string(file) || !payload.get_string(function) || !payload.get_string(format))
+                    return false;
+
+                s.file = file;
+                s.function = function;
+                s.format = format;
+                sites[id] = std::move(s);
+            }
+            break;
+
+        case protocol::frame_type::records:
+            while (!payload.at_end()) {
+                unsigned id, size;
+                long long time_stamp;
+                unsigned char level = 0;
+                std::string_view format;
+                const char* args;
+                if (!payload.get(id) || !payload.get(time_stamp))
+                    return false;
+
+                if (id == 0) {
+                    if (!payload.get(level) || !payload.get_string(format))
+                        return false;
+                }
+                else {
+                    auto found = sites.find(id);
+                    if (found == sites.end()) {
+                        LOGW("record of unknown call site " << id);
+                        format = "{unknown call site}";
+                    }
+                    else {
+                        level = found->second.level;
+                        format = found->second.format;
+                    }
+                }
+
+                if (!payload.get(size) || !payload.get_bytes(size, args))
+                    return false;
+
+                std::string line;
+                append_time(line, time_stamp);
+                line += " ";
+                line += logs::level_tag(static_cast<logs::level>(level));
+                logs::format_record(line, format, args, size);
+                line += "\n";
+                out.push_back({ time_stamp, std::move(line) });
+            }
+            break;
+
+        case protocol::frame_type::text: {
+            const char* text;
+            size_t size = payload.left();
+            payload.get_bytes(size, text);
+            out.push_back({ 0, std::string(text, size) });
+            break;
+        }
+
+        case protocol::frame_type::batch:
+            if (scope != frames_scope::top) {
+                LOGW("batch frame nested in another frame");
+                return false;
+            }
+            if (!payload.get(batch_client) || !payload.get(batch_sequence) || !decode_frames(payload, out, frames_scope::batch))
+                return false;
+            break;
+
+        case protocol::frame_type::compressed: {
+            if (scope == frames_scope::compressed) {
+                LOGW("compressed frame nested in a compressed frame");
+                return false;
+            }
+            unsigned dictionary_id, raw_size;
+            if (!payload.get(dictionary_id) || !payload.get(raw_size) || raw_size > max_raw_size)
+                return false;
+
+            // the client learns from the ack which dictionary to use and sends again
+            if (dictionary_id && (!dictionary || dictionary->id() != dictionary_id)) {
+                LOGW("batch compressed with unknown dictionary " << dictionary_id);
+                missing_dictionary = true;
+                return false;
+            }
+
+            const char* stream;
+            size_t size = payload.left();
+            payload.get_bytes(size, stream);
+
+            std::string raw;
+            if (!network::compression::decompress(stream, size, raw_size, dictionary_id ? dictionary : nullptr, raw))
+                return false;
+            protocol::reader raw_frames(raw.data(), raw.size());
+            if (!decode_frames(raw_frames, out, frames_scope::compressed))
+                return false;
+            break;
+        }
+
+        default:
+            LOGW("skipped frame of unknown type " << static_cast<int>(header.type_));
+            break;
+        }
+    }
+
+    return frames.at_end();
+}
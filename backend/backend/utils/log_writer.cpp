@@ -0,0 +1,200 @@
+#include "utils/log_writer.h"
+#include "network/protocol.h"
+#include "log.h"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+namespace protocol = network::protocol;
+
+// the current journal file takes adds until it holds this much and the other one is empty
+constexpr size_t journal_roll_bytes = 64 * 1024 * 1024;
+
+log_writer::log_writer(std::chrono::milliseconds window, std::function<void(const std::string&)> save_lines,
+    const std::string& journal_path)
+    : reorder_window(window), save(std::move(save_lines)) {
+    if (!journal_path.empty()) {
+        for (int slot = 0; slot < 2; slot++) {
+            journals[slot].path = journal_path + "." + std::to_string(slot);
+            replay_journal(journals[slot], slot);
+        }
+        open_journal(0, false);
+    }
+    writer = std::thread(&log_writer::run, this);
+}
+
+log_writer::~log_writer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    writer.join();
+}
+
+// a record is time stamp i64, size u32 and the line
+void log_writer::replay_journal(journal_file& file, int slot) {
+    std::ifstream in(file.path, std::ios::binary);
+    if (!in)
+        return;
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+
+    auto due = std::chrono::steady_clock::now() + reorder_window;
+    protocol::reader records(data.data(), data.size());
+    size_t valid = 0, lines = 0;
+    while (true) {
+        long long time_stamp;
+        unsigned size;
+        const char* line;
+        if (!records.get(time_stamp) || !records.get(size) || !records.get_bytes(size, line))
+            break;
+
+        queued_bytes += size;
+        queue.push({ time_stamp, next_order++, slot, due, std::string(line, size) });
+        valid = data.size() - records.left();
+        lines++;
+    }
+    arrivals.emplace_back(due, lines);
+
+    // the backend died while it appended the last record
+    if (valid != data.size()) {
+        std::error_code error;
+        fs::resize_file(file.path, valid, error);
+    }
+    file.bytes = valid;
+    file.unsaved = lines;
+    if (lines)
+        LOGI("writing " << lines << " lines left in journal " << file.path);
+}
+
+void log_writer::open_journal(int slot, bool truncate) {
+    journal.close();
+    journal.clear();
+    journal.open(journals[slot].path, std::ios::binary | (truncate ? std::ios::trunc : std::ios::app));
+    if (!journal) {
+        LOGE("failed to open journal " << journals[slot].path << ", batches are acked without it");
+        journal_slot = -1;
+        return;
+    }
+    if (truncate)
+        journals[slot].bytes = 0;
+    journal_slot = slot;
+}
+
+// a file whose lines are all saved is emptied, so a restart does not write them again
+void log_writer::release_journal() {
+    for (int slot = 0; slot < 2; slot++) {
+        journal_file& file = journals[slot];
+        if (file.unsaved || !file.bytes)
+            continue;
+
+        if (slot == journal_slot) {
+            open_journal(slot, true);
+        }
+        else {
+            std::ofstream emptied(file.path, std::ios::binary | std::ios::trunc);
+            file.bytes = 0;
+        }
+    }
+}
+
+void log_writer::add(std::vector<log_entry>& entries) {
+    auto due = std::chrono::steady_clock::now() + reorder_window;
+
+    std::string records;
+    if (!journals[0].path.empty()) {
+        for (const log_entry& entry : entries) {
+            protocol::put(records, entry.time_stamp);
+            protocol::put(records, static_cast<unsigned>(entry.line.size()));
+            records += entry.line;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (journal_slot >= 0 && !records.empty()) {
+            int other = 1 - journal_slot;
+            if (journals[journal_slot].bytes >= journal_roll_bytes && !journals[other].unsaved)
+                open_journal(other, true);
+        }
+
+        int slot = records.empty() ? -1 : journal_slot;
+        if (slot >= 0) {
+            // flushed to the system, it survives the backend but not the machine
+            journal.write(records.data(), records.size());
+            journal.flush();
+            if (!journal) {
+                LOGE("failed to write journal " << journals[slot].path << ", batches are acked without it");
+                journal_slot = slot = -1;
+            }
+            else {
+                journals[slot].bytes += records.size();
+                journals[slot].unsaved += entries.size();
+            }
+        }
+
+        arrivals.emplace_back(due, entries.size());
+        for (log_entry& entry : entries) {
+            queued_bytes += entry.line.size();
+            queue.push({ entry.time_stamp, next_order++, slot, due, std::move(entry.line) });
+        }
+    }
+    cv.notify_one();
+}
+
+void log_writer::run() {
+    std::string batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        if (queue.empty()) {
+            if (stopping) break;
+            cv.wait(lock);
+            continue;
+        }
+
+        // the oldest line goes out once it has waited its window, on shutdown at once
+        auto now = std::chrono::steady_clock::now();
+        if (!stopping && queue.top().due > now) {
+            auto due = queue.top().due; // the queue may grow while waiting
+            cv.wait_until(lock, due);
+            continue;
+        }
+
+        advance_due(now);
+        batch.clear();
+        size_t journaled[2] = { 0, 0 }; // lines of the batch per journal file
+        while (!queue.empty() && (stopping || queue.top().due <= now)) {
+            batch += queue.top().line;
+            if (queue.top().journal_slot >= 0)
+                journaled[queue.top().journal_slot]++;
+            queue.pop();
+            written_lines++;
+        }
+
+        size_t batch_bytes = batch.size();
+        lock.unlock();
+        // save appends its own line break
+        if (!batch.empty() && batch.back() == '\n') batch.pop_back();
+        save(batch);
+        lock.lock();
+        queued_bytes -= batch_bytes;
+
+        journals[0].unsaved -= journaled[0];
+        journals[1].unsaved -= journaled[1];
+        release_journal();
+    }
+}
+
+void log_writer::advance_due(std::chrono::steady_clock::time_point now) {
+    while (!arrivals.empty() && arrivals.front().first <= now) {
+        due_lines += arrivals.front().second;
+        arrivals.pop_front();
+    }
+}
+
+void log_writer::backlog(size_t& lines, size_t& bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    advance_due(std::chrono::steady_clock::now());
+    lines = due_lines > written_lines ? due_lines - written_lines : 0;
+    bytes = queued_bytes;
+}
@@ -1,8 +1,16 @@
 ﻿#include "logs_test.h"
 #include "nsdt_test.h"
+#include "nstd_bench.h"
+#include "logs_bench.h"
+#include "network_test.h"
+#include "network_bench.h"
 
 #define NSTD_TEST 1
+#define NSTD_BENCH 0
 #define LOGS_TEST 1
+#define LOGS_BENCH 0
+#define NETWORK_TEST 1
+#define NETWORK_BENCH 0
 
 int main() {
 
@@ -15,4 +23,20 @@ int main() {
     logs_test();
 #endif
 
+#if NETWORK_TEST
+    network_test();
+#endif
+
+#if NSTD_BENCH
+    nstd_bench();
+#endif
+
+#if LOGS_BENCH
+    logs_bench();
+#endif
+
+#if NETWORK_BENCH
+    network_bench();
+#endif
+
 }
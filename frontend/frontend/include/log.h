@@ -1,13 +1,123 @@
 #pragma once
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include "log_sink.h"
+
+// LOG_MIN_LEVEL compiles out everything below it: 0 - debug, 1 - info, 2 - warning, 3 - error, 4 - nothing.
+// console::set_level raises the bar further at run time. Without it a release
+// build keeps only LOGI, as it always did; define LOG_MIN_LEVEL to get the rest.
+#ifndef LOG_MIN_LEVEL
 #ifdef _DEBUG
-#include <iostream>
-#define LOGD(...) std::cout  << __FUNCTION__ << ":" << __LINE__  << " [D] " << __VA_ARGS__ << std::endl;
-#define LOGI(...) std::cout  << __FUNCTION__ << ":" << __LINE__  << " [I] " << __VA_ARGS__ << std::endl;
-#define LOGW(...) std::cout  << __FUNCTION__ << ":" << __LINE__  << " [W] " << __VA_ARGS__ << std::endl;
-#define LOGE(...) std::cout  << __FUNCTION__ << ":" << __LINE__  << " [E] " << __VA_ARGS__ << std::endl;
+#define LOG_MIN_LEVEL 0
 #else
-#define LOGD(...)
-#define LOGI(...) std::cout << "[I] " << __VA_ARGS__ << std::endl;
-#define LOGW(...)
-#define LOGE(...)
+#define LOG_MIN_LEVEL 1
+#define LOG_INFO_ONLY 1
 #endif
+#endif
+#ifndef LOG_INFO_ONLY
+#define LOG_INFO_ONLY 0
+#endif
+
+#ifdef _DEBUG
+#define LOG_PREFIX(tag) __FUNCTION__ << ":" << __LINE__ << " " tag " "
+#else
+#define LOG_PREFIX(tag) tag " "
+#endif
+
+namespace console {
+    namespace detail {
+        // the stream writes straight into text_, which keeps its capacity between lines
+        class line_buffer : public std::streambuf {
+        private:
+            std::string text_;
+
+        protected:
+            int_type overflow(int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof()))
+                    text_ += traits_type::to_char_type(c);
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char* s, std::streamsize count) override
+            {
+                text_.append(s, static_cast<size_t>(count));
+                return count;
+            }
+
+        public:
+            std::string_view text() const { return text_; }
+            void clear() { text_.clear(); }
+        };
+
+        struct thread_line {
+            line_buffer buffer_;
+            std::ostream stream_{ &buffer_ };
+
+            ~thread_line() { gone() = true; }
+
+            // trivially destructible, still readable after the thread_locals are destroyed
+            static bool& gone() { thread_local bool value = false; return value; }
+            static bool& busy() { thread_local bool value = false; return value; }
+        };
+    }
+
+    // formats one line in the thread's reusable stream; a LOG* in the arguments of
+    // another, or one from a destructor after the thread's line is gone, gets its own
+    class line {
+    private:
+        std::unique_ptr<detail::thread_line> own_;
+        detail::thread_line* line_;
+
+    public:
+        line()
+        {
+            if (detail::thread_line::busy() || detail::thread_line::gone()) {
+                own_.reset(new detail::thread_line);
+                line_ = own_.get();
+                return;
+            }
+
+            thread_local detail::thread_line shared;
+            line_ = &shared;
+            detail::thread_line::busy() = true;
+
+            // the last line may have left a manipulator behind
+            line_->buffer_.clear();
+            line_->stream_.clear();
+            line_->stream_.flags(std::ios_base::dec | std::ios_base::skipws);
+            line_->stream_.precision(6);
+            line_->stream_.width(0);
+            line_->stream_.fill(' ');
+        }
+
+        ~line()
+        {
+            if (!own_) detail::thread_line::busy() = false;
+        }
+
+        line(const line&) = delete;
+        line& operator=(const line&) = delete;
+
+        std::ostream& stream() { return line_->stream_; }
+        std::string_view text() const { return line_->buffer_.text(); }
+    };
+}
+
+// the arguments are only evaluated when the level passes both checks
+#define LOG_AT(level, tag, ...) do { \
+    if (LOG_MIN_LEVEL <= level && (!LOG_INFO_ONLY || level == console::info) \
+        && console::sink(LOG_MIN_LEVEL).enabled(level)) { \
+        console::line log_line_; \
+        log_line_.stream() << LOG_PREFIX(tag) << __VA_ARGS__ << '\n'; \
+        console::sink().push(log_line_.text()); \
+    } \
+} while (0)
+
+#define LOGD(...) LOG_AT(console::debug, "[D]", __VA_ARGS__)
+#define LOGI(...) LOG_AT(console::info, "[I]", __VA_ARGS__)
+#define LOGW(...) LOG_AT(console::warning, "[W]", __VA_ARGS__)
+#define LOGE(...) LOG_AT(console::error, "[E]", __VA_ARGS__)
@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+
+namespace logs {
+	struct pacer_config {
+		std::chrono::microseconds min_linger_{ 1000 };
+		std::chrono::microseconds max_linger_{ 1000000 };
+		unsigned rtt_multiple_ = 4;          // linger per round trip, keeps the connection cost near 1 / (1 + multiple)
+		size_t min_batch_bytes_ = 16 * 1024;
+		size_t max_batch_bytes_ = 4 * 1024 * 1024;
+		unsigned high_queue_depth_ = 10000;  // backend lines waiting above which the client slows down
+	};
+
+	// Picks how long the flusher lingers and how many staged bytes end a batch early.
+	// The linger follows the observed round trip time, so batches grow on a slow link,
+	// and is stretched while the backend reports a deep queue or no credit. The batch
+	// size grows while batches fill up before the linger ends and shrinks when idle.
+	class batch_pacer {
+	private:
+		const pacer_config config_;
+		double rtt_us_ = 0; // moving average
+		unsigned pressure_ = 1; // linger multiplier from backend backpressure and failures
+		size_t batch_bytes_;
+		size_t credit_ = 0; // 0 - the backend did not report one
+		std::chrono::microseconds linger_;
+
+		void update_linger();
+
+	public:
+		explicit batch_pacer(const pacer_config& config = pacer_config());
+
+		// a batch of bytes went out in rtt; queue_depth and credit come from the backend's ack
+		void on_sent(size_t bytes, std::chrono::microseconds rtt, bool acked, unsigned queue_depth, unsigned credit);
+		void on_failed();
+
+		std::chrono::microseconds linger() const { return linger_; }
+		size_t batch_bytes() const;
+		double rtt_us() const { return rtt_us_; }
+	};
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+
+namespace logs {
+	// cheap monotonic counter taken on the hot path
+	inline long long now_ticks()
+	{
+		return std::chrono::steady_clock::now().time_since_epoch().count();
+	}
+
+	// converts counter values back to wall clock time on the flusher side
+	class clock_anchor {
+	private:
+		long long system_ns_;
+		long long ticks_;
+
+	public:
+		clock_anchor()
+			: system_ns_(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count()),
+			ticks_(now_ticks())
+		{
+		}
+
+		clock_anchor(long long system_ns, long long ticks)
+			: system_ns_(system_ns), ticks_(ticks)
+		{
+		}
+
+		long long system_ns() const { return system_ns_; }
+		long long ticks() const { return ticks_; }
+
+		long long to_system_ns(long long ticks) const
+		{
+			std::chrono::steady_clock::duration elapsed(ticks - ticks_);
+			return system_ns_ + std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		}
+	};
+}
@@ -0,0 +1,269 @@
+#pragma once
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "level.h"
+
+namespace logs {
+	namespace detail {
+		constexpr unsigned fnv1a(unsigned hash, const char* text)
+		{
+			for (; *text; text++) {
+				hash ^= static_cast<unsigned char>(*text);
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		constexpr unsigned fnv1a(unsigned hash, unsigned value)
+		{
+			for (int i = 0; i < 4; i++, value >>= 8) {
+				hash ^= value & 0xff;
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		// __FILE__ may hold the build machine's path, the id must not depend on it
+		constexpr const char* base_name(const char* path)
+		{
+			const char* name = path;
+			for (; *path; path++) {
+				if (*path == '/' || *path == '\\')
+					name = path + 1;
+			}
+			return name;
+		}
+
+		constexpr unsigned site_id(const char* file, unsigned line, level log_level, const char* format)
+		{
+			unsigned hash = fnv1a(fnv1a(fnv1a(2166136261u, file), line), static_cast<unsigned>(log_level));
+			hash = fnv1a(hash, format);
+			return hash ? hash : 1; // 0 is reserved for inline sites on the wire
+		}
+	}
+
+	// Static description of a log call site, registered once per call site.
+	// The hot path stores only a pointer to it plus the raw argument bytes,
+	// the text is produced later by format_record on the flusher side.
+	// id_ is computed at compile time and is the same in every run and build,
+	// the wire carries it instead of the location and format strings.
+	struct format_site {
+		const char* format_; // "{}" marks an argument
+		level level_;
+		const char* file_;
+		const char* function_;
+		unsigned line_;
+		unsigned id_;
+
+		constexpr format_site(const char* format, level log_level,
+			const char* file = "", const char* function = "", unsigned line = 0)
+			: format_(format), level_(log_level), file_(detail::base_name(file)), function_(function),
+			line_(line), id_(detail::site_id(detail::base_name(file), line, log_level, format))
+		{
+		}
+	};
+
+	// every argument is stored as a one byte tag followed by its raw bytes
+	enum class arg_tag : unsigned char {
+		i8, i16, i32, i64,
+		u8, u16, u32, u64,
+		f32, f64,
+		chr, boolean,
+		str, // unsigned length + bytes
+		ptr,
+	};
+
+	namespace detail {
+		template<class T>
+		constexpr arg_tag integral_tag()
+		{
+			if constexpr (std::is_signed_v<T>) {
+				if constexpr (sizeof(T) == 1) return arg_tag::i8;
+				else if constexpr (sizeof(T) == 2) return arg_tag::i16;
+				else if constexpr (sizeof(T) == 4) return arg_tag::i32;
+				else return arg_tag::i64;
+			}
+			else {
+				if constexpr (sizeof(T) == 1) return arg_tag::u8;
+				else if constexpr (sizeof(T) == 2) return arg_tag::u16;
+				else if constexpr (sizeof(T) == 4) return arg_tag::u32;
+				else return arg_tag::u64;
+			}
+		}
+
+		inline std::string_view as_string(const char* value) { return value ? std::string_view(value) : std::string_view("(null)"); }
+		inline std::string_view as_string(const std::string& value) { return value; }
+		inline std::string_view as_string(std::string_view value) { return value; }
+
+		template<class T>
+		constexpr bool is_string_v = std::is_convertible_v<const T&, std::string_view>;
+
+		template<class T>
+		inline size_t encoded_size(const T& value)
+		{
+			if constexpr (is_string_v<T>)
+				return 1 + sizeof(unsigned) + as_string(value).size();
+			else if constexpr (std::is_pointer_v<T>)
+				return 1 + sizeof(const void*);
+			else
+				return 1 + sizeof(T);
+		}
+
+		template<class T>
+		inline void encode(char*& out, const T& value)
+		{
+			if constexpr (is_string_v<T>) {
+				std::string_view text = as_string(value);
+				unsigned length = static_cast<unsigned>(text.size());
+				*out++ = static_cast<char>(arg_tag::str);
+				memcpy(out, &length, sizeof(length));
+				memcpy(out + sizeof(length), text.data(), length);
+				out += sizeof(length) + length;
+				return;
+			}
+			else {
+				arg_tag tag;
+				if constexpr (std::is_pointer_v<T>) tag = arg_tag::ptr;
+				else if constexpr (std::is_same_v<T, bool>) tag = arg_tag::boolean;
+				else if constexpr (std::is_same_v<T, char>) tag = arg_tag::chr;
+				else if constexpr (std::is_enum_v<T>) tag = integral_tag<std::underlying_type_t<T>>();
+				else if constexpr (std::is_integral_v<T>) tag = integral_tag<T>();
+				else if constexpr (std::is_same_v<T, float>) tag = arg_tag::f32;
+				else {
+					static_assert(std::is_same_v<T, double>, "unsupported log argument type");
+					tag = arg_tag::f64;
+				}
+
+				*out++ = static_cast<char>(tag);
+				memcpy(out, &value, sizeof(T));
+				out += sizeof(T);
+			}
+		}
+
+		template<class T>
+		inline bool read(const char*& in, const char* end, T& value)
+		{
+			if (end - in < static_cast<long long>(sizeof(T))) return false;
+			memcpy(&value, in, sizeof(T));
+			in += sizeof(T);
+			return true;
+		}
+
+		template<class T>
+		inline bool append_number(std::string& out, const char*& in, const char* end)
+		{
+			T value;
+			if (!read(in, end, value)) return false;
+
+			if constexpr (std::is_floating_point_v<T>) {
+				char number[64];
+				snprintf(number, sizeof(number), "%g", static_cast<double>(value));
+				out += number;
+			}
+			else {
+				out += std::to_string(value);
+			}
+			return true;
+		}
+
+		// appends the text of one encoded argument, returns false on a malformed buffer
+		inline bool decode_arg(std::string& out, const char*& in, const char* end)
+		{
+			if (in >= end) return false;
+
+			arg_tag tag = static_cast<arg_tag>(*in++);
+			switch (tag) {
+			case arg_tag::i8: return append_number<signed char>(out, in, end);
+			case arg_tag::i16: return append_number<short>(out, in, end);
+			case arg_tag::i32: return append_number<int>(out, in, end);
+			case arg_tag::i64: return append_number<long long>(out, in, end);
+			case arg_tag::u8: return append_number<unsigned char>(out, in, end);
+			case arg_tag::u16: return append_number<unsigned short>(out, in, end);
+			case arg_tag::u32: return append_number<unsigned>(out, in, end);
+			case arg_tag::u64: return append_number<unsigned long long>(out, in, end);
+			case arg_tag::f32: return append_number<float>(out, in, end);
+			case arg_tag::f64: return append_number<double>(out, in, end);
+			case arg_tag::chr: {
+				char value;
+				if (!read(in, end, value)) return false;
+				out += value;
+				return true;
+			}
+			case arg_tag::boolean: {
+				bool value;
+				if (!read(in, end, value)) return false;
+				out += value ? "true" : "false";
+				return true;
+			}
+			case arg_tag::ptr: {
+				const void* value;
+				if (!read(in, end, value)) return false;
+				char number[32];
+				snprintf(number, sizeof(number), "%p", value);
+				out += number;
+				return true;
+			}
+			case arg_tag::str: {
+				unsigned length;
+				if (!read(in, end, length) || end - in < static_cast<long long>(length)) return false;
+				out.append(in, length);
+				in += length;
+				return true;
+			}
+			}
+
+			return false;
+		}
+	}
+
+	template<class... Args>
+	inline size_t encoded_size(const Args&... args)
+	{
+		return (size_t(0) + ... + detail::encoded_size(args));
+	}
+
+	template<class... Args>
+	inline void encode_args(char* out, const Args&... args)
+	{
+		// a record without arguments would leave out unused
+		if constexpr (sizeof...(Args) > 0)
+			(detail::encode(out, args), ...);
+	}
+
+	// replaces every "{}" of the format with the next encoded argument
+	inline void format_record(std::string& out, std::string_view format, const char* args, size_t size)
+	{
+		const char* in = args;
+		const char* end = args + size;
+
+		for (size_t i = 0; i < format.size(); i++) {
+			if (format[i] == '{' && i + 1 < format.size() && format[i + 1] == '}') {
+				if (!detail::decode_arg(out, in, end))
+					out += "{?}";
+				i++;
+				continue;
+			}
+			out += format[i];
+		}
+	}
+
+	inline void format_record(std::string& out, const format_site& site, const char* args, size_t size)
+	{
+		format_record(out, std::string_view(site.format_), args, size);
+	}
+
+	// site used by logger::add for already formatted messages
+	inline const format_site& plain_site(level log_level)
+	{
+		static const format_site sites[] = {
+			{ "{}", level::debug },
+			{ "{}", level::info },
+			{ "{}", level::warning },
+			{ "{}", level::error },
+		};
+		return sites[static_cast<int>(log_level)];
+	}
+}
@@ -1,11 +1,29 @@
 #pragma once
 #include "logsdir.h"
 
+// disabled levels compile to nothing, the arguments are not evaluated
+#define LOGS_ADD(logger_, level_, ...) \
+	do { if constexpr (logs::enabled(level_)) (logger_).add(level_, __VA_ARGS__); } while (0)
+
+#define LOGS_D(logger_, ...) LOGS_ADD(logger_, logs::level::debug, __VA_ARGS__)
+#define LOGS_I(logger_, ...) LOGS_ADD(logger_, logs::level::info, __VA_ARGS__)
+#define LOGS_W(logger_, ...) LOGS_ADD(logger_, logs::level::warning, __VA_ARGS__)
+#define LOGS_E(logger_, ...) LOGS_ADD(logger_, logs::level::error, __VA_ARGS__)
+
+// deferred formatting: LOGS_FMT(log, logs::I, "sent {} bytes to {}", size, ip)
+#define LOGS_FMT(logger_, level_, format_, ...) \
+	do { \
+		if constexpr (logs::enabled(level_)) { \
+			static constexpr logs::format_site logs_site_{ format_, level_, __FILE__, __FUNCTION__, __LINE__ }; \
+			(logger_).log(logs_site_, ##__VA_ARGS__); \
+		} \
+	} while (0)
+
 namespace logs {
-	static const char* D = " [D] ";
-	static const char* I = " [I] ";
-	static const char* W = " [W] ";
-	static const char* E = " [E] ";
+	constexpr level D = level::debug;
+	constexpr level I = level::info;
+	constexpr level W = level::warning;
+	constexpr level E = level::error;
 
 	class logger { //    
 	private:
@@ -15,6 +33,21 @@ namespace logs {
 		logger(logsdir& dir);
 
 		virtual ~logger();
-		virtual void add(const char* log_level, const std::string& log);
+		virtual void add(level log_level, std::string_view log);
+
+		template<class... Args>
+		void log(const format_site& site, const Args&... args)
+		{
+			if (!enabled(site.level_)) return;
+
+			dir_->log(site, args...);
+		}
+
+		template<level L>
+		void add(std::string_view log)
+		{
+			if constexpr (enabled(L))
+				add(L, log);
+		}
 	};
 }
\ No newline at end of file
@@ -2,26 +2,244 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <iostream>
+#include <fstream>
 #include <chrono>
-#include <iomanip>
-#include <sstream>
-#include <nstd/list.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <nstd/array.h>
+#include <nstd/flat_map.h>
+#include "thread_buffer.h"
+#include "clock.h"
+#include "mapped_file.h"
+#include "network/endpoint_pool.h"
+#include "network/batch_stream.h"
+#include "network/protocol.h"
+#include "network/compression.h"
+#include "batch_pacer.h"
 
 namespace logs {
+	// what a producer does when the memory limit is reached
+	enum class overflow_policy {
+		drop_oldest,   // the oldest queued records make room
+		drop_by_level, // records below keep_level_ are dropped, the rest drop the oldest
+		block,         // producers wait until send_logs frees memory
+		spill,         // the oldest queued records go to the spool file, replayed after reconnect
+	};
+
+	struct logsdir_config {
+		size_t memory_limit_ = 0; // bytes of record storage, 0 - unlimited (one chunk per thread is always kept)
+		overflow_policy overflow_ = overflow_policy::drop_oldest;
+		level keep_level_ = level::error;
+		// spilled and recovered records, replayed in sequenced batches after a send
+		// reached the backend and kept until the backend acked them
+		std::string spool_path_ = "logs.spool";
+		// keeps record storage in a memory-mapped file that survives a crash, empty - heap;
+		// its size is memory_limit_ (or 64 chunks when unlimited); records stay in it
+		// until the backend acked their batch
+		std::string buffer_path_;
+		network::endpoint_pool_config network_; // backends the batches are spread over
+		// records at urgent_level_ and above skip batching: a dedicated thread ships
+		// them within urgent_linger_, the rest waits for send_logs
+		bool urgent_lane_ = true;
+		level urgent_level_ = level::warning;
+		std::chrono::milliseconds urgent_linger_{ 2 };
+		// a background flusher ships the batched lane, pacing itself by the round trip
+		// time and the backend's acks, send_logs stays usable next to it
+		bool auto_flush_ = false;
+		pacer_config pacer_;
+		// compresses every batch; the dictionary (see network::compression::train)
+		// is used once an ack shows the backend holds it too
+		bool compress_ = false;
+		std::string dictionary_path_;
+		// batches per lane a pipeline_ keeps in flight until the backend acks that it
+		// journaled them; a one-shot send waits for its ack, so it only ever keeps one
+		size_t retransmit_window_ = 8;
+		// every lane keeps one connection open and sends up to retransmit_window_
+		// batches on it before it waits for an ack, otherwise each batch takes a
+		// connection of its own and waits for its ack before the next one
+		bool pipeline_ = false;
+	};
+
+	// formats the unsent records left in a buffer file by an earlier run, returns their count
+	size_t recover_buffer_file(const std::string& path, std::string& out);
+
 	class logsdir {
 	private:
-		struct log {
-			std::string time_stamp_;
-			std::string log_;
+		const logsdir_config config_;
+		mapped_file mapped_;
+		memory_budget budget_;
+
+		// a batch is kept serialized until the backend acks that it journaled it, a retransmit
+		// keeps the sequence, so the backend can tell it from a new batch
+		struct unacked_batch {
+			unsigned long long sequence_ = 0;
+			size_t records_ = 0;
+			std::string frames_; // the records frame
+			nstd::array<const format_site*> sites_; // one per id the records use, defined on sending
+		};
+
+		// records of one priority, every producer thread gets its own buffer in each lane
+		struct lane {
+			// the list only grows, a new thread adopts the buffer of a dead one,
+			// so it is as long as the most threads that logged at once
+			std::atomic<thread_buffer*> buffers_{ nullptr };
+
+			// records taken from the buffers, they point into the buffers' chunks
+			// and stay valid until the chunks are released once they are batched
+			// (with a buffer file, once the batch is acked)
+			nstd::array<record> pending_;
+			unsigned long long next_order_ = 0;
+
+			// ring of batches not acked yet, oldest first, retransmit_window_ long with a
+			// pipeline and a single batch without one
+			nstd::array<unacked_batch> unacked_;
+			size_t unacked_head_ = 0;
+			size_t unacked_count_ = 0;
+
+			// pipeline_: the lane's connection, the oldest unacked_sent_ batches went out on it
+			std::unique_ptr<network::batch_stream> stream_;
+			size_t unacked_sent_ = 0;
+			nstd::array<network::protocol::ack> acks_;
+
+			// sites defined on the current connection by id, a batch defines only the others
+			// (and an id another site took over since)
+			nstd::flat_map<unsigned, const format_site*> defined_sites_;
+
+			// reused between sends so flushing does not allocate in steady state
+			nstd::array<const format_site*> batch_sites_;
+			nstd::array<unsigned> collided_ids_;
+			network::compression::compressor compressor_;
+			std::string wire_;
+			std::string raw_;
+			std::string reply_;
 		};
 
-		nstd::list<int, log> logs_;
+		lane batched_; // guarded by flush_mutex_
+		lane urgent_;  // guarded by urgent_mutex_
+		std::mutex buffers_mutex_; // a thread looking up, adopting or adding its buffers
+		std::mutex flush_mutex_; // serializes flushers and overflowing producers only
+		std::mutex urgent_mutex_; // taken after flush_mutex_
+		std::condition_variable space_cv_;
+
+		std::mutex wake_mutex_;
+		std::condition_variable urgent_cv_;
+		std::condition_variable flush_cv_;
+		std::atomic<bool> urgent_signaled_{ false };
+		bool stopping_ = false; // guarded by wake_mutex_
+		std::thread urgent_thread_;
+
+		// what one paced send observed
+		struct sent_batch {
+			size_t bytes_ = 0;
+			std::chrono::microseconds rtt_{ 0 };
+			bool acked_ = false;
+			network::protocol::ack ack_ = {};
+		};
+
+		batch_pacer pacer_; // flusher only
+		std::thread flush_thread_;
+
+		network::compression::dictionary dictionary_;
+		std::atomic<unsigned> peer_dictionary_{ 0 }; // from the last ack
+
+		std::atomic<unsigned long long> next_sequence_{ 1 }; // shared by the lanes
+
+		std::string spill_buffer_;
+		long long cached_second_ = -1;
+		char cached_time_[32] = {};
+
+		std::atomic<size_t> dropped_{ 0 };
+		std::atomic<size_t> spilled_{ 0 };
+
+		std::mutex spool_mutex_; // taken after flush_mutex_
+		std::ofstream spool_;
+		std::atomic<bool> spool_pending_{ false };
+		std::atomic<bool> replaying_{ false };
+		std::thread replay_thread_;
+
+		network::endpoint_pool pool_;
+
+		const unsigned long long id_;
+		const unsigned long long client_id_; // random, tells this logsdir's batches apart on the backend
+		const clock_anchor anchor_;
+
+		thread_buffer* local_buffer(bool urgent);
+		size_t collect_locked(lane& records);
+		void release_locked(lane& records);
+		// until_acked - returns once the backend acked every batch, pipeline_ only
+		bool send_locked(lane& records, sent_batch* stats = nullptr, bool until_acked = true);
+		void seal_batch_locked(lane& records, unacked_batch& batch);
+		// the backend acked every batch up to sequence
+		void release_acked_locked(lane& records, unsigned long long sequence);
+		bool transmit_locked(lane& records, const unacked_batch& batch, sent_batch* stats);
+		bool pipeline_locked(lane& records, sent_batch* stats, bool until_acked);
+		bool stream_batch_locked(lane& records, const unacked_batch& batch);
+		bool take_acks_locked(lane& records, std::chrono::milliseconds timeout, sent_batch* stats);
+		unsigned append_batch(lane& records, const unacked_batch& batch, std::string& out);
+		void append_sites(lane& records, const unacked_batch& batch, std::string& out);
+		unsigned append_compressed(lane& records, const std::string& frames, std::string& out);
+		size_t pushed_bytes(const lane& records) const;
+		void append_time_stamp(std::string& out, long long time_stamp);
+		void append_record(std::string& out, const record& r);
+		void append_frames(lane& records, unacked_batch& batch);
+		void signal_urgent();
+		void urgent_loop();
+		void flush_loop();
+		void open_buffer_file();
+
+		bool make_room(level log_level);
+		bool drop_oldest_locked(bool spill);
+		void write_spool(const std::string& data);
+		void start_replay();
+		void replay_spool();
+		bool send_raw(const char* data, size_t size, std::string* reply = nullptr);
 
-		int log_index = 0;
 	public:
 		logsdir();
+		logsdir(const logsdir_config& config);
 		~logsdir();
-		void add(const std::string& log);
+
+		logsdir(const logsdir&) = delete;
+		logsdir& operator=(const logsdir&) = delete;
+
+		void add(level log_level, std::string_view log);
+
+		// hot path: stores the site and the raw argument bytes, no formatting
+		template<class... Args>
+		void log(const format_site& site, const Args&... args)
+		{
+			bool urgent = config_.urgent_lane_ && site.level_ >= config_.urgent_level_;
+			thread_buffer* buffer = local_buffer(urgent);
+			long long time_stamp = now_ticks();
+
+			while (!buffer->push(time_stamp, site, args...)) {
+				if (!make_room(site.level_)) {
+					dropped_.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+			}
+
+			if (urgent)
+				signal_urgent();
+		}
+
+		// moves staged records of every thread into the send queues (ordered by time),
+		// returns how many records both lanes hold
+		size_t collect();
+		// ships the urgent lane, then the batched one
 		bool send_logs();
+
+		// drops everything staged and queued, the memory goes back to the producers
+		void clear();
+
+		// batches sent but not acked yet; they go again before anything new,
+		// a pipeline sends them again only after its connection broke
+		size_t unacked();
+
+		size_t memory_used() const;
+		size_t dropped() const;
+		size_t spilled() const;
 	};
 }
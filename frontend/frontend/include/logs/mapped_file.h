@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <string>
+
+namespace logs {
+	// Record storage backed by a memory-mapped file and split into fixed-size slots.
+	// Writing into a slot is a plain memory store, the pages outlive a crash of the
+	// process, so the next start (or recover_buffer_file) can ship what was left.
+	class mapped_file {
+	private:
+		struct file_header {
+			char magic_[8];
+			unsigned version_;
+			unsigned slot_count_;
+			unsigned long long slot_size_;
+			long long anchor_system_ns_; // clock_anchor of the run that owns the slots
+			long long anchor_ticks_;
+			std::atomic<unsigned long long> next_sequence_;
+			std::atomic<unsigned long long> free_top_; // tag << 32 | (index + 1), 0 - empty
+		};
+
+		void* file_ = nullptr;
+		void* mapping_ = nullptr;
+		char* view_ = nullptr;
+		size_t size_ = 0;
+
+		file_header* header_ = nullptr;
+		std::atomic<unsigned>* links_ = nullptr; // free list links, index + 1
+		char* slots_ = nullptr;
+		size_t slot_size_ = 0;
+		size_t slot_count_ = 0;
+
+		static size_t layout_size(size_t slot_size, size_t slot_count, size_t& slots_offset);
+
+	public:
+		mapped_file() = default;
+		~mapped_file();
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		// maps the file keeping its content, slot_count 0 takes the layout from the file
+		bool open(const std::string& path, size_t slot_size, size_t slot_count);
+		void close();
+		bool is_open() const;
+
+		// the slots hold records of an earlier run with the same layout
+		bool has_previous_run() const;
+		void previous_anchor(long long& system_ns, long long& ticks) const;
+
+		size_t slot_count() const;
+		const char* slot(size_t index) const;
+
+		// starts a new run, every slot becomes free
+		void reset(long long anchor_system_ns, long long anchor_ticks);
+
+		void* allocate(); // nullptr when every slot is in use
+		void free(void* slot);
+		unsigned long long next_sequence();
+	};
+}
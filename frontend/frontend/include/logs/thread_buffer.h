@@ -0,0 +1,462 @@
+#pragma once
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <nstd/array.h>
+#include "format.h"
+#include "mapped_file.h"
+
+namespace logs {
+	// view of a record stored inline in a thread_buffer chunk,
+	// valid until the buffer releases the chunk
+	struct record {
+		long long time_stamp_ = 0; // now_ticks() of the call
+		const format_site* site_ = nullptr;
+		const char* args_ = nullptr; // encoded arguments, formatted by the flusher
+		unsigned size_ = 0;
+		unsigned long long order_ = 0; // drain order, keeps equal stamps stable
+	};
+
+	// bytes of chunk storage shared by all buffers of a logsdir
+	struct memory_budget {
+		size_t limit_ = 0; // 0 - unlimited
+		std::atomic<size_t> used_{ 0 };
+		mapped_file* mapped_ = nullptr; // chunks live in the file's slots when set
+
+		bool try_reserve(size_t bytes)
+		{
+			size_t used = used_.load(std::memory_order_relaxed);
+			do {
+				if (limit_ && used + bytes > limit_) return false;
+			} while (!used_.compare_exchange_weak(used, used + bytes, std::memory_order_relaxed));
+			return true;
+		}
+
+		void charge(size_t bytes) { used_.fetch_add(bytes, std::memory_order_relaxed); }
+		void give_back(size_t bytes) { used_.fetch_sub(bytes, std::memory_order_relaxed); }
+		bool has_room(size_t bytes) const { return !limit_ || used_.load(std::memory_order_relaxed) + bytes <= limit_; }
+	};
+
+	// Staging buffer owned by a single producer thread. Records are bump-allocated
+	// inline into chunks and published with a release store, the flusher reads them
+	// in place without taking any lock. Consumed chunks are retired and handed back
+	// to the producer wholesale by release(), so steady-state logging does not allocate.
+	class thread_buffer {
+	private:
+		struct record_header {
+			long long time_stamp_;
+			const format_site* site_;
+			unsigned size_;
+			// mapped chunks keep a copy of the format after the header, a new
+			// process can not follow site_ when it recovers the record
+			unsigned short format_size_;
+			level level_;
+		};
+
+		struct chunk {
+			static constexpr size_t default_capacity = 64 * 1024;
+
+			std::atomic<size_t> committed_{ 0 };
+			std::atomic<chunk*> next_{ nullptr };
+			chunk* free_next_ = nullptr;
+			size_t capacity_;
+
+			// read back from a mapped file after a crash
+			unsigned long long sequence_ = 0; // 0 - nothing unsent
+			std::atomic<size_t> sent_{ 0 };
+			bool mapped_ = false;
+
+			chunk(size_t capacity) : capacity_(capacity) {}
+			char* data() { return reinterpret_cast<char*>(this + 1); }
+			const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+		};
+
+		static constexpr size_t align = alignof(record_header);
+
+		memory_budget& budget_;
+
+		// consumer side
+		chunk* head_;
+		size_t read_ = 0;
+		// consumed, still referenced by pending records, oldest first
+		chunk* retired_first_ = nullptr;
+		chunk* retired_last_ = nullptr;
+
+		// producer side
+		chunk* tail_;
+		size_t write_ = 0;
+		chunk* spare_ = nullptr;
+		std::atomic<size_t> pushed_bytes_{ 0 }; // written by the producer only
+
+		// retired chunks handed back to the producer, only popped with exchange
+		std::atomic<chunk*> free_{ nullptr };
+
+		// consumer side, where the records of each batch not acked yet end
+		struct batch_mark {
+			unsigned long long sequence_;
+			unsigned long long retired_; // chunks retired before the mark
+			chunk* chunk_; // head_ at the mark
+			size_t read_;
+		};
+		nstd::array<batch_mark> marks_; // oldest first
+		unsigned long long retired_count_ = 0;
+		unsigned long long released_count_ = 0; // handed back or dropped, in retire order
+
+		chunk* alloc_chunk(size_t capacity);
+		void start_chunk(chunk* c);
+		void free_chunk(chunk* c);
+		void free_chain(chunk* c);
+
+		chunk* next_chunk(size_t size);
+		void release_retired(unsigned long long count);
+
+	public:
+		// guarded by logsdir's buffers_mutex_: once the owner thread exited, a new thread
+		// adopts the buffer; null - made while the owner was exiting, never adopted
+		std::thread::id owner_;
+		std::shared_ptr<const std::atomic<bool>> owner_exited_;
+		thread_buffer* next_ = nullptr; // link in logsdir's buffers list
+
+		thread_buffer(std::thread::id owner, memory_budget& budget);
+		~thread_buffer();
+
+		thread_buffer(const thread_buffer&) = delete;
+		thread_buffer& operator=(const thread_buffer&) = delete;
+
+		static constexpr size_t chunk_size = sizeof(chunk) + chunk::default_capacity;
+
+		// producer only, false when a new chunk is needed and the budget is exhausted
+		template<class... Args>
+		bool push(long long time_stamp, const format_site& site, const Args&... args);
+
+		// any thread, bytes pushed so far, for pacing the flusher
+		size_t pushed_bytes() const { return pushed_bytes_.load(std::memory_order_relaxed); }
+
+		// consumer only, calls f(const record&) for every published record
+		template<class F>
+		size_t drain(F&& f);
+
+		// consumer only, every drained record is dead: hands retired chunks back
+		void release();
+		// consumer only, the records drained so far went into the batch with this sequence
+		void mark(unsigned long long sequence);
+		// consumer only, the batches up to sequence are acked: hands back their retired
+		// chunks, a mapped chunk is cut where the last of them ends so recovery skips them
+		void release(unsigned long long sequence);
+
+		// consumer only, the oldest retired chunk: stamp of its first record and
+		// the range its records live in, false when nothing is retired
+		bool oldest_retired(long long& time_stamp, const char*& begin, const char*& end);
+		// consumer only, frees the oldest retired chunk, its records must be dead
+		void drop_oldest_retired();
+
+		// any thread, frees the chunks waiting on the producer's free list
+		size_t trim();
+
+		// reads the unsent records of a mapped slot written by an earlier run, calls
+		// f(time_stamp, level, format, args, size, sequence) for each of them
+		template<class F>
+		static void recover_slot(const char* slot, F&& f);
+	};
+}
+
+namespace logs {
+	inline thread_buffer::chunk* thread_buffer::alloc_chunk(size_t capacity)
+	{
+		void* memory = nullptr;
+		if (budget_.mapped_ && capacity == chunk::default_capacity)
+			memory = budget_.mapped_->allocate();
+
+		// oversized records and a full file fall back to the heap
+		bool mapped = memory != nullptr;
+		if (!memory)
+			memory = ::operator new(sizeof(chunk) + capacity);
+
+		chunk* c = new (memory) chunk(capacity);
+		c->mapped_ = mapped;
+		start_chunk(c);
+		return c;
+	}
+
+	inline void thread_buffer::start_chunk(chunk* c)
+	{
+		c->free_next_ = nullptr;
+		c->next_.store(nullptr, std::memory_order_relaxed);
+		c->committed_.store(0, std::memory_order_relaxed);
+		c->sent_.store(0, std::memory_order_relaxed);
+		if (c->mapped_)
+			c->sequence_ = budget_.mapped_->next_sequence();
+	}
+
+	inline void thread_buffer::free_chunk(chunk* c)
+	{
+		budget_.give_back(sizeof(chunk) + c->capacity_);
+
+		bool mapped = c->mapped_;
+		c->sequence_ = 0;
+		c->~chunk();
+
+		if (mapped)
+			budget_.mapped_->free(c);
+		else
+			::operator delete(c);
+	}
+
+	inline void thread_buffer::free_chain(chunk* c)
+	{
+		while (c) {
+			chunk* next = c->free_next_;
+			free_chunk(c);
+			c = next;
+		}
+	}
+
+	inline thread_buffer::thread_buffer(std::thread::id owner, memory_budget& budget)
+		: budget_(budget), owner_(owner)
+	{
+		// every thread keeps one chunk even over the limit
+		budget_.charge(chunk_size);
+		head_ = tail_ = alloc_chunk(chunk::default_capacity);
+	}
+
+	inline thread_buffer::~thread_buffer()
+	{
+		// mapped chunks stay in the file, the unsent records are recovered on the next start
+		chunk* current = head_;
+		while (current) {
+			chunk* next = current->next_.load(std::memory_order_relaxed);
+			if (!current->mapped_) free_chunk(current);
+			current = next;
+		}
+
+		current = retired_first_;
+		while (current) {
+			chunk* next = current->free_next_;
+			if (!current->mapped_) free_chunk(current);
+			current = next;
+		}
+
+		free_chain(spare_);
+		free_chain(free_.load(std::memory_order_acquire));
+	}
+
+	inline thread_buffer::chunk* thread_buffer::next_chunk(size_t size)
+	{
+		if (size > chunk::default_capacity) {
+			if (!budget_.try_reserve(sizeof(chunk) + size)) return nullptr;
+			return alloc_chunk(size);
+		}
+
+		if (!spare_)
+			spare_ = free_.exchange(nullptr, std::memory_order_acquire);
+
+		if (!spare_) {
+			if (!budget_.try_reserve(chunk_size)) return nullptr;
+			return alloc_chunk(chunk::default_capacity);
+		}
+
+		chunk* c = spare_;
+		spare_ = c->free_next_;
+
+		start_chunk(c);
+		return c;
+	}
+
+	template<class... Args>
+	inline bool thread_buffer::push(long long time_stamp, const format_site& site, const Args&... args)
+	{
+		size_t args_size = encoded_size(args...);
+		size_t format_size = budget_.mapped_ ? std::min<size_t>(strlen(site.format_), USHRT_MAX) : 0;
+		size_t size = (sizeof(record_header) + format_size + args_size + align - 1) & ~(align - 1);
+
+		if (write_ + size > tail_->capacity_) {
+			chunk* next = next_chunk(size);
+			if (!next) return false;
+
+			tail_->next_.store(next, std::memory_order_release);
+			tail_ = next;
+			write_ = 0;
+		}
+
+		char* target = tail_->data() + write_;
+		record_header* header = reinterpret_cast<record_header*>(target);
+		header->time_stamp_ = time_stamp;
+		header->site_ = &site;
+		header->size_ = static_cast<unsigned>(args_size);
+		header->format_size_ = static_cast<unsigned short>(format_size);
+		header->level_ = site.level_;
+		memcpy(target + sizeof(record_header), site.format_, format_size);
+		encode_args(target + sizeof(record_header) + format_size, args...);
+
+		write_ += size;
+		tail_->committed_.store(write_, std::memory_order_release);
+		pushed_bytes_.store(pushed_bytes_.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+		return true;
+	}
+
+	template<class F>
+	inline size_t thread_buffer::drain(F&& f)
+	{
+		size_t drained = 0;
+
+		while (true) {
+			size_t committed = head_->committed_.load(std::memory_order_acquire);
+			while (read_ < committed) {
+				char* source = head_->data() + read_;
+				const record_header* header = reinterpret_cast<const record_header*>(source);
+
+				record r;
+				r.time_stamp_ = header->time_stamp_;
+				r.site_ = header->site_;
+				r.args_ = source + sizeof(record_header) + header->format_size_;
+				r.size_ = header->size_;
+				f(r);
+
+				read_ += (sizeof(record_header) + header->format_size_ + header->size_ + align - 1) & ~(align - 1);
+				drained++;
+			}
+
+			// the producer links the next chunk only after its last commit to this one
+			chunk* next = head_->next_.load(std::memory_order_acquire);
+			if (!next) break;
+			if (read_ != head_->committed_.load(std::memory_order_acquire)) continue;
+
+			head_->free_next_ = nullptr;
+			if (retired_last_)
+				retired_last_->free_next_ = head_;
+			else
+				retired_first_ = head_;
+			retired_last_ = head_;
+			retired_count_++;
+
+			head_ = next;
+			read_ = 0;
+		}
+
+		return drained;
+	}
+
+	inline void thread_buffer::release_retired(unsigned long long count)
+	{
+		while (retired_first_ && released_count_ < count) {
+			chunk* c = retired_first_;
+			retired_first_ = c->free_next_;
+			released_count_++;
+			c->sequence_ = 0;
+
+			if (c->capacity_ != chunk::default_capacity) {
+				free_chunk(c);
+				continue;
+			}
+
+			c->free_next_ = free_.load(std::memory_order_relaxed);
+			while (!free_.compare_exchange_weak(c->free_next_, c,
+				std::memory_order_release, std::memory_order_relaxed));
+		}
+		if (!retired_first_)
+			retired_last_ = nullptr;
+	}
+
+	inline void thread_buffer::release()
+	{
+		head_->sent_.store(read_, std::memory_order_relaxed);
+		release_retired(retired_count_);
+		marks_.clear();
+	}
+
+	inline void thread_buffer::mark(unsigned long long sequence)
+	{
+		marks_.push_back({ sequence, retired_count_, head_, read_ });
+	}
+
+	inline void thread_buffer::release(unsigned long long sequence)
+	{
+		size_t acked = 0;
+		while (acked < marks_.size() && marks_[acked].sequence_ <= sequence)
+			acked++;
+		if (!acked) return;
+
+		batch_mark last = marks_[acked - 1];
+		release_retired(last.retired_);
+		// the chunk of the mark is head_ or the oldest retired one, unless drop_oldest_retired freed it
+		if (released_count_ == last.retired_)
+			last.chunk_->sent_.store(last.read_, std::memory_order_relaxed);
+
+		while (acked--)
+			marks_.erase(0);
+	}
+
+	inline bool thread_buffer::oldest_retired(long long& time_stamp, const char*& begin, const char*& end)
+	{
+		chunk* c = retired_first_;
+		if (!c) return false;
+
+		// an empty chunk is left behind when the first record needed an oversized one
+		time_stamp = c->committed_.load(std::memory_order_relaxed)
+			? reinterpret_cast<const record_header*>(c->data())->time_stamp_
+			: LLONG_MIN;
+		begin = c->data();
+		end = c->data() + c->capacity_;
+		return true;
+	}
+
+	inline void thread_buffer::drop_oldest_retired()
+	{
+		chunk* c = retired_first_;
+		if (!c) return;
+
+		retired_first_ = c->free_next_;
+		if (!retired_first_)
+			retired_last_ = nullptr;
+		released_count_++;
+
+		free_chunk(c);
+	}
+
+	inline size_t thread_buffer::trim()
+	{
+		// the owner pops with exchange as well, whoever takes the list owns it
+		chunk* c = free_.exchange(nullptr, std::memory_order_acquire);
+
+		size_t freed = 0;
+		while (c) {
+			chunk* next = c->free_next_;
+			freed += sizeof(chunk) + c->capacity_;
+			free_chunk(c);
+			c = next;
+		}
+		return freed;
+	}
+
+	template<class F>
+	inline void thread_buffer::recover_slot(const char* slot, F&& f)
+	{
+		const chunk* c = reinterpret_cast<const chunk*>(slot);
+		if (!c->sequence_ || c->capacity_ != chunk::default_capacity) return;
+
+		size_t committed = c->committed_.load(std::memory_order_relaxed);
+		size_t read = c->sent_.load(std::memory_order_relaxed);
+		if (committed > c->capacity_) return;
+
+		while (read + sizeof(record_header) <= committed) {
+			const char* source = c->data() + read;
+			const record_header* header = reinterpret_cast<const record_header*>(source);
+
+			size_t size = sizeof(record_header) + header->format_size_ + header->size_;
+			if (read + size > committed) return;
+
+			if (header->format_size_) {
+				std::string_view format(source + sizeof(record_header), header->format_size_);
+				f(header->time_stamp_, header->level_, format,
+					source + sizeof(record_header) + header->format_size_, header->size_, c->sequence_);
+			}
+
+			read += (size + align - 1) & ~(align - 1);
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <nstd/array.h>
+#include "network/endpoint_pool.h"
+#include "network/protocol.h"
+
+namespace network {
+	// One connection that carries batches back to back. The backend acks each batch
+	// once it is journaled, in the order they came, so the sender does not wait for an
+	// ack before the next batch: a window of batches is in flight and the round trip
+	// is paid once per window instead of once per batch. A broken connection loses
+	// the acks still due, the caller sends those batches again on the next one.
+	class batch_stream {
+	private:
+		endpoint_pool& pool_;
+		std::unique_ptr<tcp_client> client_;
+		std::string inbox_; // received bytes that are not a whole frame yet
+
+		bool take_acks(nstd::array<protocol::ack>& acks);
+
+	public:
+		explicit batch_stream(endpoint_pool& pool);
+
+		bool connected() const { return client_ != nullptr; }
+
+		// connects through the pool first if needed, false closes the connection
+		bool send(const char* data, size_t size);
+		// appends the acks that arrived, waiting up to timeout for the first one,
+		// false when the connection broke (it is closed then)
+		bool receive(std::chrono::milliseconds timeout, nstd::array<protocol::ack>& acks);
+		void close();
+	};
+}
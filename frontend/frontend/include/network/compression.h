@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// LZ77 compression of log batches. Batches repeat the same site ids, formats and
+// argument layouts, so most of a batch is a copy of something seen before: in the
+// same batch or, for small batches, in a dictionary both ends load at startup.
+//
+// A stream is a sequence of (literals, match) pairs, every pair starts with a token:
+// the high nibble is the literal count, the low one the match length - min_match,
+// 15 in a nibble is continued by bytes of 255 and a final byte below 255.
+// The match distance follows the literals as a LEB128 varint and may reach back
+// into the dictionary. The last pair has literals only and ends the stream.
+namespace network {
+	namespace compression {
+		constexpr size_t min_match = 4;
+		constexpr unsigned hash_bits = 14;
+		constexpr unsigned no_position = ~0u;
+
+		// content matches may point into, identified on the wire by id(), 0 - no dictionary
+		class dictionary {
+		private:
+			std::string content_;
+			unsigned id_ = 0;
+			std::vector<unsigned> table_; // hash table over the content, copied into every compression
+
+			void prepare();
+
+		public:
+			dictionary() = default;
+			explicit dictionary(std::string content);
+
+			bool load(const std::string& path);
+			bool save(const std::string& path) const;
+
+			unsigned id() const { return id_; }
+			bool empty() const { return content_.empty(); }
+			const std::string& content() const { return content_; }
+			const std::vector<unsigned>& table() const { return table_; }
+		};
+
+		// picks the most repeated segments of the samples, the most valuable go last,
+		// closest to the data, so their distances stay short
+		dictionary train(const std::vector<std::string>& samples, size_t max_size = 32 * 1024);
+
+		// keeps its buffers between calls, one per sending thread
+		class compressor {
+		private:
+			std::string window_; // dictionary followed by the data
+			std::vector<unsigned> table_;
+
+		public:
+			// appends the stream to out, dict may be null
+			void compress(const char* data, size_t size, const dictionary* dict, std::string& out);
+		};
+
+		// appends exactly raw_size bytes to out, false on a malformed stream
+		bool decompress(const char* data, size_t size, size_t raw_size, const dictionary* dict, std::string& out);
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nstd/array.h>
+#include "network/tcp.h"
+
+namespace network {
+	struct endpoint {
+		std::string ip_;
+		unsigned short port_ = 0;
+	};
+
+	enum class balance_policy {
+		round_robin,       // batches go to the healthy endpoints in turn
+		least_outstanding, // a batch goes to the healthy endpoint with the fewest bytes in flight
+	};
+
+	struct endpoint_pool_config {
+		nstd::array<endpoint> endpoints_; // empty - 127.0.0.1:8080
+		balance_policy balance_ = balance_policy::round_robin;
+		tcp_timeouts timeouts_;
+		// an ejected endpoint waits backoff_min_ * 2^(failures - 1), up to backoff_max_,
+		// with half of the wait randomized, before the next probe
+		std::chrono::milliseconds backoff_min_{ 50 };
+		std::chrono::milliseconds backoff_max_{ 10000 };
+		std::chrono::milliseconds health_interval_{ 50 }; // how often the health thread looks for due probes
+	};
+
+	// Spreads sends over several backends. An endpoint that fails is ejected at once
+	// and the same data goes to the next one, so a dead backend costs one failed
+	// attempt instead of every send. Each endpoint is a circuit breaker: while
+	// ejected it gets no traffic until its backoff expires, then a single probe
+	// (from the health thread or a send with nowhere else to go) decides whether
+	// it returns to rotation or backs off longer.
+	class endpoint_pool {
+	private:
+		struct endpoint_state {
+			endpoint endpoint_;
+			std::atomic<bool> healthy_{ true };
+			std::atomic<size_t> outstanding_{ 0 };
+			std::atomic<unsigned> failures_{ 0 }; // in a row
+			std::atomic<long long> retry_at_{ 0 }; // steady clock ns, the breaker stays open until then
+			std::atomic<bool> probing_{ false };
+		};
+
+		const balance_policy balance_;
+		const tcp_timeouts timeouts_;
+		const std::chrono::milliseconds backoff_min_;
+		const std::chrono::milliseconds backoff_max_;
+		const std::chrono::milliseconds health_interval_;
+		std::unique_ptr<endpoint_state[]> states_;
+		size_t count_ = 0;
+		std::atomic<size_t> next_{ 0 };
+
+		// started with the first ejection
+		std::mutex health_mutex_;
+		std::condition_variable health_cv_;
+		bool stopping_ = false;
+		std::thread health_thread_;
+
+		size_t pick();
+		// runs attempt on healthy endpoints until one succeeds, then on those due a probe
+		template<class Attempt>
+		bool try_endpoints(Attempt attempt);
+		bool send_to(endpoint_state& state, const char* data, size_t size, std::string* reply);
+		void eject(endpoint_state& state);
+		void restore(endpoint_state& state);
+		bool try_probe(endpoint_state& state);
+		void health_loop();
+
+	public:
+		explicit endpoint_pool(const endpoint_pool_config& config);
+		~endpoint_pool();
+
+		endpoint_pool(const endpoint_pool&) = delete;
+		endpoint_pool& operator=(const endpoint_pool&) = delete;
+
+		// sends over one connection to a healthy endpoint, ejected ones are the last resort;
+		// with reply the sending side is closed and the backend's ack frame is read, an
+		// endpoint that sends none fails like a refused connect and the next one is tried
+		bool send(const char* data, size_t size, std::string* reply = nullptr);
+		// a connection to the endpoint send would pick, null when none could be reached;
+		// it stays open for any number of sends, its failures are the caller's to handle
+		std::unique_ptr<tcp_client> connect();
+
+		size_t size() const;
+		size_t healthy_count() const;
+		const endpoint& at(size_t index) const;
+		bool is_healthy(size_t index) const;
+	};
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Wire format between the frontend and the backend. A connection carries a
+// sequence of frames, each behind a fixed 8 byte header, integers are little-endian.
+// Data that does not start with the magic is legacy plain text.
+namespace network {
+	namespace protocol {
+		constexpr char magic[2] = { 'L', 'G' };
+		constexpr unsigned char version = 1;
+
+		enum class frame_type : unsigned char {
+			// call site dictionary, sent before the records that use it:
+			// id u32, level u8, line u32, file, function, format
+			sites = 1,
+			// id u32, time_stamp i64 (ns since the epoch), args u32 size + bytes;
+			// id 0 carries its site inline: level u8, format
+			records = 2,
+			// already formatted lines
+			text = 3,
+			// backend to client: one per batch once it is journaled, in the order the
+			// batches came, and one for the frames outside a batch after the client
+			// closed its sending side
+			ack = 4,
+			// dictionary id u32 (0 - none), raw size u32, then network/compression.h
+			// stream of the frames above; a dictionary is used once the backend acked it
+			compressed = 5,
+			// client id u64, sequence u64, then the frames of one batch: the backend acks
+			// it once journaled and does not write a retransmit again; batches may follow
+			// each other on one connection without waiting for their acks
+			batch = 6,
+		};
+
+		struct frame_header {
+			char magic_[2];
+			unsigned char version_;
+			frame_type type_;
+			unsigned length_; // payload bytes after the header
+		};
+		static_assert(sizeof(frame_header) == 8, "frame header is 8 bytes on the wire");
+
+		// what the backend reports back for one batch
+		struct ack {
+			unsigned records_;     // records taken from the batch
+			unsigned queue_depth_; // lines waiting to be written, from all clients
+			unsigned credit_;      // bytes the backend takes before it falls behind, 0 - backlogged
+			unsigned dictionary_;  // compression dictionary the backend holds, 0 - none
+			unsigned long long sequence_; // batch the backend journaled, 0 - none, send it again
+		};
+
+		template<class T>
+		inline void put(std::string& out, const T& value)
+		{
+			out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		// u16 length + bytes, longer strings are cut
+		inline void put_string(std::string& out, std::string_view text)
+		{
+			unsigned short length = static_cast<unsigned short>(text.size() < 0xffff ? text.size() : 0xffff);
+			put(out, length);
+			out.append(text.data(), length);
+		}
+
+		// returns the offset end_frame needs
+		inline size_t begin_frame(std::string& out, frame_type type)
+		{
+			size_t offset = out.size();
+			frame_header header = { { magic[0], magic[1] }, version, type, 0 };
+			put(out, header);
+			return offset;
+		}
+
+		inline void end_frame(std::string& out, size_t offset)
+		{
+			unsigned length = static_cast<unsigned>(out.size() - offset - sizeof(frame_header));
+			memcpy(&out[offset + offsetof(frame_header, length_)], &length, sizeof(length));
+		}
+
+		inline void append_ack(std::string& out, const ack& value)
+		{
+			size_t frame = begin_frame(out, frame_type::ack);
+			put(out, value.records_);
+			put(out, value.queue_depth_);
+			put(out, value.credit_);
+			put(out, value.dictionary_);
+			put(out, value.sequence_);
+			end_frame(out, frame);
+		}
+
+		// the batch's frames follow, end_frame closes it
+		inline size_t begin_batch(std::string& out, unsigned long long client_id, unsigned long long sequence)
+		{
+			size_t frame = begin_frame(out, frame_type::batch);
+			put(out, client_id);
+			put(out, sequence);
+			return frame;
+		}
+
+		inline bool is_framed(const char* data, size_t size)
+		{
+			return size >= sizeof(magic) && data[0] == magic[0] && data[1] == magic[1];
+		}
+
+		// bounds-checked reading of a frame sequence or of one payload
+		class reader {
+		private:
+			const char* in_;
+			const char* end_;
+
+		public:
+			reader(const char* data, size_t size)
+				: in_(data), end_(data + size)
+			{
+			}
+
+			bool at_end() const
+			{
+				return in_ >= end_;
+			}
+
+			size_t left() const
+			{
+				return static_cast<size_t>(end_ - in_);
+			}
+
+			template<class T>
+			bool get(T& value)
+			{
+				if (left() < sizeof(T)) return false;
+				memcpy(&value, in_, sizeof(T));
+				in_ += sizeof(T);
+				return true;
+			}
+
+			bool get_bytes(size_t size, const char*& bytes)
+			{
+				if (left() < size) return false;
+				bytes = in_;
+				in_ += size;
+				return true;
+			}
+
+			bool get_string(std::string_view& text)
+			{
+				unsigned short length;
+				const char* bytes;
+				if (!get(length) || !get_bytes(length, bytes)) return false;
+				text = std::string_view(bytes, length);
+				return true;
+			}
+
+			// false at the end of the data or on a malformed header
+			bool next_frame(frame_header& header, reader& payload)
+			{
+				const char* bytes;
+				if (!get(header)
+					|| header.magic_[0] != magic[0] || header.magic_[1] != magic[1]
+					|| header.version_ != version
+					|| !get_bytes(header.length_, bytes))
+					return false;
+
+				payload = reader(bytes, header.length_);
+				return true;
+			}
+		};
+
+		inline bool read_ack(const char* data, size_t size, ack& value)
+		{
+			reader frames(data, size);
+			frame_header header;
+			reader payload(nullptr, 0);
+			return frames.next_frame(header, payload) && header.type_ == frame_type::ack
+				&& payload.get(value.records_) && payload.get(value.queue_depth_) && payload.get(value.credit_)
+				&& payload.get(value.dictionary_) && payload.get(value.sequence_);
+		}
+	}
+}
@@ -3,25 +3,44 @@
 #define _WINSOCK_DEPRECATED_NO_WARNINGS
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#include <chrono>
 #pragma comment(lib, "ws2_32.lib")
 
 namespace network {
+	// upper bounds of one call, a stalled or black-holed peer fails the call instead of hanging it
+	struct tcp_timeouts {
+		std::chrono::milliseconds connect_{ 1000 };
+		std::chrono::milliseconds send_{ 2000 };
+		std::chrono::milliseconds recv_{ 2000 };
+	};
+
 	class tcp_client {
 	public:
-		tcp_client(const char* ip, unsigned short port);
+		tcp_client(const char* ip, unsigned short port, const tcp_timeouts& timeouts = tcp_timeouts());
 		~tcp_client();
 		bool connect();
 
 		int send(const char* data, int size);
 		int recv(char* buffer, int size);
+		// reads what has arrived, up to size bytes, waiting at most timeout for it;
+		// 0 when nothing came in time, -1 when the connection is closed or broken
+		int recv_some(char* buffer, int size, std::chrono::milliseconds timeout);
 
+		// tells the peer nothing more will be sent, the receiving side stays open
+		bool shutdown_send();
 		void disconnect();
 
 	private:
 		const char* ip_;
 		unsigned short port_;
+		tcp_timeouts timeouts_;
 
 		SOCKET sock_fd_;
 
+		// waits until the socket is readable (or writable) or the deadline passes,
+		// a failed connect counts as ready, its SO_ERROR tells why
+		bool wait(bool writable, std::chrono::steady_clock::time_point deadline);
+		void close_socket();
+
 	};
-}
\ No newline at end of file
+}
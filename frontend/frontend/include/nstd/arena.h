@@ -0,0 +1,160 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+namespace nstd {
+
+    // Monotonic memory resource: allocations are bumped out of blocks, freeing one
+    // does nothing, and release() (or the destructor) gives all blocks back at once.
+    // Meant for containers that live exactly as long as one connection or batch;
+    // rewind() keeps one block for the next batch so a steady stream of batches
+    // stops allocating at all.
+    class arena {
+    private:
+        struct block {
+            block* next_;
+            size_t size_;
+        };
+
+        block* blocks_ = nullptr;
+        char* cursor_ = nullptr;
+        char* end_ = nullptr;
+        size_t block_size_;
+        size_t blocks_count_ = 0;
+        size_t used_ = 0;
+
+    private:
+        char* add_block(size_t size);
+
+    public:
+        explicit arena(size_t block_size = 64 * 1024);
+        ~arena();
+
+        arena(const arena& other) = delete;
+        arena& operator=(const arena& other) = delete;
+
+        void* allocate(size_t bytes, size_t alignment);
+        void release();
+        void rewind();
+
+        size_t blocks() const;
+        size_t used() const;
+    };
+
+    // std::allocator compatible handle to an arena, copies share the arena
+    template<class T>
+    class arena_allocator {
+    private:
+        arena* arena_;
+
+        template<class U>
+        friend class arena_allocator;
+
+    public:
+        using value_type = T;
+
+        arena_allocator(arena& resource) noexcept : arena_(&resource) {}
+
+        template<class U>
+        arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.arena_) {}
+
+        T* allocate(size_t count) { return static_cast<T*>(arena_->allocate(count * sizeof(T), alignof(T))); }
+        void deallocate(T*, size_t) noexcept {}
+
+        template<class U>
+        bool operator==(const arena_allocator<U>& other) const { return arena_ == other.arena_; }
+        template<class U>
+        bool operator!=(const arena_allocator<U>& other) const { return arena_ != other.arena_; }
+    };
+}
+
+namespace nstd {
+    inline arena::arena(size_t block_size)
+        : block_size_(block_size)
+    {
+    }
+
+    inline arena::~arena()
+    {
+        release();
+    }
+
+    inline char* arena::add_block(size_t size)
+    {
+        // the header is padded to max_align_t, so the data after it starts aligned
+        constexpr size_t header = (sizeof(block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+        block* created = static_cast<block*>(::operator new(header + size));
+        created->next_ = blocks_;
+        created->size_ = size;
+        blocks_ = created;
+        blocks_count_++;
+        return reinterpret_cast<char*>(created) + header;
+    }
+
+    inline void* arena::allocate(size_t bytes, size_t alignment)
+    {
+        size_t padding = cursor_ ? (alignment - reinterpret_cast<size_t>(cursor_) % alignment) % alignment : 0;
+        if (!cursor_ || padding + bytes > static_cast<size_t>(end_ - cursor_)) {
+            // a request bigger than a block gets a block of its own, the current one stays in use
+            if (bytes + alignment > block_size_) {
+                char* data = add_block(bytes + alignment);
+                used_ += bytes;
+                return data + (alignment - reinterpret_cast<size_t>(data) % alignment) % alignment;
+            }
+            cursor_ = add_block(block_size_);
+            end_ = cursor_ + block_size_;
+            padding = (alignment - reinterpret_cast<size_t>(cursor_) % alignment) % alignment;
+        }
+
+        char* result = cursor_ + padding;
+        cursor_ = result + bytes;
+        used_ += bytes;
+        return result;
+    }
+
+    inline void arena::release()
+    {
+        while (blocks_) {
+            block* next = blocks_->next_;
+            ::operator delete(blocks_);
+            blocks_ = next;
+        }
+        cursor_ = nullptr;
+        end_ = nullptr;
+        blocks_count_ = 0;
+        used_ = 0;
+    }
+
+    inline void arena::rewind()
+    {
+        // the newest standard block is the one cursor_ is in, every other block goes
+        block* kept = nullptr;
+        while (blocks_) {
+            block* next = blocks_->next_;
+            if (!kept && blocks_->size_ == block_size_)
+                kept = blocks_;
+            else
+                ::operator delete(blocks_);
+            blocks_ = next;
+        }
+
+        if (kept)
+            kept->next_ = nullptr;
+        blocks_ = kept;
+        blocks_count_ = kept ? 1 : 0;
+        used_ = 0;
+        cursor_ = kept ? end_ - block_size_ : nullptr;
+        if (!kept)
+            end_ = nullptr;
+    }
+
+    inline size_t arena::blocks() const
+    {
+        return blocks_count_;
+    }
+
+    inline size_t arena::used() const
+    {
+        return used_;
+    }
+}
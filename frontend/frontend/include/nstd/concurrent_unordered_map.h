@@ -0,0 +1,213 @@
+#pragma once
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "unordered_map.h"
+
+namespace nstd {
+
+    // Hash map shared between threads. Keys are striped over shards, each an
+    // nstd::unordered_map behind its own mutex on its own cache line, so threads
+    // only wait for each other when they hit the same shard. A plain mutex, not a
+    // shared_mutex: lookups hold it for a few dozen ns, and a reader count would
+    // bounce between cores just like the mutex does while costing twice as much.
+    // Values are handed out by copy or to a callback that runs under the lock,
+    // never by reference: another thread may erase or rehash once the lock drops.
+    template<class K = int, class V = int>
+    class concurrent_unordered_map {
+    private:
+        struct alignas(64) shard {
+            mutable std::mutex mutex_;
+            unordered_map<K, V> map_;
+        };
+
+        shard* shards_;
+        size_t shards_count_;
+        unsigned shard_bits_;
+
+    private:
+        shard& shard_of(const K& key) const;
+
+    public:
+        // 0 picks four shards per hardware thread, any count is rounded up to a power of two
+        explicit concurrent_unordered_map(size_t shards = 0);
+        ~concurrent_unordered_map();
+
+        concurrent_unordered_map(const concurrent_unordered_map& other) = delete;
+        concurrent_unordered_map& operator=(const concurrent_unordered_map& other) = delete;
+
+        // true when the key was not there before
+        bool insert_or_assign(const K& key, const V& value);
+        bool erase(const K& key);
+        // erases the key only if pred(const V&) holds, checked under the shard's lock
+        template<class P>
+        bool erase_if(const K& key, P&& pred);
+
+        // copies the value to out, false when the key is missing
+        bool find(const K& key, V& out) const;
+        bool contains(const K& key) const;
+
+        // fn(V&) runs under the shard's lock. update leaves a missing key
+        // alone and returns false, upsert default constructs it first.
+        template<class F>
+        bool update(const K& key, F&& fn);
+        template<class F>
+        void upsert(const K& key, F&& fn);
+
+        // fn(const K&, const V&) for every element, one shard at a time under its lock:
+        // a snapshot of each shard, not of the whole map
+        template<class F>
+        void for_each(F&& fn) const;
+
+        void clear();
+        size_t size() const;
+        size_t shard_count() const;
+    };
+}
+
+namespace nstd {
+    template<class K, class V>
+    inline concurrent_unordered_map<K, V>::concurrent_unordered_map(size_t shards)
+    {
+        if (!shards) {
+            unsigned threads = std::thread::hardware_concurrency();
+            shards = (threads ? threads : 1) * 4;
+        }
+
+        shard_bits_ = 0;
+        while ((size_t(1) << shard_bits_) < shards)
+            shard_bits_++;
+        shards_count_ = size_t(1) << shard_bits_;
+        shards_ = new shard[shards_count_];
+    }
+
+    template<class K, class V>
+    inline concurrent_unordered_map<K, V>::~concurrent_unordered_map()
+    {
+        delete[] shards_;
+    }
+
+    template<class K, class V>
+    inline typename concurrent_unordered_map<K, V>::shard& concurrent_unordered_map<K, V>::shard_of(const K& key) const
+    {
+        if (!shard_bits_) return shards_[0];
+
+        // the top bits of a mixed hash: the shard's own map buckets by the low ones,
+        // so every bucket of it still gets keys
+        unsigned long long hash = static_cast<unsigned long long>(std::hash<K>{}(key)) * 0x9E3779B97F4A7C15ull;
+        return shards_[hash >> (64 - shard_bits_)];
+    }
+
+    template<class K, class V>
+    inline bool concurrent_unordered_map<K, V>::insert_or_assign(const K& key, const V& value)
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        size_t before = target.map_.size();
+        target.map_[key] = value;
+        return target.map_.size() != before;
+    }
+
+    template<class K, class V>
+    inline bool concurrent_unordered_map<K, V>::erase(const K& key)
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        size_t before = target.map_.size();
+        target.map_.erase(key);
+        return target.map_.size() != before;
+    }
+
+    template<class K, class V>
+    template<class P>
+    inline bool concurrent_unordered_map<K, V>::erase_if(const K& key, P&& pred)
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        V* found = target.map_.find(key);
+        if (!found || !pred(static_cast<const V&>(*found))) return false;
+
+        target.map_.erase(key);
+        return true;
+    }
+
+    template<class K, class V>
+    inline bool concurrent_unordered_map<K, V>::find(const K& key, V& out) const
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        V* found = target.map_.find(key);
+        if (!found) return false;
+
+        out = *found;
+        return true;
+    }
+
+    template<class K, class V>
+    inline bool concurrent_unordered_map<K, V>::contains(const K& key) const
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        return target.map_.find(key) != nullptr;
+    }
+
+    template<class K, class V>
+    template<class F>
+    inline bool concurrent_unordered_map<K, V>::update(const K& key, F&& fn)
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        V* found = target.map_.find(key);
+        if (!found) return false;
+
+        fn(*found);
+        return true;
+    }
+
+    template<class K, class V>
+    template<class F>
+    inline void concurrent_unordered_map<K, V>::upsert(const K& key, F&& fn)
+    {
+        shard& target = shard_of(key);
+        std::lock_guard<std::mutex> lock(target.mutex_);
+        fn(target.map_[key]);
+    }
+
+    template<class K, class V>
+    template<class F>
+    inline void concurrent_unordered_map<K, V>::for_each(F&& fn) const
+    {
+        for (size_t i = 0; i < shards_count_; i++) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+            // begin() may only look at the buckets, it never changes the map
+            for (auto& item : shards_[i].map_)
+                fn(static_cast<const K&>(item.key_), static_cast<const V&>(item.value_));
+        }
+    }
+
+    template<class K, class V>
+    inline void concurrent_unordered_map<K, V>::clear()
+    {
+        for (size_t i = 0; i < shards_count_; i++) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+            shards_[i].map_.clear();
+        }
+    }
+
+    template<class K, class V>
+    inline size_t concurrent_unordered_map<K, V>::size() const
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < shards_count_; i++) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex_);
+            total += shards_[i].map_.size();
+        }
+        return total;
+    }
+
+    template<class K, class V>
+    inline size_t concurrent_unordered_map<K, V>::shard_count() const
+    {
+        return shards_count_;
+    }
+}
@@ -1,31 +1,49 @@
 #pragma once
 #include "pair.h"
+#include "node_pool.h"
 namespace nstd {
 
     template<class K = int, class V = int>
     struct Node {
         pair<K, V> pair_;
         Node* next_;
+        size_t hash_; // the key's full hash, kept by unordered_map, 0 in a list on its own
 
-        inline Node(const K& key, const V& value, Node* next = nullptr)
-            : pair_{ key, value }, next_(next) {}
+        inline Node(const K& key, const V& value, Node* next = nullptr, size_t hash = 0)
+            : pair_{ key, value }, next_(next), hash_(hash) {}
     };
 
-    template<class K = int, class V = int>
+    // Nodes come from pool when the list is given one, otherwise from Alloc
+    // (rebound to Node), so a map can keep all of its lists in one arena.
+    template<class K = int, class V = int, class Alloc = std::allocator<pair<K, V>>>
     class list {
+    public:
+        using node_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<Node<K, V>>;
+        using pool_type = node_pool<Node<K, V>, node_allocator>;
+
     private:
         Node<K, V>* root_ = nullptr;
         size_t size_ = 0;
+        pool_type* pool_ = nullptr;
+        node_allocator alloc_;
 
         Node<K, V>* find(const K& key);
+        template<class Match>
+        bool erase_first(Match match);
 
         void add_to_list(const K& key, const V& value);
+        Node<K, V>* create_node(const K& key, const V& value, Node<K, V>* next = nullptr, size_t hash = 0);
+        void destroy_node(Node<K, V>* node);
 
     public:
-        list(const K& key, const V& value);
+        list(const K& key, const V& value, pool_type* pool = nullptr);
+        explicit list(pool_type* pool, const Alloc& alloc = Alloc());
+        explicit list(const Alloc& alloc);
         list();
         ~list();
 
+        // a copy takes its nodes from pool, not from the pool of other
+        list(const list& other, pool_type* pool);
         list(const list& other); 
         list& operator=(const list& other); 
 
@@ -40,10 +58,23 @@ namespace nstd {
 
         V* search(const K& key);
 
+        // lookups by a key and its hash: the key is only compared where the hashes
+        // match, and Q may be any type that compares equal to K (string_view for a
+        // std::string key). A key pushed with push_front must not be in the list.
+        template<class Q>
+        V* search(const Q& key, size_t hash);
+        template<class Q>
+        bool earse(const Q& key, size_t hash);
+        V& push_front(const K& key, const V& value, size_t hash);
+
         void clear();
 
         Node<K, V>* get_root();
 
+        // moving nodes between lists of the same pool without copying them
+        Node<K, V>* unlink_front();
+        void link_front(Node<K, V>* node);
+
         class iterator {
         private:
             Node<K, V>* current_;
@@ -71,33 +102,46 @@ namespace nstd {
 }
 
 namespace nstd {
-    template<class K, class V>
-    inline list<K, V>::list(const K& key, const V& value)
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list(const K& key, const V& value, pool_type* pool)
+        : pool_(pool)
     {
         size_++;
-        this->root_ = new Node<K, V>(key, value);
+        this->root_ = create_node(key, value);
+    }
+
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list(pool_type* pool, const Alloc& alloc)
+        : pool_(pool), alloc_(alloc)
+    {
+    }
+
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list(const Alloc& alloc)
+        : alloc_(alloc)
+    {
     }
 
-    template<class K, class V>
-    inline list<K, V>::list()
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list()
     {
         this->root_ = nullptr;
     }
 
-    template<class K, class V>
-    inline list<K, V>::~list()
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::~list()
     {
         this->clear();
     }
 
-    template<class K, class V>
-    inline list<K, V>::list(const list<K, V>& other) : root_(nullptr) {
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list(const list<K, V, Alloc>& other, pool_type* pool) : root_(nullptr), pool_(pool), alloc_(other.alloc_) {
         if (other.root_) {
-            root_ = new Node<K, V>(other.root_->pair_.key_, other.root_->pair_.value_);
+            root_ = create_node(other.root_->pair_.key_, other.root_->pair_.value_, nullptr, other.root_->hash_);
             Node<K, V>* current = root_;
             Node<K, V>* otherCurrent = other.root_->next_;
             while (otherCurrent) {
-                current->next_ = new Node<K, V>(otherCurrent->pair_.key_, otherCurrent->pair_.value_);
+                current->next_ = create_node(otherCurrent->pair_.key_, otherCurrent->pair_.value_, nullptr, otherCurrent->hash_);
                 current = current->next_;
                 otherCurrent = otherCurrent->next_;
             }
@@ -106,16 +150,20 @@ namespace nstd {
         }
     }
 
-    template<class K, class V>
-    inline list<K, V>& list<K, V>::operator=(const list<K, V>& other) {
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list(const list<K, V, Alloc>& other) : list(other, nullptr) {
+    }
+
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>& list<K, V, Alloc>::operator=(const list<K, V, Alloc>& other) {
         if (this != &other) {
             clear();
             if (other.root_) {
-                root_ = new Node<K, V>(other.root_->pair_.key_, other.root_->pair_.value_);
+                root_ = create_node(other.root_->pair_.key_, other.root_->pair_.value_, nullptr, other.root_->hash_);
                 Node<K, V>* current = root_;
                 Node<K, V>* otherCurrent = other.root_->next_;
                 while (otherCurrent) {
-                    current->next_ = new Node<K, V>(otherCurrent->pair_.key_, otherCurrent->pair_.value_);
+                    current->next_ = create_node(otherCurrent->pair_.key_, otherCurrent->pair_.value_, nullptr, otherCurrent->hash_);
                     current = current->next_;
                     otherCurrent = otherCurrent->next_;
                 }
@@ -125,30 +173,33 @@ namespace nstd {
         return *this;
     }
 
-    template<class K, class V>
-    inline list<K, V>::list(list<K, V>&& other) noexcept : root_(other.root_), size_(other.size_) {
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>::list(list<K, V, Alloc>&& other) noexcept : root_(other.root_), size_(other.size_), pool_(other.pool_), alloc_(other.alloc_) {
         other.root_ = nullptr;
+        other.size_ = 0;
     }
 
-    template<class K, class V>
-    inline list<K, V>& list<K, V>::operator=(list<K, V>&& other) noexcept {
+    template<class K, class V, class Alloc>
+    inline list<K, V, Alloc>& list<K, V, Alloc>::operator=(list<K, V, Alloc>&& other) noexcept {
         if (this != &other) {
             clear();
             root_ = other.root_;
             size_ = other.size_;
+            pool_ = other.pool_;
+            alloc_ = other.alloc_;
             other.root_ = nullptr;
             other.size_ = 0;
         }
         return *this;
     }
 
-    template<class K, class V>
-    inline const size_t list<K, V>::size() const {
+    template<class K, class V, class Alloc>
+    inline const size_t list<K, V, Alloc>::size() const {
         return size_;
     }
 
-    template<class K, class V>
-    inline bool list<K, V>::insert(const K& key, const V& value)
+    template<class K, class V, class Alloc>
+    inline bool list<K, V, Alloc>::insert(const K& key, const V& value)
     {
         Node<K, V>* tmp = find(key);
         if (tmp) { 
@@ -160,8 +211,8 @@ namespace nstd {
         }
     }
 
-    template<class K, class V>
-    bool list<K, V>::upsert(const K& key, const V& value)
+    template<class K, class V, class Alloc>
+    bool list<K, V, Alloc>::upsert(const K& key, const V& value)
     {
         Node<K, V>* tmp = find(key);
         if (tmp) { 
@@ -174,16 +225,17 @@ namespace nstd {
         }
     }
 
-    template<class K, class V>
-    inline bool list<K, V>::earse(const K& key)
+    template<class K, class V, class Alloc>
+    template<class Match>
+    inline bool list<K, V, Alloc>::erase_first(Match match)
     {
         if (!this->root_) return false;
 
-        if (this->root_->pair_.key_ == key) {
+        if (match(this->root_)) {
             Node<K, V>* old_root = this->root_;
             this->root_ = old_root->next_;
             size_--;
-            delete old_root;
+            destroy_node(old_root);
             return true;
         }
 
@@ -191,10 +243,10 @@ namespace nstd {
         Node<K, V>* target_node = this->root_->next_;
 
         while (target_node) {
-            if (target_node->pair_.key_ == key) {
+            if (match(target_node)) {
                 prev_node->next_ = target_node->next_;
                 size_--;
-                delete target_node;
+                destroy_node(target_node);
                 return true;
             }
             prev_node = target_node;
@@ -204,8 +256,21 @@ namespace nstd {
         return false;
     }
 
-    template<class K, class V>
-    inline V* list<K, V>::search(const K& key)
+    template<class K, class V, class Alloc>
+    inline bool list<K, V, Alloc>::earse(const K& key)
+    {
+        return erase_first([&key](const Node<K, V>* node) { return node->pair_.key_ == key; });
+    }
+
+    template<class K, class V, class Alloc>
+    template<class Q>
+    inline bool list<K, V, Alloc>::earse(const Q& key, size_t hash)
+    {
+        return erase_first([&key, hash](const Node<K, V>* node) { return node->hash_ == hash && node->pair_.key_ == key; });
+    }
+
+    template<class K, class V, class Alloc>
+    inline V* list<K, V, Alloc>::search(const K& key)
     {
         Node<K, V>* target_node = this->find(key);
         if (!target_node) return nullptr;
@@ -213,28 +278,67 @@ namespace nstd {
         return &target_node->pair_.value_;
     }
 
-    template<class K, class V>
-    inline Node<K, V>* list<K, V>::get_root()
+    template<class K, class V, class Alloc>
+    template<class Q>
+    inline V* list<K, V, Alloc>::search(const Q& key, size_t hash)
+    {
+        for (Node<K, V>* current = root_; current; current = current->next_) {
+            if (current->hash_ == hash && current->pair_.key_ == key)
+                return &current->pair_.value_;
+        }
+        return nullptr;
+    }
+
+    template<class K, class V, class Alloc>
+    inline V& list<K, V, Alloc>::push_front(const K& key, const V& value, size_t hash)
+    {
+        size_++;
+        root_ = create_node(key, value, root_, hash);
+        return root_->pair_.value_;
+    }
+
+    template<class K, class V, class Alloc>
+    inline Node<K, V>* list<K, V, Alloc>::get_root()
     {
         return root_;
     }
 
-    template<class K, class V>
-    inline void list<K, V>::clear()
+    template<class K, class V, class Alloc>
+    inline Node<K, V>* list<K, V, Alloc>::unlink_front()
+    {
+        Node<K, V>* node = root_;
+        if (node) {
+            root_ = node->next_;
+            node->next_ = nullptr;
+            size_--;
+        }
+        return node;
+    }
+
+    template<class K, class V, class Alloc>
+    inline void list<K, V, Alloc>::link_front(Node<K, V>* node)
+    {
+        node->next_ = root_;
+        root_ = node;
+        size_++;
+    }
+
+    template<class K, class V, class Alloc>
+    inline void list<K, V, Alloc>::clear()
     {
         Node<K, V>* current = root_;
         while (current != nullptr)
         {
             Node<K, V>* temp = current;
             current = current->next_;
-            delete temp;
+            destroy_node(temp);
         }
         root_ = nullptr;
         size_ = 0;
     }
 
-    template<class K, class V>
-    inline Node<K, V>* nstd::list<K, V>::find(const K& key)
+    template<class K, class V, class Alloc>
+    inline Node<K, V>* nstd::list<K, V, Alloc>::find(const K& key)
     {
         Node<K, V>* current = root_;
         while (current) {
@@ -246,10 +350,31 @@ namespace nstd {
         return nullptr;
     }
 
-    template<class K, class V>
-    void list<K, V>::add_to_list(const K& key, const V& value)
+    template<class K, class V, class Alloc>
+    void list<K, V, Alloc>::add_to_list(const K& key, const V& value)
     {
         size_++;
-        this->root_ = new Node<K, V>(key, value, this->root_);
+        this->root_ = create_node(key, value, this->root_);
+    }
+
+    template<class K, class V, class Alloc>
+    inline Node<K, V>* list<K, V, Alloc>::create_node(const K& key, const V& value, Node<K, V>* next, size_t hash)
+    {
+        if (pool_)
+            return pool_->create(key, value, next, hash);
+        Node<K, V>* node = std::allocator_traits<node_allocator>::allocate(alloc_, 1);
+        return new (node) Node<K, V>(key, value, next, hash);
+    }
+
+    template<class K, class V, class Alloc>
+    inline void list<K, V, Alloc>::destroy_node(Node<K, V>* node)
+    {
+        if (pool_) {
+            pool_->destroy(node);
+        }
+        else {
+            node->~Node<K, V>();
+            std::allocator_traits<node_allocator>::deallocate(alloc_, node, 1);
+        }
     }
 }
@@ -0,0 +1,177 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace nstd {
+
+    // Slab allocator for fixed size nodes. Nodes are cut from slabs that double in
+    // size up to max_slab nodes; a destroyed node goes on a free list that the next
+    // create takes from, and release() gives every slab back at once, so a container
+    // that churns through nodes touches malloc once per slab, not once per node.
+    // Slabs come from Alloc.
+    template<class T, class Alloc = std::allocator<T>>
+    class node_pool {
+    private:
+        union slot {
+            slot* next_;
+            alignas(T) unsigned char storage_[sizeof(T)];
+        };
+
+        struct slab {
+            slab* next_;
+            slot* slots_;
+            size_t count_;
+        };
+
+        using slot_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<slot>;
+        using slab_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<slab>;
+
+        Alloc alloc_;
+        slab* slabs_ = nullptr;
+        slot* free_ = nullptr;
+        slot* cursor_ = nullptr;     // next never used slot of the newest slab
+        slot* cursor_end_ = nullptr;
+        size_t slab_size_;
+        size_t max_slab_;
+        size_t slabs_count_ = 0;
+        size_t capacity_ = 0;
+        size_t used_ = 0;
+
+    private:
+        void* allocate();
+        void add_slab();
+
+    public:
+        explicit node_pool(size_t first_slab = 16, size_t max_slab = 4096);
+        explicit node_pool(const Alloc& alloc, size_t first_slab = 16, size_t max_slab = 4096);
+        ~node_pool();
+
+        node_pool(const node_pool& other) = delete;
+        node_pool& operator=(const node_pool& other) = delete;
+
+        template<class... Args>
+        T* create(Args&&... args);
+        void destroy(T* node);
+
+        // frees every slab, the nodes cut from them must be destroyed before
+        void release();
+
+        size_t slabs() const;
+        size_t capacity() const;
+        size_t size() const;
+    };
+}
+
+namespace nstd {
+    template<class T, class Alloc>
+    inline node_pool<T, Alloc>::node_pool(size_t first_slab, size_t max_slab)
+        : slab_size_(first_slab ? first_slab : 1),
+        max_slab_(max_slab > first_slab ? max_slab : first_slab)
+    {
+    }
+
+    template<class T, class Alloc>
+    inline node_pool<T, Alloc>::node_pool(const Alloc& alloc, size_t first_slab, size_t max_slab)
+        : alloc_(alloc),
+        slab_size_(first_slab ? first_slab : 1),
+        max_slab_(max_slab > first_slab ? max_slab : first_slab)
+    {
+    }
+
+    template<class T, class Alloc>
+    inline node_pool<T, Alloc>::~node_pool()
+    {
+        release();
+    }
+
+    template<class T, class Alloc>
+    inline void node_pool<T, Alloc>::add_slab()
+    {
+        slot_allocator slots(alloc_);
+        slab_allocator slabs(alloc_);
+        slab* created = std::allocator_traits<slab_allocator>::allocate(slabs, 1);
+        new (created) slab{ slabs_, std::allocator_traits<slot_allocator>::allocate(slots, slab_size_), slab_size_ };
+        slabs_ = created;
+        cursor_ = created->slots_;
+        cursor_end_ = created->slots_ + slab_size_;
+        slabs_count_++;
+        capacity_ += slab_size_;
+
+        if (slab_size_ < max_slab_)
+            slab_size_ = slab_size_ * 2 < max_slab_ ? slab_size_ * 2 : max_slab_;
+    }
+
+    template<class T, class Alloc>
+    inline void* node_pool<T, Alloc>::allocate()
+    {
+        slot* result = free_;
+        if (result) {
+            free_ = result->next_;
+        }
+        else {
+            if (cursor_ == cursor_end_)
+                add_slab();
+            result = cursor_++;
+        }
+        used_++;
+        return result->storage_;
+    }
+
+    template<class T, class Alloc>
+    template<class... Args>
+    inline T* node_pool<T, Alloc>::create(Args&&... args)
+    {
+        return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    template<class T, class Alloc>
+    inline void node_pool<T, Alloc>::destroy(T* node)
+    {
+        if (!node) return;
+
+        node->~T();
+        slot* freed = reinterpret_cast<slot*>(node);
+        freed->next_ = free_;
+        free_ = freed;
+        used_--;
+    }
+
+    template<class T, class Alloc>
+    inline void node_pool<T, Alloc>::release()
+    {
+        slot_allocator slots(alloc_);
+        slab_allocator slabs(alloc_);
+        while (slabs_) {
+            slab* next = slabs_->next_;
+            std::allocator_traits<slot_allocator>::deallocate(slots, slabs_->slots_, slabs_->count_);
+            std::allocator_traits<slab_allocator>::deallocate(slabs, slabs_, 1);
+            slabs_ = next;
+        }
+        free_ = nullptr;
+        cursor_ = nullptr;
+        cursor_end_ = nullptr;
+        slabs_count_ = 0;
+        capacity_ = 0;
+        used_ = 0;
+    }
+
+    template<class T, class Alloc>
+    inline size_t node_pool<T, Alloc>::slabs() const
+    {
+        return slabs_count_;
+    }
+
+    template<class T, class Alloc>
+    inline size_t node_pool<T, Alloc>::capacity() const
+    {
+        return capacity_;
+    }
+
+    template<class T, class Alloc>
+    inline size_t node_pool<T, Alloc>::size() const
+    {
+        return used_;
+    }
+}
@@ -0,0 +1,328 @@
+#pragma once
+#include "array.h"
+
+namespace nstd {
+    // nstd::array with room for N elements inside the object: a short-lived array
+    // that stays within N never touches the heap, a longer one moves to the heap
+    // on growth the way array does. shrink_to_fit brings it back in once it fits.
+    template<class T, size_t N>
+    class small_array {
+        static_assert(N > 0, "small_array needs inline room for at least one element");
+
+    private:
+        T* data_;
+        size_t size_ = 0;
+        size_t capacity_ = N;
+        alignas(T) unsigned char inline_[N * sizeof(T)];
+
+    private:
+        static T* allocate(size_t capacity);
+        static void deallocate(T* data);
+
+        T* inline_data() { return reinterpret_cast<T*>(inline_); }
+        void reallocate(size_t capacity);
+        void destroy(size_t from, size_t to);
+        size_t grown_capacity(size_t needed) const;
+        void take(small_array& other);
+
+    public:
+        small_array(size_t size);
+        small_array();
+        ~small_array();
+
+        small_array(const small_array& other);
+        small_array& operator=(const small_array& other);
+
+        small_array(small_array&& other) noexcept;
+        small_array& operator=(small_array&& other) noexcept;
+
+        void push_back(const T& value);
+        void push_back(T&& value);
+        template<class... Args>
+        T& emplace_back(Args&&... args);
+        void pop_back();
+
+        void resize(size_t size);
+        void reserve(size_t capacity);
+        void shrink_to_fit();
+        void clear();
+
+        size_t size() const;
+        size_t capacity() const;
+        bool empty() const;
+        bool on_heap() const;
+
+        T* data() const;
+
+        class iterator {
+        private:
+            T* current_;
+        public:
+            explicit iterator(small_array* arr, size_t size) : current_(arr->data_ + size) {}
+            explicit iterator(small_array* arr) : current_(arr->data_) {}
+
+            iterator& operator++() {
+                current_++;
+                return *this;
+            }
+
+            T& operator*() { return *current_; }
+            T* operator->() { return current_; }
+
+            bool operator==(const iterator& other) const { return current_ == other.current_; }
+            bool operator!=(const iterator& other) const { return current_ != other.current_; }
+        };
+
+
+        iterator begin() { return iterator(this); }
+        iterator end() { return iterator(this, size_); }
+
+        T& operator[](size_t index);
+        const T& operator[](size_t index) const;
+
+    };
+}
+
+namespace nstd {
+    template<class T, size_t N>
+    inline T* small_array<T, N>::allocate(size_t capacity)
+    {
+        return static_cast<T*>(::operator new(capacity * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::deallocate(T* data)
+    {
+        ::operator delete(data, std::align_val_t(alignof(T)));
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::reallocate(size_t capacity)
+    {
+        T* new_data = capacity <= N ? inline_data() : allocate(capacity);
+        if (new_data == data_) return;
+
+        detail::relocate(data_, size_, new_data);
+        if (on_heap())
+            deallocate(data_);
+        data_ = new_data;
+        capacity_ = capacity <= N ? N : capacity;
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::destroy(size_t from, size_t to)
+    {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            for (size_t i = from; i < to; i++)
+                data_[i].~T();
+        }
+    }
+
+    template<class T, size_t N>
+    inline size_t small_array<T, N>::grown_capacity(size_t needed) const
+    {
+        return capacity_ * 2 > needed ? capacity_ * 2 : needed;
+    }
+
+    // this is empty and inline; heap storage changes hands, inline elements move one by one
+    template<class T, size_t N>
+    inline void small_array<T, N>::take(small_array& other)
+    {
+        if (other.on_heap()) {
+            data_ = other.data_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inline_data();
+            other.capacity_ = N;
+        }
+        else {
+            detail::relocate(other.data_, other.size_, data_);
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>::small_array()
+        : data_(inline_data())
+    {
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>::small_array(size_t size)
+        : data_(inline_data())
+    {
+        resize(size);
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>::~small_array()
+    {
+        destroy(0, size_);
+        if (on_heap())
+            deallocate(data_);
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>::small_array(const small_array& other)
+        : data_(inline_data())
+    {
+        reserve(other.size_);
+        for (size_t i = 0; i < other.size_; i++) {
+            new (data_ + i) T(other.data_[i]);
+        }
+        size_ = other.size_;
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>& small_array<T, N>::operator=(const small_array& other) {
+        if (this != &other) {
+            clear();
+            reserve(other.size_);
+            for (size_t i = 0; i < other.size_; i++) {
+                new (data_ + i) T(other.data_[i]);
+            }
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>::small_array(small_array&& other) noexcept
+        : data_(inline_data())
+    {
+        take(other);
+    }
+
+    template<class T, size_t N>
+    inline small_array<T, N>& small_array<T, N>::operator=(small_array&& other) noexcept {
+        if (this != &other) {
+            clear();
+            if (on_heap()) {
+                deallocate(data_);
+                data_ = inline_data();
+                capacity_ = N;
+            }
+            take(other);
+        }
+        return *this;
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::push_back(const T& value)
+    {
+        emplace_back(value);
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::push_back(T&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template<class T, size_t N>
+    template<class... Args>
+    inline T& small_array<T, N>::emplace_back(Args&&... args)
+    {
+        if (size_ < capacity_)
+            return *new (data_ + size_++) T(std::forward<Args>(args)...);
+
+        // the new element first: args may point into the elements about to move
+        size_t capacity = grown_capacity(size_ + 1);
+        T* new_data = allocate(capacity);
+        T* created = new (new_data + size_) T(std::forward<Args>(args)...);
+        detail::relocate(data_, size_, new_data);
+        if (on_heap())
+            deallocate(data_);
+        data_ = new_data;
+        capacity_ = capacity;
+        size_++;
+        return *created;
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::pop_back()
+    {
+        destroy(size_ - 1, size_);
+        size_--;
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::resize(size_t size)
+    {
+        if (size > capacity_)
+            reallocate(grown_capacity(size));
+
+        if (size > size_) {
+            for (size_t i = size_; i < size; i++)
+                new (data_ + i) T();
+        }
+        else {
+            destroy(size, size_);
+        }
+
+        size_ = size;
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::reserve(size_t capacity)
+    {
+        if (capacity > capacity_)
+            reallocate(capacity);
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::shrink_to_fit()
+    {
+        if (on_heap() && size_ < capacity_)
+            reallocate(size_);
+    }
+
+    template<class T, size_t N>
+    inline void small_array<T, N>::clear()
+    {
+        destroy(0, size_);
+        size_ = 0;
+    }
+
+    template<class T, size_t N>
+    inline T& small_array<T, N>::operator[](size_t index)
+    {
+        return data_[index];
+    }
+
+    template<class T, size_t N>
+    inline const T& small_array<T, N>::operator[](size_t index) const
+    {
+        return data_[index];
+    }
+
+    template<class T, size_t N>
+    inline size_t small_array<T, N>::size() const
+    {
+        return size_;
+    }
+
+    template<class T, size_t N>
+    inline size_t small_array<T, N>::capacity() const
+    {
+        return capacity_;
+    }
+
+    template<class T, size_t N>
+    inline bool small_array<T, N>::empty() const
+    {
+        return size_ == 0;
+    }
+
+    template<class T, size_t N>
+    inline bool small_array<T, N>::on_heap() const
+    {
+        return data_ != reinterpret_cast<const T*>(inline_);
+    }
+
+    template<class T, size_t N>
+    T* small_array<T, N>::data() const
+    {
+        return data_;
+    }
+}
@@ -0,0 +1,234 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "ring_wait.h"
+
+namespace nstd {
+
+    // Bounded queue between exactly one producer and one consumer thread. head_
+    // and tail_ only grow and are masked into the slots, each side owns one of
+    // them on its own cache line and keeps a cached copy of the other's, so the
+    // shared line is only read again when the ring looks full or empty. A batch
+    // publishes all of its elements with one store.
+    template<class T, class Wait = spin_wait>
+    class spsc_ring {
+    private:
+        union slot {
+            slot() {}
+            ~slot() {}
+            T value_;
+        };
+
+        slot* slots_;
+        size_t mask_;
+
+        // consumer side
+        alignas(cache_line) std::atomic<size_t> head_{ 0 };
+        size_t tail_cache_ = 0;
+        Wait not_full_;
+
+        // producer side
+        alignas(cache_line) std::atomic<size_t> tail_{ 0 };
+        size_t head_cache_ = 0;
+        Wait not_empty_;
+
+    private:
+        size_t free_slots(size_t tail);
+        size_t ready_slots(size_t head);
+
+    public:
+        // capacity is rounded up to a power of two
+        explicit spsc_ring(size_t capacity);
+        ~spsc_ring();
+
+        spsc_ring(const spsc_ring& other) = delete;
+        spsc_ring& operator=(const spsc_ring& other) = delete;
+
+        // producer only
+        bool try_push(const T& value);
+        bool try_push(T&& value);
+        // moves out as many of items as fit, returns how many
+        size_t try_push_n(T* items, size_t count);
+        void push(const T& value);
+        void push(T&& value);
+        void push_n(T* items, size_t count);
+
+        // consumer only
+        bool try_pop(T& out);
+        // moves up to max elements into out, returns how many
+        size_t try_pop_n(T* out, size_t max);
+        void pop(T& out);
+        // waits for at least one element
+        size_t pop_n(T* out, size_t max);
+
+        // either side, a snapshot while the other side runs
+        size_t size() const;
+        bool empty() const;
+        size_t capacity() const;
+    };
+}
+
+namespace nstd {
+    template<class T, class Wait>
+    inline spsc_ring<T, Wait>::spsc_ring(size_t capacity)
+    {
+        size_t rounded = 1;
+        while (rounded < capacity)
+            rounded *= 2;
+        slots_ = new slot[rounded];
+        mask_ = rounded - 1;
+    }
+
+    template<class T, class Wait>
+    inline spsc_ring<T, Wait>::~spsc_ring()
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (size_t i = head_.load(std::memory_order_relaxed); i != tail; i++)
+            slots_[i & mask_].value_.~T();
+        delete[] slots_;
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::free_slots(size_t tail)
+    {
+        size_t free = mask_ + 1 - (tail - head_cache_);
+        if (!free) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            free = mask_ + 1 - (tail - head_cache_);
+        }
+        return free;
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::ready_slots(size_t head)
+    {
+        size_t ready = tail_cache_ - head;
+        if (!ready) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            ready = tail_cache_ - head;
+        }
+        return ready;
+    }
+
+    template<class T, class Wait>
+    inline bool spsc_ring<T, Wait>::try_push(const T& value)
+    {
+        T copy(value);
+        return try_push_n(&copy, 1) == 1;
+    }
+
+    template<class T, class Wait>
+    inline bool spsc_ring<T, Wait>::try_push(T&& value)
+    {
+        return try_push_n(&value, 1) == 1;
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::try_push_n(T* items, size_t count)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t free = free_slots(tail);
+        if (count > free)
+            count = free;
+        if (!count) return 0;
+
+        for (size_t i = 0; i < count; i++)
+            new (&slots_[(tail + i) & mask_].value_) T(std::move(items[i]));
+        tail_.store(tail + count, std::memory_order_release);
+        not_empty_.notify();
+        return count;
+    }
+
+    template<class T, class Wait>
+    inline void spsc_ring<T, Wait>::push(const T& value)
+    {
+        T copy(value);
+        push_n(&copy, 1);
+    }
+
+    template<class T, class Wait>
+    inline void spsc_ring<T, Wait>::push(T&& value)
+    {
+        push_n(&value, 1);
+    }
+
+    template<class T, class Wait>
+    inline void spsc_ring<T, Wait>::push_n(T* items, size_t count)
+    {
+        while (count) {
+            size_t pushed = try_push_n(items, count);
+            items += pushed;
+            count -= pushed;
+            if (count) {
+                size_t tail = tail_.load(std::memory_order_relaxed);
+                not_full_.wait_until([this, tail] { return free_slots(tail) != 0; });
+            }
+        }
+    }
+
+    template<class T, class Wait>
+    inline bool spsc_ring<T, Wait>::try_pop(T& out)
+    {
+        return try_pop_n(&out, 1) == 1;
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::try_pop_n(T* out, size_t max)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t ready = ready_slots(head);
+        if (max > ready)
+            max = ready;
+        if (!max) return 0;
+
+        for (size_t i = 0; i < max; i++) {
+            T& value = slots_[(head + i) & mask_].value_;
+            out[i] = std::move(value);
+            value.~T();
+        }
+        head_.store(head + max, std::memory_order_release);
+        not_full_.notify();
+        return max;
+    }
+
+    template<class T, class Wait>
+    inline void spsc_ring<T, Wait>::pop(T& out)
+    {
+        pop_n(&out, 1);
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::pop_n(T* out, size_t max)
+    {
+        if (!max) return 0;
+
+        size_t popped = try_pop_n(out, max);
+        while (!popped) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            not_empty_.wait_until([this, head] { return ready_slots(head) != 0; });
+            popped = try_pop_n(out, max);
+        }
+        return popped;
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::size() const
+    {
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    template<class T, class Wait>
+    inline bool spsc_ring<T, Wait>::empty() const
+    {
+        return size() == 0;
+    }
+
+    template<class T, class Wait>
+    inline size_t spsc_ring<T, Wait>::capacity() const
+    {
+        return mask_ + 1;
+    }
+}
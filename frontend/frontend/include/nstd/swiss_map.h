@@ -0,0 +1,553 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <new>
+#include <utility>
+#include "pair.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NSTD_SWISS_SSE2 1
+#include <emmintrin.h>
+#else
+#define NSTD_SWISS_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace nstd {
+    // Control bytes of swiss_map, one per slot: empty, deleted, or the 7 low bits
+    // of a full slot's hash (always >= 0, so a full byte never matches the others).
+    namespace swiss {
+        constexpr signed char empty = -128;
+        constexpr signed char deleted = -2;
+        constexpr size_t group_width = 16;
+
+        // bit i - byte i of the group
+        class bitmask {
+        private:
+            unsigned bits_;
+
+        public:
+            explicit bitmask(unsigned bits) : bits_(bits) {}
+
+            explicit operator bool() const { return bits_ != 0; }
+
+            size_t lowest() const
+            {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward(&index, bits_);
+                return index;
+#else
+                return static_cast<size_t>(__builtin_ctz(bits_));
+#endif
+            }
+
+            size_t highest() const
+            {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanReverse(&index, bits_);
+                return index;
+#else
+                return static_cast<size_t>(31 - __builtin_clz(bits_));
+#endif
+            }
+
+            void clear_lowest() { bits_ &= bits_ - 1; }
+        };
+
+        // group_width control bytes looked at with one instruction each where SSE2 is there
+        class group {
+        private:
+#if NSTD_SWISS_SSE2
+            __m128i ctrl_;
+#else
+            signed char ctrl_[group_width];
+#endif
+
+        public:
+            explicit group(const signed char* ctrl)
+            {
+#if NSTD_SWISS_SSE2
+                ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+                memcpy(ctrl_, ctrl, group_width);
+#endif
+            }
+
+            bitmask match(signed char h2) const
+            {
+#if NSTD_SWISS_SSE2
+                return bitmask(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl_))));
+#else
+                unsigned bits = 0;
+                for (size_t i = 0; i < group_width; i++)
+                    bits |= static_cast<unsigned>(ctrl_[i] == h2) << i;
+                return bitmask(bits);
+#endif
+            }
+
+            bitmask match_empty() const
+            {
+                return match(empty);
+            }
+
+            // empty and deleted are the only negative bytes
+            bitmask match_free() const
+            {
+#if NSTD_SWISS_SSE2
+                return bitmask(static_cast<unsigned>(_mm_movemask_epi8(ctrl_)));
+#else
+                unsigned bits = 0;
+                for (size_t i = 0; i < group_width; i++)
+                    bits |= static_cast<unsigned>(ctrl_[i] < 0) << i;
+                return bitmask(bits);
+#endif
+            }
+        };
+    }
+
+    // Open addressing counterpart of unordered_map with the same interface. Slots
+    // live in one array next to an array of control bytes; a lookup compares the
+    // 7 hash bits it keeps per slot for a whole group of 16 slots at once and only
+    // touches the slots that match, instead of walking a list of separate nodes.
+    // The capacity is a power of two, so the probe start is a mask, not a division.
+    template<class K = int, class V = int>
+    class swiss_map {
+    private:
+        using slot = pair<K, V>;
+
+        signed char* ctrl_ = nullptr; // capacity_ + group_width bytes, the tail mirrors the head
+        slot* slots_ = nullptr;       // constructed where ctrl_ is full
+        size_t capacity_ = 0;
+        size_t elements_count_ = 0;
+        size_t deleted_count_ = 0;
+        float load_factor_trigger_ = 0.875f;
+
+    private:
+        static size_t hash_of(const K& key);
+        static signed char h2(size_t hash) { return static_cast<signed char>(hash & 0x7f); }
+        static size_t h1(size_t hash) { return hash >> 7; }
+
+        size_t growth_limit() const;
+        void set_ctrl(size_t index, signed char value);
+
+        size_t find_index(const K& key) const;
+        size_t find_free(size_t hash) const;
+        size_t find_or_prepare(const K& key, bool& found);
+        void allocate(size_t capacity);
+        void rehash(size_t new_capacity);
+
+    public:
+        class iterator {
+        private:
+            swiss_map* map_;
+            size_t index_;
+
+            void advance_to_valid() {
+                while (index_ < map_->capacity_ && map_->ctrl_[index_] < 0)
+                    ++index_;
+            }
+        public:
+            iterator(swiss_map* map, size_t index)
+                : map_(map), index_(index) {
+                advance_to_valid();
+            }
+
+            iterator& operator++() {
+                ++index_;
+                advance_to_valid();
+                return *this;
+            }
+
+            pair<K, V>& operator*() { return map_->slots_[index_]; }
+            pair<K, V>* operator->() { return &map_->slots_[index_]; }
+
+            bool operator==(const iterator& other) const { return index_ == other.index_; }
+            bool operator!=(const iterator& other) const { return !(*this == other); }
+        };
+
+    public:
+        swiss_map();
+
+        swiss_map(const std::initializer_list<pair<K, V>>& args);
+
+        swiss_map(const swiss_map& other);
+        swiss_map(swiss_map&& other) noexcept;
+        ~swiss_map();
+
+        swiss_map& operator=(const swiss_map& other);
+        swiss_map& operator=(swiss_map&& other) noexcept;
+
+        V& at(const K& key);
+        V& operator[](const K& key);
+
+        void insert(const pair<K, V>& p);
+        void emplace(K&& key, V&& value);
+        void erase(const K& key);
+        void clear();
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, capacity_); }
+
+        bool contains(const K& key);
+
+        bool empty() const;
+        size_t size() const;
+        size_t max_size() const;
+
+        size_t bucket_count() const;
+        float load_factor() const;
+        // open addressing needs free slots to end a probe, the trigger stays within [0.25, 0.875]
+        void set_load_factor_trigger(float load_factor_trigger);
+        void reserve(size_t size);
+        void resize(size_t size);
+    };
+}
+
+namespace nstd {
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::hash_of(const K& key)
+    {
+        // std::hash of an integer is often the integer itself, h1 and h2 need all of its bits
+        unsigned long long hash = static_cast<unsigned long long>(std::hash<K>{}(key)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash ^ (hash >> 32));
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::growth_limit() const
+    {
+        return static_cast<size_t>(capacity_ * load_factor_trigger_);
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::set_ctrl(size_t index, signed char value)
+    {
+        ctrl_[index] = value;
+        if (index < swiss::group_width)
+            ctrl_[capacity_ + index] = value;
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::find_index(const K& key) const
+    {
+        if (!capacity_) return 0;
+
+        size_t hash = hash_of(key);
+        size_t mask = capacity_ - 1;
+        size_t pos = h1(hash) & mask;
+
+        // groups are visited at triangular offsets, which reaches every group of a power of two table
+        for (size_t step = swiss::group_width; ; step += swiss::group_width) {
+            swiss::group group(ctrl_ + pos);
+            for (swiss::bitmask match = group.match(h2(hash)); match; match.clear_lowest()) {
+                size_t index = (pos + match.lowest()) & mask;
+                if (slots_[index].key_ == key)
+                    return index;
+            }
+
+            // a probe ends at the first group with an empty slot, the key would be before it
+            if (group.match_empty())
+                return capacity_;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::find_free(size_t hash) const
+    {
+        size_t mask = capacity_ - 1;
+        size_t pos = h1(hash) & mask;
+        for (size_t step = swiss::group_width; ; step += swiss::group_width) {
+            swiss::bitmask free = swiss::group(ctrl_ + pos).match_free();
+            if (free)
+                return (pos + free.lowest()) & mask;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::find_or_prepare(const K& key, bool& found)
+    {
+        size_t index = find_index(key);
+        found = capacity_ && index != capacity_;
+        if (found) return index;
+
+        if (!capacity_ || elements_count_ + deleted_count_ + 1 > growth_limit()) {
+            // a table full of tombstones is cleaned at the same size, a full one doubles
+            rehash(elements_count_ + 1 <= growth_limit() / 2 ? capacity_ : capacity_ * 2);
+        }
+
+        size_t hash = hash_of(key);
+        index = find_free(hash);
+        if (ctrl_[index] == swiss::deleted)
+            deleted_count_--;
+        set_ctrl(index, h2(hash));
+        elements_count_++;
+        return index;
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::allocate(size_t capacity)
+    {
+        capacity_ = capacity;
+        deleted_count_ = 0;
+        ctrl_ = new signed char[capacity + swiss::group_width];
+        memset(ctrl_, swiss::empty, capacity + swiss::group_width);
+        slots_ = static_cast<slot*>(::operator new(capacity * sizeof(slot)));
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::rehash(size_t new_capacity)
+    {
+        size_t capacity = swiss::group_width;
+        while (capacity < new_capacity)
+            capacity *= 2;
+
+        signed char* old_ctrl = ctrl_;
+        slot* old_slots = slots_;
+        size_t old_capacity = capacity_;
+
+        allocate(capacity);
+        for (size_t i = 0; i < old_capacity; ++i) {
+            if (old_ctrl[i] < 0) continue;
+
+            size_t hash = hash_of(old_slots[i].key_);
+            size_t index = find_free(hash);
+            set_ctrl(index, h2(hash));
+            new (&slots_[index]) slot(std::move(old_slots[i]));
+            old_slots[i].~slot();
+        }
+
+        delete[] old_ctrl;
+        ::operator delete(old_slots);
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>::swiss_map()
+    {
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>::swiss_map(const std::initializer_list<pair<K, V>>& args)
+    {
+        for (const auto& arg : args) {
+            insert(arg);
+        }
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>::swiss_map(const swiss_map& other)
+        : elements_count_(other.elements_count_),
+        load_factor_trigger_(other.load_factor_trigger_)
+    {
+        if (!other.capacity_) return;
+
+        allocate(other.capacity_);
+        deleted_count_ = other.deleted_count_;
+        memcpy(ctrl_, other.ctrl_, capacity_ + swiss::group_width);
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0)
+                new (&slots_[i]) slot(other.slots_[i]);
+        }
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>& swiss_map<K, V>::operator=(const swiss_map& other) {
+        if (this != &other) {
+            swiss_map temp(other);
+            std::swap(ctrl_, temp.ctrl_);
+            std::swap(slots_, temp.slots_);
+            std::swap(capacity_, temp.capacity_);
+            std::swap(elements_count_, temp.elements_count_);
+            std::swap(deleted_count_, temp.deleted_count_);
+            std::swap(load_factor_trigger_, temp.load_factor_trigger_);
+        }
+        return *this;
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>::swiss_map(swiss_map&& other) noexcept
+        : ctrl_(other.ctrl_),
+        slots_(other.slots_),
+        capacity_(other.capacity_),
+        elements_count_(other.elements_count_),
+        deleted_count_(other.deleted_count_),
+        load_factor_trigger_(other.load_factor_trigger_)
+    {
+        other.ctrl_ = nullptr;
+        other.slots_ = nullptr;
+        other.capacity_ = 0;
+        other.elements_count_ = 0;
+        other.deleted_count_ = 0;
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>& swiss_map<K, V>::operator=(swiss_map&& other) noexcept {
+        if (this != &other) {
+            clear();
+            ctrl_ = other.ctrl_;
+            slots_ = other.slots_;
+            capacity_ = other.capacity_;
+            elements_count_ = other.elements_count_;
+            deleted_count_ = other.deleted_count_;
+            load_factor_trigger_ = other.load_factor_trigger_;
+            other.ctrl_ = nullptr;
+            other.slots_ = nullptr;
+            other.capacity_ = 0;
+            other.elements_count_ = 0;
+            other.deleted_count_ = 0;
+        }
+        return *this;
+    }
+
+    template<class K, class V>
+    inline swiss_map<K, V>::~swiss_map()
+    {
+        clear();
+    }
+
+    template<class K, class V>
+    inline V& swiss_map<K, V>::at(const K& key)
+    {
+        bool found;
+        size_t index = find_or_prepare(key, found);
+        if (!found)
+            new (&slots_[index]) slot(key, V());
+        return slots_[index].value_;
+    }
+
+    template<class K, class V>
+    inline V& swiss_map<K, V>::operator[](const K& key)
+    {
+        return at(key);
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::insert(const pair<K, V>& p)
+    {
+        bool found;
+        size_t index = find_or_prepare(p.key_, found);
+        if (!found)
+            new (&slots_[index]) slot(p);
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::emplace(K&& key, V&& value)
+    {
+        bool found;
+        size_t index = find_or_prepare(key, found);
+        if (found) return;
+
+        slot* created = new (&slots_[index]) slot();
+        created->key_ = std::move(key);
+        created->value_ = std::move(value);
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::erase(const K& key)
+    {
+        size_t index = find_index(key);
+        if (!capacity_ || index == capacity_) return;
+
+        slots_[index].~slot();
+        elements_count_--;
+
+        // a slot no probe went past on its way to an empty one can be empty again,
+        // that is, no group around it was ever full
+        size_t mask = capacity_ - 1;
+        swiss::bitmask empty_after = swiss::group(ctrl_ + index).match_empty();
+        swiss::bitmask empty_before = swiss::group(ctrl_ + ((index - swiss::group_width) & mask)).match_empty();
+        size_t full_after = empty_after ? empty_after.lowest() : swiss::group_width;
+        size_t full_before = empty_before ? swiss::group_width - 1 - empty_before.highest() : swiss::group_width;
+        if (full_after + full_before < swiss::group_width) {
+            set_ctrl(index, swiss::empty);
+        }
+        else {
+            set_ctrl(index, swiss::deleted);
+            deleted_count_++;
+        }
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::clear()
+    {
+        if (!ctrl_) return;
+
+        for (size_t i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0)
+                slots_[i].~slot();
+        }
+        delete[] ctrl_;
+        ::operator delete(slots_);
+        ctrl_ = nullptr;
+        slots_ = nullptr;
+        capacity_ = 0;
+        elements_count_ = 0;
+        deleted_count_ = 0;
+    }
+
+    template<class K, class V>
+    inline bool swiss_map<K, V>::contains(const K& key)
+    {
+        return capacity_ && find_index(key) != capacity_;
+    }
+
+    template<class K, class V>
+    inline bool swiss_map<K, V>::empty() const
+    {
+        return elements_count_ == 0;
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::size() const
+    {
+        return elements_count_;
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::max_size() const
+    {
+        return static_cast<size_t>(-1) / (sizeof(slot) + 1);
+    }
+
+    template<class K, class V>
+    inline size_t swiss_map<K, V>::bucket_count() const
+    {
+        return capacity_;
+    }
+
+    template<class K, class V>
+    inline float swiss_map<K, V>::load_factor() const
+    {
+        return capacity_ ? static_cast<float>(elements_count_) / static_cast<float>(capacity_) : 0.0f;
+    }
+
+    template<class K, class V>
+    void swiss_map<K, V>::set_load_factor_trigger(float load_factor_trigger)
+    {
+        if (load_factor_trigger < 0.25f) load_factor_trigger = 0.25f;
+        if (load_factor_trigger > 0.875f) load_factor_trigger = 0.875f;
+        load_factor_trigger_ = load_factor_trigger;
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::reserve(size_t size)
+    {
+        size_t needed = static_cast<size_t>(size / load_factor_trigger_) + 1;
+        if (needed > capacity_)
+            rehash(needed);
+    }
+
+    template<class K, class V>
+    inline void swiss_map<K, V>::resize(size_t size)
+    {
+        size_t needed = static_cast<size_t>(elements_count_ / load_factor_trigger_) + 1;
+        rehash(size > needed ? size : needed);
+    }
+}
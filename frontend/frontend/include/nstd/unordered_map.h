@@ -1,49 +1,103 @@
 #pragma once
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include "hash.h"
 #include "list.h"
-#include "array.h"
+#include "node_pool.h"
 
 #define DEFAULT_BUCKETS_COUNT 16
 
 namespace nstd {
 
 
-    template<class K = int, class V = int>
+    // Everything the map allocates (bucket arrays, the node and list pools and
+    // their slabs) comes from Alloc rebound to the type at hand.
+    // Every node keeps its key's hash: a rehash moves nodes by the stored hash and
+    // a lookup compares keys only where the hashes match. With a transparent Hash
+    // (nstd::hash<std::string> is one) find and contains take any key type the
+    // hash and K's operator== accept. Hash comes after Alloc so that the
+    // <K, V, Alloc> spelling keeps working.
+    template<class K = int, class V = int, class Alloc = std::allocator<pair<K, V>>, class Hash = hash<K>>
     class unordered_map {
     private:
+        template<class T>
+        using rebind = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+        using node_pool_type = typename list<K, V, Alloc>::pool_type;
+        using list_pool_type = node_pool<list<K, V, Alloc>, rebind<list<K, V, Alloc>>>;
+
+        Alloc alloc_;
+        Hash hasher_;
         float load_factor_ = 0.0f;
         float load_factor_trigger_ = 1.0f;
-        size_t buckets_count_;
+        size_t buckets_count_ = 0;
         size_t elements_count_ = 0;
 
-        array<list<K, V>*>* buckets_;
+        list<K, V, Alloc>** buckets_ = nullptr;
+
+        // bucket lists and their nodes live in slabs owned by the map, rehash relinks
+        // nodes instead of copying them and clear() frees whole slabs
+        node_pool_type* nodes_ = nullptr;
+        list_pool_type* lists_ = nullptr;
+
+        // incremental rehash: while old_buckets_ is set, the table it replaced is still
+        // being emptied into buckets_, rehash_step_ buckets per operation. A bucket
+        // below migrated_ is already empty, a key above it may sit in either table.
+        list<K, V, Alloc>** old_buckets_ = nullptr;
+        size_t old_buckets_count_ = 0;
+        size_t migrated_ = 0;
+        size_t rehash_step_ = 0;
 
     private:
-        array<list<K, V>*>* alloc_buckets(size_t count);
+        list<K, V, Alloc>** alloc_buckets(size_t count);
+        void free_buckets(list<K, V, Alloc>** buckets, size_t count);
+        template<class T, class... Args>
+        T* create_object(Args&&... args);
+        template<class T>
+        void destroy_object(T* object);
+        void init_pools();
+        list<K, V, Alloc>* create_list();
         bool check_buckets_present();
         void init_buckets(size_t size = DEFAULT_BUCKETS_COUNT);
 
-        size_t get_index(const K& key) const;
+        size_t index_of(size_t hash) const;
         void rehash(size_t new_bucket_count);
 
         void rehash_if_need();
 
+        list<K, V, Alloc>** copy_buckets(list<K, V, Alloc>* const* other, size_t count);
+        void destroy_buckets(list<K, V, Alloc>** buckets, size_t count);
+        void begin_rehash(size_t new_bucket_count);
+        void migrate_bucket(size_t index);
+        void migrate(size_t buckets);
+        list<K, V, Alloc>* old_list_of(size_t hash) const;
+        template<class Q>
+        V* find_hashed(const Q& key, size_t hash);
+
+        // the new table first, then whatever the old one still holds
+        size_t buckets_total() const { return buckets_count_ + old_buckets_count_; }
+        list<K, V, Alloc>* bucket_at(size_t index) const {
+            return index < buckets_count_ ? buckets_[index] : old_buckets_[index - buckets_count_];
+        }
+
     public:
         class iterator {
         private:
             unordered_map* map_;
             size_t bucket_idx_;
-            typename list<K, V>::iterator list_it_;
+            typename list<K, V, Alloc>::iterator list_it_;
 
             void advance_to_valid() {
-                while (bucket_idx_ < map_->buckets_count_ && (!(*map_->buckets_)[bucket_idx_] || list_it_ == (*map_->buckets_)[bucket_idx_]->end())) {
+                while (bucket_idx_ < map_->buckets_total() && (!map_->bucket_at(bucket_idx_) || list_it_ == map_->bucket_at(bucket_idx_)->end())) {
                     ++bucket_idx_;
-                    if (bucket_idx_ < map_->buckets_count_ && (*map_->buckets_)[bucket_idx_]) {
-                        list_it_ = (*map_->buckets_)[bucket_idx_]->begin();
+                    if (bucket_idx_ < map_->buckets_total() && map_->bucket_at(bucket_idx_)) {
+                        list_it_ = map_->bucket_at(bucket_idx_)->begin();
                     }
                 }
             }
         public:
-            iterator(unordered_map* map, size_t bucket_idx, typename list<K, V>::iterator list_it)
+            iterator(unordered_map* map, size_t bucket_idx, typename list<K, V, Alloc>::iterator list_it)
                 : map_(map), bucket_idx_(bucket_idx), list_it_(list_it) {
                 advance_to_valid();
             }
@@ -66,6 +120,7 @@ namespace nstd {
 
     public:
         unordered_map();
+        explicit unordered_map(const Alloc& alloc);
 
         unordered_map(const std::initializer_list<pair<K, V>>& args);
 
@@ -85,16 +140,25 @@ namespace nstd {
         void clear();
 
         iterator begin() {
-            for (size_t i = 0; i < buckets_count_; ++i) {
-                if ((*buckets_)[i]) {
-                    return iterator(this, i, (*buckets_)[i]->begin());
+            for (size_t i = 0; i < buckets_total(); ++i) {
+                if (bucket_at(i)) {
+                    return iterator(this, i, bucket_at(i)->begin());
                 }
             }
             return end();
         }
-        iterator end() { return iterator(this, buckets_count_, typename list<K, V>::iterator(nullptr)); }
+        iterator end() { return iterator(this, buckets_total(), typename list<K, V, Alloc>::iterator(nullptr)); }
 
         bool contains(const K& key);
+        // pointer to the value or nullptr; unlike contains() and at() it never inserts or
+        // moves an incremental rehash along, so readers that share a lock may call it
+        V* find(const K& key);
+
+        // the same lookups without converting key to K first
+        template<class Q, class H = Hash, class = std::enable_if_t<is_transparent<H>::value>>
+        bool contains(const Q& key);
+        template<class Q, class H = Hash, class = std::enable_if_t<is_transparent<H>::value>>
+        V* find(const Q& key);
 
         bool empty() const;
         size_t size() const;
@@ -106,21 +170,78 @@ namespace nstd {
         void reserve(size_t size);
         void resize(size_t size);
 
+        // 0 (the default) doubles the table inside the insert that fills it; otherwise the
+        // new table is filled buckets_per_operation buckets at a time by later operations
+        void set_incremental_rehash(size_t buckets_per_operation);
+        bool rehashing() const;
+
+        Alloc get_allocator() const;
+
     };
 
 }
 
 namespace nstd {
-    template<class K, class V>
-    inline array<list<K, V>*>* unordered_map<K, V>::alloc_buckets(size_t count)
+    template<class K, class V, class Alloc, class Hash>
+    inline list<K, V, Alloc>** unordered_map<K, V, Alloc, Hash>::alloc_buckets(size_t count)
+    {
+        // calloc leaves zeroing a large table to the pages it touches, a rehash does not pay it up front
+        if constexpr (std::is_same<rebind<list<K, V, Alloc>*>, std::allocator<list<K, V, Alloc>*>>::value)
+            return static_cast<list<K, V, Alloc>**>(calloc(count, sizeof(list<K, V, Alloc>*)));
+
+        rebind<list<K, V, Alloc>*> alloc(alloc_);
+        list<K, V, Alloc>** buckets = std::allocator_traits<rebind<list<K, V, Alloc>*>>::allocate(alloc, count);
+        memset(buckets, 0, count * sizeof(list<K, V, Alloc>*));
+        return buckets;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::free_buckets(list<K, V, Alloc>** buckets, size_t count)
+    {
+        if constexpr (std::is_same<rebind<list<K, V, Alloc>*>, std::allocator<list<K, V, Alloc>*>>::value) {
+            free(buckets);
+        }
+        else {
+            rebind<list<K, V, Alloc>*> alloc(alloc_);
+            std::allocator_traits<rebind<list<K, V, Alloc>*>>::deallocate(alloc, buckets, count);
+        }
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    template<class T, class... Args>
+    inline T* unordered_map<K, V, Alloc, Hash>::create_object(Args&&... args)
+    {
+        rebind<T> alloc(alloc_);
+        T* object = std::allocator_traits<rebind<T>>::allocate(alloc, 1);
+        return new (object) T(std::forward<Args>(args)...);
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    template<class T>
+    inline void unordered_map<K, V, Alloc, Hash>::destroy_object(T* object)
+    {
+        if (!object) return;
+
+        object->~T();
+        rebind<T> alloc(alloc_);
+        std::allocator_traits<rebind<T>>::deallocate(alloc, object, 1);
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::init_pools()
     {
-        array<list<K, V>*>* new_buckets = new array<list<K, V>*>(count);
-        memset(new_buckets->data(), 0, count * sizeof(list<K, V>*));
-        return new_buckets;
+        if (!nodes_) nodes_ = create_object<node_pool_type>(typename list<K, V, Alloc>::node_allocator(alloc_));
+        if (!lists_) lists_ = create_object<list_pool_type>(rebind<list<K, V, Alloc>>(alloc_));
     }
 
-    template<class K, class V>
-    inline bool unordered_map<K, V>::check_buckets_present()
+    template<class K, class V, class Alloc, class Hash>
+    inline list<K, V, Alloc>* unordered_map<K, V, Alloc, Hash>::create_list()
+    {
+        return lists_->create(nodes_, alloc_);
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline bool unordered_map<K, V, Alloc, Hash>::check_buckets_present()
     {
         if (!buckets_) {
             init_buckets();
@@ -130,102 +251,245 @@ namespace nstd {
         return true;
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::init_buckets(size_t size)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::init_buckets(size_t size)
     {
         elements_count_ = 0;
         buckets_count_ = size;
         buckets_ = alloc_buckets(size);
+        init_pools();
     }
 
-    template<class K, class V>
-    inline size_t unordered_map<K, V>::get_index(const K& key) const
+    template<class K, class V, class Alloc, class Hash>
+    inline size_t unordered_map<K, V, Alloc, Hash>::index_of(size_t hash) const
     {
-        return std::hash<K>{}(key) % buckets_count_;
+        return hash % buckets_count_;
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::rehash_if_need()
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::rehash_if_need()
     {
+        if (old_buckets_)
+            migrate(rehash_step_);
+
         load_factor_ = static_cast<double>(elements_count_) / static_cast<double>(buckets_count_);
-        if (load_factor_ >= load_factor_trigger_) {
+        if (load_factor_ >= load_factor_trigger_ && !old_buckets_) {
             //std::cout << "REHASHING!" << std::endl
             //    << "elements_count_" << elements_count_ << std::endl
             //    << "buckets_count_" << buckets_count_ << std::endl
             //    << "load_factor_ :" << load_factor_ << std::endl;
-            rehash(buckets_count_ * 2);
+            if (rehash_step_) {
+                begin_rehash(buckets_count_ * 2);
+                migrate(rehash_step_);
+            }
+            else {
+                rehash(buckets_count_ * 2);
+            }
+        }
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline list<K, V, Alloc>** unordered_map<K, V, Alloc, Hash>::copy_buckets(list<K, V, Alloc>* const* other, size_t count)
+    {
+        list<K, V, Alloc>** buckets = alloc_buckets(count);
+        for (size_t i = 0; i < count; ++i) {
+            list<K, V, Alloc>* other_list = other[i];
+            if (other_list)
+                buckets[i] = lists_->create(*other_list, nodes_);
+        }
+        return buckets;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::destroy_buckets(list<K, V, Alloc>** buckets, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            list<K, V, Alloc>* curr = buckets[i];
+            if (curr)
+                lists_->destroy(curr);
+        }
+        free_buckets(buckets, count);
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::begin_rehash(size_t new_bucket_count)
+    {
+        if (old_buckets_)
+            migrate(old_buckets_count_);
+
+        old_buckets_ = buckets_;
+        old_buckets_count_ = buckets_count_;
+        migrated_ = 0;
+        buckets_ = alloc_buckets(new_bucket_count);
+        buckets_count_ = new_bucket_count;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::migrate_bucket(size_t index)
+    {
+        list<K, V, Alloc>* curr_list = old_buckets_[index];
+        if (!curr_list) return;
+
+        // keys in a bucket are already unique, nodes move over as they are, by the hash they keep
+        while (Node<K, V>* node = curr_list->unlink_front()) {
+            list<K, V, Alloc>** new_list = &(buckets_[index_of(node->hash_)]);
+            if (!(*new_list))
+                *new_list = create_list();
+            (*new_list)->link_front(node);
+        }
+        lists_->destroy(curr_list);
+        old_buckets_[index] = nullptr;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::migrate(size_t buckets)
+    {
+        size_t end = old_buckets_count_ - migrated_ > buckets ? migrated_ + buckets : old_buckets_count_;
+        for (; migrated_ < end; ++migrated_)
+            migrate_bucket(migrated_);
+
+        if (migrated_ == old_buckets_count_) {
+            free_buckets(old_buckets_, old_buckets_count_);
+            old_buckets_ = nullptr;
+            old_buckets_count_ = 0;
+            migrated_ = 0;
+        }
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline list<K, V, Alloc>* unordered_map<K, V, Alloc, Hash>::old_list_of(size_t hash) const
+    {
+        if (!old_buckets_) return nullptr;
+        return old_buckets_[hash % old_buckets_count_];
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    template<class Q>
+    inline V* unordered_map<K, V, Alloc, Hash>::find_hashed(const Q& key, size_t hash)
+    {
+        if (list<K, V, Alloc>* old_list = old_list_of(hash)) {
+            if (V* result = old_list->search(key, hash))
+                return result;
         }
+
+        list<K, V, Alloc>* curr_list = buckets_[index_of(hash)];
+        return curr_list ? curr_list->search(key, hash) : nullptr;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>::unordered_map()
+    {
+        init_buckets();
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>::unordered_map()
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>::unordered_map(const Alloc& alloc)
+        : alloc_(alloc)
     {
-        buckets_count_ = DEFAULT_BUCKETS_COUNT;
-        buckets_ = alloc_buckets(DEFAULT_BUCKETS_COUNT);
+        init_buckets();
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>::unordered_map(const std::initializer_list<pair<K, V>>& args)
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>::unordered_map(const std::initializer_list<pair<K, V>>& args)
     {
         for (const auto arg : args) {
             insert(arg);
         }
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>::unordered_map(const unordered_map& other)
-        : load_factor_(other.load_factor_),
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>::unordered_map(const unordered_map& other)
+        : alloc_(std::allocator_traits<Alloc>::select_on_container_copy_construction(other.alloc_)),
+        hasher_(other.hasher_),
+        load_factor_(other.load_factor_),
         load_factor_trigger_(other.load_factor_trigger_),
         buckets_count_(other.buckets_count_),
-        elements_count_(0)
-    {
-        buckets_ = alloc_buckets(buckets_count_);
-        for (size_t i = 0; i < other.buckets_->size(); ++i) {
-            list<K, V>* other_list = (*other.buckets_)[i];
-            if (other_list) {
-                (*buckets_)[i] = new list<K, V>(*other_list);
-                elements_count_ += other_list->size();
-            }
-        }
+        elements_count_(other.elements_count_),
+        old_buckets_count_(other.old_buckets_count_),
+        migrated_(other.migrated_),
+        rehash_step_(other.rehash_step_)
+    {
+        if (!other.buckets_) return;
+
+        init_pools();
+        buckets_ = copy_buckets(other.buckets_, buckets_count_);
+        if (other.old_buckets_)
+            old_buckets_ = copy_buckets(other.old_buckets_, old_buckets_count_);
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>& unordered_map<K, V>::operator=(const unordered_map& other) {
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>& unordered_map<K, V, Alloc, Hash>::operator=(const unordered_map& other) {
         if (this != &other) {
             unordered_map temp(other);
+            std::swap(alloc_, temp.alloc_);
+            std::swap(hasher_, temp.hasher_);
             std::swap(load_factor_, temp.load_factor_);
             std::swap(load_factor_trigger_, temp.load_factor_trigger_);
             std::swap(buckets_count_, temp.buckets_count_);
             std::swap(elements_count_, temp.elements_count_);
             std::swap(buckets_, temp.buckets_);
+            std::swap(nodes_, temp.nodes_);
+            std::swap(lists_, temp.lists_);
+            std::swap(old_buckets_, temp.old_buckets_);
+            std::swap(old_buckets_count_, temp.old_buckets_count_);
+            std::swap(migrated_, temp.migrated_);
+            std::swap(rehash_step_, temp.rehash_step_);
         }
         return *this;
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>::unordered_map(unordered_map&& other) noexcept
-        : load_factor_(other.load_factor_),
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>::unordered_map(unordered_map&& other) noexcept
+        : alloc_(other.alloc_),
+        hasher_(other.hasher_),
+        load_factor_(other.load_factor_),
         load_factor_trigger_(other.load_factor_trigger_),
         buckets_count_(other.buckets_count_),
         elements_count_(other.elements_count_),
-        buckets_(other.buckets_)
+        buckets_(other.buckets_),
+        nodes_(other.nodes_),
+        lists_(other.lists_),
+        old_buckets_(other.old_buckets_),
+        old_buckets_count_(other.old_buckets_count_),
+        migrated_(other.migrated_),
+        rehash_step_(other.rehash_step_)
     {
         other.buckets_ = nullptr;
+        other.nodes_ = nullptr;
+        other.lists_ = nullptr;
+        other.old_buckets_ = nullptr;
+        other.old_buckets_count_ = 0;
+        other.migrated_ = 0;
         other.buckets_count_ = 0;
         other.elements_count_ = 0;
         other.load_factor_ = 0.0f;
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>& unordered_map<K, V>::operator=(unordered_map&& other) noexcept {
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>& unordered_map<K, V, Alloc, Hash>::operator=(unordered_map&& other) noexcept {
         if (this != &other) {
             clear();
+            destroy_object(nodes_);
+            destroy_object(lists_);
+            alloc_ = other.alloc_;
+            hasher_ = other.hasher_;
             load_factor_ = other.load_factor_;
             load_factor_trigger_ = other.load_factor_trigger_;
             buckets_count_ = other.buckets_count_;
             elements_count_ = other.elements_count_;
             buckets_ = other.buckets_;
+            nodes_ = other.nodes_;
+            lists_ = other.lists_;
+            old_buckets_ = other.old_buckets_;
+            old_buckets_count_ = other.old_buckets_count_;
+            migrated_ = other.migrated_;
+            rehash_step_ = other.rehash_step_;
             other.buckets_ = nullptr;
+            other.nodes_ = nullptr;
+            other.lists_ = nullptr;
+            other.old_buckets_ = nullptr;
+            other.old_buckets_count_ = 0;
+            other.migrated_ = 0;
             other.buckets_count_ = 0;
             other.elements_count_ = 0;
             other.load_factor_ = 0.0f;
@@ -233,45 +497,39 @@ namespace nstd {
         return *this;
     }
 
-    template<class K, class V>
-    inline unordered_map<K, V>::~unordered_map()
+    template<class K, class V, class Alloc, class Hash>
+    inline unordered_map<K, V, Alloc, Hash>::~unordered_map()
     {
         clear();
+        destroy_object(nodes_);
+        destroy_object(lists_);
     }
 
-    template<class K, class V>
-    inline V& unordered_map<K, V>::at(const K& key)
+    template<class K, class V, class Alloc, class Hash>
+    inline V& unordered_map<K, V, Alloc, Hash>::at(const K& key)
     {
         check_buckets_present();
         rehash_if_need();
 
-        size_t index = get_index(key);
-        list<K, V>** curr_list = &((*buckets_)[index]);
-
-        if (!(*curr_list)) {
-            *curr_list = new list<K, V>(key, V());
-            elements_count_++;
-            return (*curr_list)->get_root()->pair_.value_;
-        }
-
-        V* result = (*curr_list)->search(key);
-        if (!result) {
-            (*curr_list)->insert(key, V());
-            elements_count_++;
-            return (*curr_list)->get_root()->pair_.value_;
-        }
+        size_t hash = hasher_(key);
+        if (V* result = find_hashed(key, hash))
+            return *result;
 
-        return *result;
+        list<K, V, Alloc>** curr_list = &(buckets_[index_of(hash)]);
+        if (!(*curr_list))
+            *curr_list = create_list();
+        elements_count_++;
+        return (*curr_list)->push_front(key, V(), hash);
     }
 
-    template<class K, class V>
-    inline V& unordered_map<K, V>::operator[](const K& key)
+    template<class K, class V, class Alloc, class Hash>
+    inline V& unordered_map<K, V, Alloc, Hash>::operator[](const K& key)
     {
         return at(key);
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::insert(const pair<K, V>& p)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::insert(const pair<K, V>& p)
     {
         check_buckets_present();
         rehash_if_need();
@@ -279,161 +537,183 @@ namespace nstd {
         const K key = p.key_;
         const V value = p.value_;
 
-        size_t index = get_index(key);
-        list<K, V>** curr_list = &((*buckets_)[index]);
+        size_t hash = hasher_(key);
+        if (find_hashed(key, hash)) return;
 
-        if (!(*curr_list)) { //     ->
-            //std::cout << "(insert)index: " << index << std::endl << "Creating new list for: " << key << ":" << value << std::endl;
-            *curr_list = new list<K, V>(key, value);
-            elements_count_++;
-            return;
-        }
-        // * *
-
-        if ((*curr_list)->insert(key, value)) {
-            //std::cout << "(insert)index: " << index << std::endl << "Just adding new value: " << key << ":" << value << std::endl;
-            elements_count_++;
-        }
+        list<K, V, Alloc>** curr_list = &(buckets_[index_of(hash)]);
+        if (!(*curr_list)) //     ->
+            *curr_list = create_list();
+        (*curr_list)->push_front(key, value, hash);
+        elements_count_++;
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::emplace(K&& key, V&& value)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::emplace(K&& key, V&& value)
     {
+        check_buckets_present();
         rehash_if_need();
 
-        size_t index = get_index(key);
-        list<K, V>** curr_list = &buckets_[index];
+        size_t hash = hasher_(key);
+        if (find_hashed(key, hash)) return;
 
-        if (!(*curr_list)) {
-            //std::cout << "(emplace)index: " << index << std::endl << "Creating new list for: " << key << ":" << value << std::endl;
-            *curr_list = new list<K, V>(key, value);
-            elements_count_++;
-            return (*curr_list)->search(key);
-        }
-
-        if ((*curr_list)->insert(key, value)) {
-            elements_count_++;
-            //std::cout << "(emplace)index: " << index << std::endl << "Just adding new value: " << key << ":" << value << std::endl;
-        }
+        list<K, V, Alloc>** curr_list = &(buckets_[index_of(hash)]);
+        if (!(*curr_list))
+            *curr_list = create_list();
+        (*curr_list)->push_front(key, value, hash);
+        elements_count_++;
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::erase(const K& key)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::erase(const K& key)
     {
         if (!check_buckets_present()) return;
+        if (old_buckets_)
+            migrate(rehash_step_);
 
-        size_t index = get_index(key);
-        list<K, V>* curr_list = (*buckets_)[index];
+        size_t hash = hasher_(key);
+        list<K, V, Alloc>* old_list = old_list_of(hash);
+        if (old_list && old_list->earse(key, hash)) {
+            elements_count_--;
+            return;
+        }
+
+        list<K, V, Alloc>* curr_list = buckets_[index_of(hash)];
         if (curr_list) {
-            if (curr_list->earse(key)) {
+            if (curr_list->earse(key, hash)) {
                 //std::cout << "(earse)index: " << index << std::endl << "deleting: " << key << std::endl;
                 elements_count_--;
             }
         }
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::clear()
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::clear()
     {
         if (!buckets_) return;
 
-        for (int i = 0; i < buckets_->size(); ++i) {
-            list<K, V>* curr = (*buckets_)[i];
-            if (curr)
-                delete curr;
-        }
-        delete buckets_;
+        destroy_buckets(buckets_, buckets_count_);
+        if (old_buckets_)
+            destroy_buckets(old_buckets_, old_buckets_count_);
+        nodes_->release();
+        lists_->release();
+        old_buckets_ = nullptr;
+        old_buckets_count_ = 0;
+        migrated_ = 0;
         load_factor_ = 0;
         elements_count_ = 0;
         buckets_count_ = 0;
         buckets_ = nullptr;
     }
 
-    template<class K, class V>
-    inline bool unordered_map<K, V>::contains(const K& key)
+    template<class K, class V, class Alloc, class Hash>
+    inline bool unordered_map<K, V, Alloc, Hash>::contains(const K& key)
+    {
+        if (!check_buckets_present()) return false;
+        if (old_buckets_)
+            migrate(rehash_step_);
+
+        return find_hashed(key, hasher_(key)) != nullptr;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline V* unordered_map<K, V, Alloc, Hash>::find(const K& key)
+    {
+        if (!buckets_) return nullptr;
+        return find_hashed(key, hasher_(key));
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    template<class Q, class H, class>
+    inline bool unordered_map<K, V, Alloc, Hash>::contains(const Q& key)
     {
         if (!check_buckets_present()) return false;
+        if (old_buckets_)
+            migrate(rehash_step_);
 
-        size_t index = get_index(key);
-        //std::cout << std::endl << "index: " << index << " key: " << key << std::endl;
-        list<K, V>* curr_list = (*buckets_)[index];
-        if (curr_list)
-            if (curr_list->search(key)) return true;
+        return find_hashed(key, hasher_(key)) != nullptr;
+    }
 
-        return false;
+    template<class K, class V, class Alloc, class Hash>
+    template<class Q, class H, class>
+    inline V* unordered_map<K, V, Alloc, Hash>::find(const Q& key)
+    {
+        if (!buckets_) return nullptr;
+        return find_hashed(key, hasher_(key));
     }
 
-    template<class K, class V>
-    inline bool unordered_map<K, V>::empty() const
+    template<class K, class V, class Alloc, class Hash>
+    inline bool unordered_map<K, V, Alloc, Hash>::empty() const
     {
         return elements_count_ == 0;
     }
 
-    template<class K, class V>
-    inline size_t unordered_map<K, V>::size() const
+    template<class K, class V, class Alloc, class Hash>
+    inline size_t unordered_map<K, V, Alloc, Hash>::size() const
     {
         return elements_count_;
     }
 
-    template<class K, class V>
-    inline size_t unordered_map<K, V>::max_size() const
+    template<class K, class V, class Alloc, class Hash>
+    inline size_t unordered_map<K, V, Alloc, Hash>::max_size() const
     {
         return size_t();
     }
 
-    template<class K, class V>
-    inline size_t unordered_map<K, V>::bucket_count() const
+    template<class K, class V, class Alloc, class Hash>
+    inline size_t unordered_map<K, V, Alloc, Hash>::bucket_count() const
     {
         return buckets_count_;
     }
 
-    template<class K, class V>
-    inline float unordered_map<K, V>::load_factor() const
+    template<class K, class V, class Alloc, class Hash>
+    inline float unordered_map<K, V, Alloc, Hash>::load_factor() const
     {
         return load_factor_;
     }
 
-    template<class K, class V>
-    void unordered_map<K, V>::set_load_factor_trigger(float load_factor_trigger)
+    template<class K, class V, class Alloc, class Hash>
+    void unordered_map<K, V, Alloc, Hash>::set_load_factor_trigger(float load_factor_trigger)
     {
         load_factor_trigger_ = load_factor_trigger;
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::rehash(size_t new_bucket_count)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::rehash(size_t new_bucket_count)
     {
-        array<list<K, V>*>* new_buckets = alloc_buckets(new_bucket_count);
-        for (int i = 0; i < buckets_->size(); ++i) {
-            list<K, V>* curr_list = (*buckets_)[i];
-            if (!curr_list) continue;
-
-            for (const auto& element : *curr_list) {
-                size_t hash = std::hash<K>{}(element.key_);
-                size_t new_index = hash % new_bucket_count;
-
-                if (!(*new_buckets)[new_index]) {
-                    (*new_buckets)[new_index] = new list<K, V>(element.key_, element.value_);
-                    continue;
-                }
-                (*new_buckets)[new_index]->insert(element.key_, element.value_);
-            }
-        }
-
-        delete buckets_;
-        buckets_count_ = new_bucket_count;
-        buckets_ = new_buckets;
+        begin_rehash(new_bucket_count);
+        migrate(old_buckets_count_);
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::reserve(size_t size)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::reserve(size_t size)
     {
         clear();
         init_buckets(size);
     }
 
-    template<class K, class V>
-    inline void unordered_map<K, V>::resize(size_t size)
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::resize(size_t size)
     {
         rehash(size); 
     }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline void unordered_map<K, V, Alloc, Hash>::set_incremental_rehash(size_t buckets_per_operation)
+    {
+        rehash_step_ = buckets_per_operation;
+        if (!rehash_step_ && old_buckets_)
+            migrate(old_buckets_count_);
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline bool unordered_map<K, V, Alloc, Hash>::rehashing() const
+    {
+        return old_buckets_ != nullptr;
+    }
+
+    template<class K, class V, class Alloc, class Hash>
+    inline Alloc unordered_map<K, V, Alloc, Hash>::get_allocator() const
+    {
+        return alloc_;
+    }
 }
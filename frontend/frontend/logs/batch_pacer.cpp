@@ -0,0 +1,56 @@
+#include "logs/batch_pacer.h"
+#include <algorithm>
+
+namespace logs {
+	static constexpr double rtt_weight = 0.2;
+	static constexpr unsigned max_pressure = 64;
+
+	batch_pacer::batch_pacer(const pacer_config& config)
+		: config_(config),
+		batch_bytes_(config.min_batch_bytes_),
+		linger_(config.min_linger_)
+	{
+	}
+
+	void batch_pacer::update_linger()
+	{
+		double linger_us = rtt_us_ * config_.rtt_multiple_ * pressure_;
+		linger_us = std::max(linger_us, static_cast<double>(config_.min_linger_.count()));
+		linger_us = std::min(linger_us, static_cast<double>(config_.max_linger_.count()));
+		linger_ = std::chrono::microseconds(static_cast<long long>(linger_us));
+	}
+
+	void batch_pacer::on_sent(size_t bytes, std::chrono::microseconds rtt, bool acked, unsigned queue_depth, unsigned credit)
+	{
+		double sample = static_cast<double>(rtt.count());
+		rtt_us_ = rtt_us_ ? rtt_us_ + rtt_weight * (sample - rtt_us_) : sample;
+
+		bool backlogged = acked && (queue_depth > config_.high_queue_depth_ || credit == 0);
+		if (backlogged)
+			pressure_ = std::min(pressure_ * 2, max_pressure);
+		else if (pressure_ > 1 && (!acked || queue_depth < config_.high_queue_depth_ / 4))
+			pressure_ /= 2;
+		credit_ = acked ? credit : 0;
+
+		// a batch that hit the limit asks for more room, a small one gives it back
+		if (bytes >= batch_bytes_ && !backlogged)
+			batch_bytes_ = std::min(batch_bytes_ * 2, config_.max_batch_bytes_);
+		else if (bytes < batch_bytes_ / 4)
+			batch_bytes_ = std::max(batch_bytes_ / 2, config_.min_batch_bytes_);
+
+		update_linger();
+	}
+
+	void batch_pacer::on_failed()
+	{
+		pressure_ = std::min(pressure_ * 2, max_pressure);
+		update_linger();
+	}
+
+	size_t batch_pacer::batch_bytes() const
+	{
+		if (credit_)
+			return std::max(std::min(batch_bytes_, static_cast<size_t>(credit_)), config_.min_batch_bytes_);
+		return batch_bytes_;
+	}
+}
@@ -9,8 +9,10 @@ namespace logs {
 	{
 	}
 
-	void logger::add(const char* log_level, const std::string& log)
+	void logger::add(level log_level, std::string_view log)
 	{
-		dir_->add(log_level + log);
+		if (!enabled(log_level)) return;
+
+		dir_->add(log_level, log);
 	}
 }
\ No newline at end of file
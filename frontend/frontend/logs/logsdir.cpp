@@ -1,50 +1,1024 @@
 #include "logs/logsdir.h"
-#include "network/tcp.h"
+#include "network/protocol.h"
 #include "log.h"
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <random>
+
+namespace fs = std::filesystem;
+
 namespace logs {
+	static std::atomic<unsigned long long> next_dir_id{ 1 };
+
+	// the thread's buffers (batched, urgent) in one logsdir
+	struct buffer_cache {
+		unsigned long long dir_id_;
+		thread_buffer* buffers_[2];
+	};
+	// the logsdirs the thread logged into last, most recent first; trivially
+	// destructible, so the hot path reads it without a guard
+	static constexpr size_t cached_dirs = 8;
+	static thread_local buffer_cache cached_buffers[cached_dirs] = {};
+	static thread_local bool thread_exiting = false;
+
+	// shared with every buffer of the thread, outlives the logsdirs that may be gone
+	// by the time the thread exits
+	struct thread_exit {
+		std::shared_ptr<std::atomic<bool>> exited_ = std::make_shared<std::atomic<bool>>(false);
+
+		~thread_exit()
+		{
+			// a line logged by a later thread_local destructor must not reach a buffer
+			// another thread adopted
+			for (buffer_cache& cache : cached_buffers)
+				cache = {};
+			thread_exiting = true;
+			exited_->store(true, std::memory_order_release);
+		}
+	};
+
+	static constexpr size_t replay_block_size = 1024 * 1024;
+	static constexpr size_t default_mapped_chunks = 64;
+	static constexpr std::chrono::microseconds flush_poll_interval{ 1000 };
+
+	static unsigned long long random_client_id()
+	{
+		std::random_device random;
+		unsigned long long id = (static_cast<unsigned long long>(random()) << 32) | random();
+		return id ? id : 1;
+	}
+
+	static void append_wall_time(std::string& out, long long time_stamp)
+	{
+		char text[32];
+		std::time_t now_c = static_cast<std::time_t>(time_stamp / 1000000000LL);
+		std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", std::localtime(&now_c));
+		out += text;
+	}
+
+	static size_t recover_records(const mapped_file& file, std::string& out)
+	{
+		struct recovered {
+			long long time_stamp_ = 0;
+			unsigned long long sequence_ = 0;
+			size_t order_ = 0;
+			level level_ = level::info;
+			std::string_view format_;
+			const char* args_ = nullptr;
+			unsigned size_ = 0;
+		};
+
+		nstd::array<recovered> records;
+		for (size_t i = 0; i < file.slot_count(); i++) {
+			thread_buffer::recover_slot(file.slot(i), [&records](long long time_stamp, level log_level,
+				std::string_view format, const char* args, unsigned size, unsigned long long sequence) {
+				recovered r;
+				r.time_stamp_ = time_stamp;
+				r.sequence_ = sequence;
+				r.order_ = records.size();
+				r.level_ = log_level;
+				r.format_ = format;
+				r.args_ = args;
+				r.size_ = size;
+				records.push_back(r);
+			});
+		}
+
+		std::sort(records.data(), records.data() + records.size(), [](const recovered& a, const recovered& b) {
+			if (a.time_stamp_ != b.time_stamp_) return a.time_stamp_ < b.time_stamp_;
+			if (a.sequence_ != b.sequence_) return a.sequence_ < b.sequence_;
+			return a.order_ < b.order_;
+		});
+
+		// the stamps are ticks of the crashed run, converted with its own anchor
+		long long system_ns, ticks;
+		file.previous_anchor(system_ns, ticks);
+		clock_anchor anchor(system_ns, ticks);
+
+		for (size_t i = 0; i < records.size(); i++) {
+			const recovered& r = records[i];
+			append_wall_time(out, anchor.to_system_ns(r.time_stamp_));
+			out += " ";
+			out += level_tag(r.level_);
+			format_record(out, r.format_, r.args_, r.size_);
+			out += "\n";
+		}
+
+		return records.size();
+	}
+
+	size_t recover_buffer_file(const std::string& path, std::string& out)
+	{
+		mapped_file file;
+		if (!file.open(path, 0, 0) || !file.has_previous_run())
+			return 0;
+
+		return recover_records(file, out);
+	}
+
+	// puts the unsent part of a replay file back in front of the spool
+	static void requeue_replay(const std::string& spool_path, const std::string& replay_path, std::streamoff offset)
+	{
+		std::string merged_path = spool_path + ".tmp";
+		{
+			std::ofstream merged(merged_path, std::ios::binary | std::ios::trunc);
+			std::ifstream replay(replay_path, std::ios::binary);
+			replay.seekg(offset);
+			if (replay.peek() != std::ifstream::traits_type::eof())
+				merged << replay.rdbuf();
+
+			std::ifstream spool(spool_path, std::ios::binary);
+			if (spool.is_open() && spool.peek() != std::ifstream::traits_type::eof())
+				merged << spool.rdbuf();
+		}
+
+		std::error_code ec;
+		fs::rename(merged_path, spool_path, ec);
+		if (ec) {
+			LOGE("failed to requeue spool: " << ec.message());
+			return;
+		}
+		fs::remove(replay_path, ec);
+	}
+
 	logsdir::logsdir()
+		: logsdir(logsdir_config())
 	{
 	}
 
+	logsdir::logsdir(const logsdir_config& config)
+		: config_(config),
+		pacer_(config_.pacer_),
+		pool_(config_.network_),
+		id_(next_dir_id.fetch_add(1, std::memory_order_relaxed)),
+		client_id_(random_client_id())
+	{
+		budget_.limit_ = config_.memory_limit_;
+		size_t window = config_.pipeline_ && config_.retransmit_window_ ? config_.retransmit_window_ : 1;
+		for (lane* records : { &batched_, &urgent_ }) {
+			records->unacked_.resize(window);
+			if (config_.pipeline_)
+				records->stream_.reset(new network::batch_stream(pool_));
+		}
+
+		// a replay interrupted by a crash holds the oldest records
+		std::error_code ec;
+		std::string replay_path = config_.spool_path_ + ".replay";
+		if (fs::exists(replay_path, ec))
+			requeue_replay(config_.spool_path_, replay_path, 0);
+
+		spool_pending_ = fs::exists(config_.spool_path_, ec) && fs::file_size(config_.spool_path_, ec) > 0;
+
+		if (!config_.buffer_path_.empty())
+			open_buffer_file();
+
+		if (config_.compress_ && !config_.dictionary_path_.empty() && !dictionary_.load(config_.dictionary_path_))
+			LOGW("no compression dictionary at " << config_.dictionary_path_ << ", compressing without one");
+
+		if (config_.urgent_lane_)
+			urgent_thread_ = std::thread(&logsdir::urgent_loop, this);
+		if (config_.auto_flush_)
+			flush_thread_ = std::thread(&logsdir::flush_loop, this);
+	}
+
+	void logsdir::open_buffer_file()
+	{
+		size_t chunks = config_.memory_limit_ / thread_buffer::chunk_size;
+		if (!config_.memory_limit_)
+			chunks = default_mapped_chunks;
+		if (!chunks)
+			chunks = 1;
+
+		if (!mapped_.open(config_.buffer_path_, thread_buffer::chunk_size, chunks)) {
+			LOGE("failed to map " << config_.buffer_path_ << ", records stay on the heap");
+			return;
+		}
+
+		// whatever the last run did not send goes to the spool and follows the next send
+		if (mapped_.has_previous_run()) {
+			std::string recovered;
+			size_t count = recover_records(mapped_, recovered);
+			if (count) {
+				LOGI("recovered " << count << " records from " << config_.buffer_path_);
+				write_spool(recovered);
+			}
+		}
+
+		mapped_.reset(anchor_.system_ns(), anchor_.ticks());
+		budget_.mapped_ = &mapped_;
+		budget_.limit_ = chunks * thread_buffer::chunk_size;
+	}
+
 	logsdir::~logsdir()
 	{
+		{
+			std::lock_guard<std::mutex> lock(wake_mutex_);
+			stopping_ = true;
+		}
+		urgent_cv_.notify_one();
+		flush_cv_.notify_one();
+		if (urgent_thread_.joinable())
+			urgent_thread_.join();
+		if (flush_thread_.joinable())
+			flush_thread_.join();
+
+		if (replay_thread_.joinable())
+			replay_thread_.join();
+
+		for (lane* records : { &batched_, &urgent_ }) {
+			thread_buffer* current = records->buffers_.load(std::memory_order_acquire);
+			while (current) {
+				thread_buffer* next = current->next_;
+				delete current;
+				current = next;
+			}
+		}
 	}
 
-	void logsdir::add(const std::string& log)
+	thread_buffer* logsdir::local_buffer(bool urgent)
 	{
-		auto now = std::chrono::system_clock::now();
-		std::time_t now_c = std::chrono::system_clock::to_time_t(now);
+		int lane_index = urgent ? 1 : 0;
+		if (cached_buffers[0].dir_id_ == id_ && cached_buffers[0].buffers_[lane_index])
+			return cached_buffers[0].buffers_[lane_index];
+
+		// a thread that logs into several logsdirs in turn finds each of them here,
+		// the least recent one makes room for a new one
+		size_t found = 0;
+		while (found < cached_dirs && cached_buffers[found].dir_id_ != id_)
+			found++;
+		buffer_cache cache = { id_, { nullptr, nullptr } };
+		if (found < cached_dirs)
+			cache = cached_buffers[found];
+		else
+			found = cached_dirs - 1;
+		for (size_t i = found; i > 0; i--)
+			cached_buffers[i] = cached_buffers[i - 1];
+		cached_buffers[0] = cache;
+		if (cache.buffers_[lane_index])
+			return cache.buffers_[lane_index];
 
-		std::ostringstream oss;
-		oss << std::put_time(std::localtime(&now_c), "%Y-%m-%d %H:%M:%S");
+		std::shared_ptr<std::atomic<bool>> exited;
+		if (!thread_exiting) {
+			thread_local thread_exit token;
+			exited = token.exited_;
+		}
+
+		std::atomic<thread_buffer*>& buffers = urgent ? urgent_.buffers_ : batched_.buffers_;
+		std::thread::id self = std::this_thread::get_id();
+		std::lock_guard<std::mutex> lock(buffers_mutex_);
+
+		// a thread that already logged here owns a buffer, a new one takes over
+		// the buffer of a dead thread with its unsent records and spare chunks
+		thread_buffer* own = nullptr;
+		thread_buffer* orphaned = nullptr;
+		for (thread_buffer* buffer = buffers.load(std::memory_order_acquire); buffer && !own; buffer = buffer->next_) {
+			if (buffer->owner_exited_ && buffer->owner_exited_->load(std::memory_order_acquire)) {
+				if (!orphaned) orphaned = buffer;
+			}
+			else if (buffer->owner_ == self)
+				own = buffer;
+		}
 
-		logs_.insert(log_index, { oss.str(), log });
-		log_index++;
+		thread_buffer* buffer = own;
+		if (!buffer && orphaned && exited) {
+			buffer = orphaned;
+			buffer->owner_ = self;
+			buffer->owner_exited_ = exited;
+		}
+		if (!buffer) {
+			buffer = new thread_buffer(self, budget_);
+			buffer->owner_exited_ = exited;
+			buffer->next_ = buffers.load(std::memory_order_relaxed);
+			buffers.store(buffer, std::memory_order_release);
+		}
+
+		cached_buffers[0].buffers_[lane_index] = buffer;
+		return buffer;
 	}
 
-	bool logsdir::send_logs()
+	void logsdir::append_time_stamp(std::string& out, long long time_stamp)
+	{
+		long long second = time_stamp / 1000000000LL;
+		if (second != cached_second_) {
+			std::time_t now_c = static_cast<std::time_t>(second);
+			std::strftime(cached_time_, sizeof(cached_time_), "%Y-%m-%d %H:%M:%S", std::localtime(&now_c));
+			cached_second_ = second;
+		}
+		out += cached_time_;
+	}
+
+	void logsdir::append_record(std::string& out, const record& r)
 	{
-		std::string result = "";
+		append_time_stamp(out, anchor_.to_system_ns(r.time_stamp_));
+		out += " ";
+		out += level_tag(r.site_->level_);
+		format_record(out, *r.site_, r.args_, r.size_);
+		out += "\n";
+	}
+
+	static bool same_site(const format_site& a, const format_site& b)
+	{
+		return a.line_ == b.line_ && a.level_ == b.level_
+			&& strcmp(a.format_, b.format_) == 0 && strcmp(a.file_, b.file_) == 0;
+	}
+
+	void logsdir::append_frames(lane& records, unacked_batch& batch)
+	{
+		namespace protocol = network::protocol;
+		const nstd::array<record>& pending = records.pending_;
+		nstd::array<const format_site*>& sites = records.batch_sites_;
+		nstd::array<unsigned>& collided_ids = records.collided_ids_;
+
+		// the records carry only the id of their site, append_sites defines it on sending
+		sites.resize(0);
+		for (size_t i = 0; i < pending.size(); i++)
+			sites.push_back(pending[i].site_);
+		std::sort(sites.data(), sites.data() + sites.size(), [](const format_site* a, const format_site* b) {
+			if (a->id_ != b->id_) return a->id_ < b->id_;
+			return a < b;
+		});
+
+		collided_ids.resize(0);
+		batch.sites_.resize(0);
+		const format_site* defined = nullptr;
+		for (size_t i = 0; i < sites.size(); i++) {
+			const format_site* site = sites[i];
+			if (defined && defined->id_ == site->id_) {
+				// copies of one site (an inline function in several units) share the id
+				if (site != defined && !same_site(*site, *defined)
+					&& (!collided_ids.size() || collided_ids[collided_ids.size() - 1] != site->id_))
+					collided_ids.push_back(site->id_);
+				continue;
+			}
+
+			batch.sites_.push_back(site);
+			defined = site;
+		}
 
-		for (const auto& [key_, value_] : logs_) {
-			result = value_.time_stamp_ + " " + value_.log_ + "\n" + result;
+		std::string& out = batch.frames_;
+		size_t frame = protocol::begin_frame(out, protocol::frame_type::records);
+		for (size_t i = 0; i < pending.size(); i++) {
+			const record& r = pending[i];
+			// sorted, and almost always empty
+			bool collided = std::binary_search(collided_ids.data(), collided_ids.data() + collided_ids.size(), r.site_->id_);
+			if (collided) {
+				protocol::put(out, 0u);
+				protocol::put(out, anchor_.to_system_ns(r.time_stamp_));
+				protocol::put(out, static_cast<unsigned char>(r.site_->level_));
+				protocol::put_string(out, r.site_->format_);
+			}
+			else {
+				protocol::put(out, r.site_->id_);
+				protocol::put(out, anchor_.to_system_ns(r.time_stamp_));
+			}
+			protocol::put(out, r.size_);
+			out.append(r.args_, r.size_);
 		}
+		protocol::end_frame(out, frame);
+	}
 
-		LOGI("sending logs: \n" << result);
+	void logsdir::add(level log_level, std::string_view log)
+	{
+		this->log(plain_site(log_level), log);
+	}
 
-		network::tcp_client client("127.0.0.1", 8080);
-		if (!client.connect()) {
-			LOGE("failed connect to server");
+	size_t logsdir::collect_locked(lane& records)
+	{
+		thread_buffer* buffer = records.buffers_.load(std::memory_order_acquire);
+		for (; buffer; buffer = buffer->next_) {
+			buffer->drain([&records](const record& r) {
+				records.pending_.push_back(r);
+				records.pending_[records.pending_.size() - 1].order_ = records.next_order_++;
+			});
+		}
+
+		// the drain order breaks ties, so every thread's records keep their order
+		std::sort(records.pending_.data(), records.pending_.data() + records.pending_.size(), [](const record& a, const record& b) {
+			if (a.time_stamp_ != b.time_stamp_) return a.time_stamp_ < b.time_stamp_;
+			return a.order_ < b.order_;
+		});
+
+		return records.pending_.size();
+	}
+
+	void logsdir::release_locked(lane& records)
+	{
+		records.pending_.resize(0);
+
+		thread_buffer* buffer = records.buffers_.load(std::memory_order_acquire);
+		for (; buffer; buffer = buffer->next_)
+			buffer->release();
+
+		if (config_.overflow_ == overflow_policy::block)
+			space_cv_.notify_all();
+	}
+
+	bool logsdir::send_locked(lane& records, sent_batch* stats, bool until_acked)
+	{
+		if (config_.pipeline_)
+			return pipeline_locked(records, stats, until_acked);
+
+		// one batch at a time: one the backend did not ack goes first, under its old sequence
+		unacked_batch& batch = records.unacked_[0];
+		if (records.unacked_count_) {
+			if (!transmit_locked(records, batch, nullptr))
+				return false;
+			release_acked_locked(records, batch.sequence_);
+			records.unacked_count_ = 0;
+		}
+
+		if (!collect_locked(records))
+			return true;
+
+		seal_batch_locked(records, batch);
+		records.unacked_count_ = 1;
+
+		if (!transmit_locked(records, batch, stats))
 			return false;
+
+		release_acked_locked(records, batch.sequence_);
+		records.unacked_count_ = 0;
+		return true;
+	}
+
+	void logsdir::seal_batch_locked(lane& records, unacked_batch& batch)
+	{
+		batch.sequence_ = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+		batch.records_ = records.pending_.size();
+		batch.frames_.clear();
+		append_frames(records, batch);
+
+		// the batch holds everything the backend needs, heap chunks go back to the producers;
+		// mapped ones keep its records until the ack, a crash before it leaves them for recovery
+		if (!budget_.mapped_) {
+			release_locked(records);
+			return;
+		}
+
+		records.pending_.resize(0);
+		thread_buffer* buffer = records.buffers_.load(std::memory_order_acquire);
+		for (; buffer; buffer = buffer->next_)
+			buffer->mark(batch.sequence_);
+	}
+
+	void logsdir::release_acked_locked(lane& records, unsigned long long sequence)
+	{
+		if (!budget_.mapped_)
+			return;
+
+		thread_buffer* buffer = records.buffers_.load(std::memory_order_acquire);
+		for (; buffer; buffer = buffer->next_)
+			buffer->release(sequence);
+
+		if (config_.overflow_ == overflow_policy::block)
+			space_cv_.notify_all();
+	}
+
+	bool logsdir::transmit_locked(lane& records, const unacked_batch& batch, sent_batch* stats)
+	{
+		namespace protocol = network::protocol;
+
+		while (true) {
+			// every send is a connection of its own, it knows no sites yet
+			records.defined_sites_.clear();
+			std::string& wire = records.wire_;
+			wire.clear();
+			unsigned dictionary_id = append_batch(records, batch, wire);
+
+			LOGD("sending batch " << batch.sequence_ << ", " << batch.records_ << " logs, "
+				<< batch.frames_.size() << " bytes, " << wire.size() << " on the wire");
+
+			auto started = std::chrono::steady_clock::now();
+			if (!send_raw(wire.data(), wire.size(), &records.reply_))
+				return false;
+
+			protocol::ack ack = {};
+			bool acked = protocol::read_ack(records.reply_.data(), records.reply_.size(), ack);
+			if (config_.compress_)
+				peer_dictionary_.store(acked ? ack.dictionary_ : 0, std::memory_order_relaxed);
+
+			if (stats) {
+				stats->bytes_ = batch.frames_.size();
+				stats->rtt_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+				stats->acked_ = acked;
+				stats->ack_ = ack;
+			}
+
+			// a backend without the dictionary could not read the batch, it goes again without one
+			if (dictionary_id && !(acked && ack.dictionary_ == dictionary_id)) {
+				LOGW("backend does not hold compression dictionary " << dictionary_id << ", resending without it");
+				continue;
+			}
+
+			if (!acked || ack.sequence_ != batch.sequence_) {
+				LOGW("batch " << batch.sequence_ << " was not acked, it is kept for a retransmit");
+				return false;
+			}
+			return true;
 		}
+	}
 
-		if (client.send(result.c_str(), result.length() + 1) != (result.length() + 1)) {
-			LOGE("failed to sent data to server");
+	bool logsdir::pipeline_locked(lane& records, sent_batch* stats, bool until_acked)
+	{
+		auto started = std::chrono::steady_clock::now();
+		size_t window = records.unacked_.size();
+
+		// a new connection has none of the batches in flight, they go again under their old sequences
+		if (!records.stream_->connected())
+			records.unacked_sent_ = 0;
+		while (records.unacked_sent_ < records.unacked_count_) {
+			if (!stream_batch_locked(records, records.unacked_[(records.unacked_head_ + records.unacked_sent_) % window]))
+				return false;
+		}
+
+		if (records.stream_->connected() && !take_acks_locked(records, std::chrono::milliseconds(0), stats))
+			return false;
+		// a full window waits for the oldest ack before anything new is collected
+		if (records.unacked_count_ == window && !take_acks_locked(records, config_.network_.timeouts_.recv_, stats))
 			return false;
+
+		if (collect_locked(records)) {
+			unacked_batch& batch = records.unacked_[(records.unacked_head_ + records.unacked_count_) % window];
+			seal_batch_locked(records, batch);
+			records.unacked_count_++;
+			if (!stream_batch_locked(records, batch))
+				return false;
+
+			// the flusher paces itself by the time it was held up, not by the ack
+			if (stats) {
+				stats->bytes_ = batch.frames_.size();
+				stats->rtt_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+			}
 		}
 
-		logs_.clear();
-		log_index = 0;
+		while (until_acked && records.unacked_count_) {
+			if (!take_acks_locked(records, config_.network_.timeouts_.recv_, stats))
+				return false;
+		}
 		return true;
 	}
-}
\ No newline at end of file
+
+	bool logsdir::stream_batch_locked(lane& records, const unacked_batch& batch)
+	{
+		// the batch goes out on a new connection, which knows no sites yet
+		if (!records.stream_->connected())
+			records.defined_sites_.clear();
+
+		std::string& wire = records.wire_;
+		wire.clear();
+		append_batch(records, batch, wire);
+
+		LOGD("streaming batch " << batch.sequence_ << ", " << batch.records_ << " logs, "
+			<< batch.frames_.size() << " bytes, " << wire.size() << " on the wire");
+
+		if (!records.stream_->send(wire.data(), wire.size())) {
+			LOGE("failed to stream batch " << batch.sequence_ << ", it is kept for a retransmit");
+			return false;
+		}
+		records.unacked_sent_++;
+		return true;
+	}
+
+	bool logsdir::take_acks_locked(lane& records, std::chrono::milliseconds timeout, sent_batch* stats)
+	{
+		records.acks_.resize(0);
+		if (!records.stream_->receive(timeout, records.acks_))
+			return false;
+
+		// a backend that does not ack in time gets a new connection, like a one-shot send
+		if (timeout.count() && !records.acks_.size()) {
+			LOGW("no ack within " << timeout.count() << " ms, the batches in flight go again");
+			records.stream_->close();
+			return false;
+		}
+
+		for (size_t i = 0; i < records.acks_.size(); i++) {
+			const network::protocol::ack& ack = records.acks_[i];
+			if (config_.compress_)
+				peer_dictionary_.store(ack.dictionary_, std::memory_order_relaxed);
+			if (stats) {
+				stats->acked_ = true;
+				stats->ack_ = ack;
+			}
+
+			// acks come in the order of the batches, anything else (a batch the backend
+			// could not read, say for a dictionary it lacks) sends all of them again
+			const unacked_batch& oldest = records.unacked_[records.unacked_head_];
+			if (!records.unacked_sent_ || ack.sequence_ != oldest.sequence_) {
+				LOGW("batch " << oldest.sequence_ << " was not acked, the batches in flight go again");
+				records.stream_->close();
+				return false;
+			}
+
+			release_acked_locked(records, ack.sequence_);
+			records.unacked_head_ = (records.unacked_head_ + 1) % records.unacked_.size();
+			records.unacked_count_--;
+			records.unacked_sent_--;
+		}
+		return true;
+	}
+
+	unsigned logsdir::append_batch(lane& records, const unacked_batch& batch, std::string& out)
+	{
+		namespace protocol = network::protocol;
+
+		size_t frame = protocol::begin_batch(out, client_id_, batch.sequence_);
+		unsigned dictionary_id = 0;
+		if (config_.compress_) {
+			std::string& raw = records.raw_;
+			raw.clear();
+			append_sites(records, batch, raw);
+			raw += batch.frames_;
+			dictionary_id = append_compressed(records, raw, out);
+		}
+		else {
+			append_sites(records, batch, out);
+			out += batch.frames_;
+		}
+		protocol::end_frame(out, frame);
+		return dictionary_id;
+	}
+
+	void logsdir::append_sites(lane& records, const unacked_batch& batch, std::string& out)
+	{
+		namespace protocol = network::protocol;
+
+		// a connection learns a site from the first batch on it that uses the site; a failed
+		// send closes the connection, so the next one starts over with every site
+		size_t frame = 0;
+		bool opened = false;
+		for (size_t i = 0; i < batch.sites_.size(); i++) {
+			const format_site* site = batch.sites_[i];
+			const format_site** known = records.defined_sites_.find(site->id_);
+			if (known && (*known == site || same_site(**known, *site)))
+				continue;
+			if (known)
+				*known = site;
+			else
+				records.defined_sites_.insert(site->id_, site);
+
+			if (!opened) {
+				frame = protocol::begin_frame(out, protocol::frame_type::sites);
+				opened = true;
+			}
+			protocol::put(out, site->id_);
+			protocol::put(out, static_cast<unsigned char>(site->level_));
+			protocol::put(out, site->line_);
+			protocol::put_string(out, site->file_);
+			protocol::put_string(out, site->function_);
+			protocol::put_string(out, site->format_);
+		}
+		if (opened)
+			protocol::end_frame(out, frame);
+	}
+
+	unsigned logsdir::append_compressed(lane& records, const std::string& frames, std::string& out)
+	{
+		namespace protocol = network::protocol;
+
+		bool shared = !dictionary_.empty() && peer_dictionary_.load(std::memory_order_relaxed) == dictionary_.id();
+		unsigned dictionary_id = shared ? dictionary_.id() : 0;
+
+		size_t frame = protocol::begin_frame(out, protocol::frame_type::compressed);
+		protocol::put(out, dictionary_id);
+		protocol::put(out, static_cast<unsigned>(frames.size()));
+		records.compressor_.compress(frames.data(), frames.size(), shared ? &dictionary_ : nullptr, out);
+		protocol::end_frame(out, frame);
+		return dictionary_id;
+	}
+
+	size_t logsdir::pushed_bytes(const lane& records) const
+	{
+		size_t pushed = 0;
+		thread_buffer* buffer = records.buffers_.load(std::memory_order_acquire);
+		for (; buffer; buffer = buffer->next_)
+			pushed += buffer->pushed_bytes();
+		return pushed;
+	}
+
+	void logsdir::flush_loop()
+	{
+		size_t flushed_bytes = 0;
+		auto batch_start = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock(wake_mutex_);
+		while (!stopping_) {
+			// short slices, so a batch that fills up early does not wait the whole linger
+			auto slice = std::min<std::chrono::microseconds>(pacer_.linger(), flush_poll_interval);
+			flush_cv_.wait_for(lock, slice, [this] { return stopping_; });
+			if (stopping_)
+				break;
+
+			auto now = std::chrono::steady_clock::now();
+			size_t pushed = pushed_bytes(batched_);
+			bool full = pushed - flushed_bytes >= pacer_.batch_bytes();
+			if (!full && now - batch_start < pacer_.linger())
+				continue;
+
+			batch_start = now;
+			if (pushed == flushed_bytes && !config_.pipeline_)
+				continue; // idle, a pipeline still takes the acks of what is in flight
+
+			lock.unlock();
+			{
+				std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+				sent_batch stats;
+				if (send_locked(batched_, &stats, false)) {
+					flushed_bytes = pushed;
+					if (stats.bytes_) // send_logs may have taken the batch
+						pacer_.on_sent(stats.bytes_, stats.rtt_, stats.acked_, stats.ack_.queue_depth_, stats.ack_.credit_);
+					start_replay();
+				}
+				else {
+					pacer_.on_failed();
+				}
+			}
+			lock.lock();
+		}
+	}
+
+	void logsdir::signal_urgent()
+	{
+		if (urgent_signaled_.exchange(true, std::memory_order_acq_rel))
+			return;
+
+		std::lock_guard<std::mutex> lock(wake_mutex_);
+		urgent_cv_.notify_one();
+	}
+
+	void logsdir::urgent_loop()
+	{
+		std::unique_lock<std::mutex> lock(wake_mutex_);
+		while (true) {
+			urgent_cv_.wait(lock, [this] { return stopping_ || urgent_signaled_.load(std::memory_order_acquire); });
+			if (stopping_)
+				break;
+
+			// a short linger lets a burst of warnings share one connection
+			urgent_cv_.wait_for(lock, config_.urgent_linger_, [this] { return stopping_; });
+			urgent_signaled_.store(false, std::memory_order_release);
+			lock.unlock();
+
+			// on failure the batch stays unacked for the next signal or send_logs
+			{
+				std::lock_guard<std::mutex> urgent_lock(urgent_mutex_);
+				send_locked(urgent_, nullptr, false);
+			}
+
+			lock.lock();
+		}
+	}
+
+	bool logsdir::make_room(level log_level)
+	{
+		if (config_.overflow_ == overflow_policy::drop_by_level && log_level < config_.keep_level_)
+			return false;
+
+		std::unique_lock<std::mutex> lock(flush_mutex_);
+		while (true) {
+			// chunks idling on the free lists of other threads go first
+			for (lane* records : { &batched_, &urgent_ }) {
+				thread_buffer* buffer = records->buffers_.load(std::memory_order_acquire);
+				for (; buffer; buffer = buffer->next_)
+					buffer->trim();
+			}
+
+			if (budget_.has_room(thread_buffer::chunk_size))
+				return true;
+
+			// only batched records make room, urgent ones are never dropped for space
+			collect_locked(batched_);
+
+			switch (config_.overflow_) {
+			case overflow_policy::block:
+				space_cv_.wait(lock);
+				break;
+			case overflow_policy::spill:
+				return drop_oldest_locked(true);
+			default:
+				return drop_oldest_locked(false);
+			}
+		}
+	}
+
+	bool logsdir::drop_oldest_locked(bool spill)
+	{
+		thread_buffer* oldest = nullptr;
+		long long oldest_stamp = 0;
+		const char* begin = nullptr;
+		const char* end = nullptr;
+
+		thread_buffer* buffer = batched_.buffers_.load(std::memory_order_acquire);
+		for (; buffer; buffer = buffer->next_) {
+			long long time_stamp;
+			const char* chunk_begin;
+			const char* chunk_end;
+			if (buffer->oldest_retired(time_stamp, chunk_begin, chunk_end) && (!oldest || time_stamp < oldest_stamp)) {
+				oldest = buffer;
+				oldest_stamp = time_stamp;
+				begin = chunk_begin;
+				end = chunk_end;
+			}
+		}
+
+		if (!oldest) return false;
+
+		// pending_ is sorted, so the spilled records keep their order
+		nstd::array<record>& pending = batched_.pending_;
+		spill_buffer_.clear();
+		size_t kept = 0;
+		size_t removed = 0;
+		for (size_t i = 0; i < pending.size(); i++) {
+			const record& r = pending[i];
+			if (r.args_ >= begin && r.args_ < end) {
+				if (spill) append_record(spill_buffer_, r);
+				removed++;
+				continue;
+			}
+			pending[kept++] = r;
+		}
+		pending.resize(kept);
+
+		if (spill) {
+			write_spool(spill_buffer_);
+			spilled_.fetch_add(removed, std::memory_order_relaxed);
+		}
+		else {
+			dropped_.fetch_add(removed, std::memory_order_relaxed);
+		}
+
+		oldest->drop_oldest_retired();
+		return true;
+	}
+
+	void logsdir::write_spool(const std::string& data)
+	{
+		std::lock_guard<std::mutex> lock(spool_mutex_);
+		if (!spool_.is_open())
+			spool_.open(config_.spool_path_, std::ios::binary | std::ios::app);
+
+		spool_.write(data.data(), data.size());
+		spool_.flush();
+		if (!spool_) {
+			LOGE("failed to write spool: " << config_.spool_path_);
+			spool_.close();
+			spool_.clear();
+			return;
+		}
+
+		spool_pending_ = true;
+	}
+
+	void logsdir::start_replay()
+	{
+		if (!spool_pending_ || replaying_.exchange(true)) return;
+
+		if (replay_thread_.joinable())
+			replay_thread_.join();
+
+		replay_thread_ = std::thread(&logsdir::replay_spool, this);
+	}
+
+	void logsdir::replay_spool()
+	{
+		std::string replay_path = config_.spool_path_ + ".replay";
+		{
+			std::lock_guard<std::mutex> lock(spool_mutex_);
+			if (spool_.is_open())
+				spool_.close();
+
+			std::error_code ec;
+			fs::rename(config_.spool_path_, replay_path, ec);
+			spool_pending_ = false;
+			if (ec) {
+				replaying_ = false;
+				return;
+			}
+		}
+
+		// blocks end on a line so the backend never gets half of a record; each goes in a
+		// batch of its own and counts as sent once acked, like a batch from the lanes
+		std::ifstream replay(replay_path, std::ios::binary);
+		std::string block;
+		std::string framed;
+		std::string reply;
+		std::streamoff sent = 0;
+		bool failed = false;
+
+		while (true) {
+			size_t carried = block.size();
+			block.resize(carried + replay_block_size);
+			replay.read(&block[carried], replay_block_size);
+			block.resize(carried + static_cast<size_t>(replay.gcount()));
+
+			bool last = !replay;
+			if (block.empty()) break;
+
+			size_t line_end = block.rfind('\n');
+			if (line_end == std::string::npos) {
+				if (!last) continue;
+				line_end = block.size() - 1;
+			}
+
+			unsigned long long sequence = next_sequence_.fetch_add(1, std::memory_order_relaxed);
+			framed.clear();
+			size_t batch = network::protocol::begin_batch(framed, client_id_, sequence);
+			size_t frame = network::protocol::begin_frame(framed, network::protocol::frame_type::text);
+			framed.append(block.data(), line_end + 1);
+			network::protocol::end_frame(framed, frame);
+			network::protocol::end_frame(framed, batch);
+
+			network::protocol::ack ack = {};
+			if (!send_raw(framed.data(), framed.size(), &reply)
+				|| !network::protocol::read_ack(reply.data(), reply.size(), ack) || ack.sequence_ != sequence) {
+				failed = true;
+				break;
+			}
+			sent += line_end + 1;
+			block.erase(0, line_end + 1);
+
+			if (last && block.empty()) break;
+		}
+		replay.close();
+
+		std::lock_guard<std::mutex> lock(spool_mutex_);
+		if (failed) {
+			LOGW("spool replay interrupted, " << sent << " bytes sent");
+			requeue_replay(config_.spool_path_, replay_path, sent);
+			spool_pending_ = true;
+		}
+		else {
+			std::error_code ec;
+			fs::remove(replay_path, ec);
+		}
+		replaying_ = false;
+	}
+
+	bool logsdir::send_raw(const char* data, size_t size, std::string* reply)
+	{
+		if (!pool_.send(data, size, reply)) {
+			LOGE("failed to sent data to any server");
+			return false;
+		}
+
+		return true;
+	}
+
+	size_t logsdir::collect()
+	{
+		std::lock_guard<std::mutex> lock(flush_mutex_);
+		std::lock_guard<std::mutex> urgent_lock(urgent_mutex_);
+		return collect_locked(batched_) + collect_locked(urgent_);
+	}
+
+	bool logsdir::send_logs()
+	{
+		std::lock_guard<std::mutex> lock(flush_mutex_);
+		{
+			// leftovers of a failed urgent send go first, the backend orders by time
+			std::lock_guard<std::mutex> urgent_lock(urgent_mutex_);
+			if (!send_locked(urgent_))
+				return false;
+		}
+
+		if (!send_locked(batched_))
+			return false;
+
+		// the backend is reachable again, spilled records follow in the background
+		start_replay();
+		return true;
+	}
+
+	void logsdir::clear()
+	{
+		std::lock_guard<std::mutex> lock(flush_mutex_);
+		std::lock_guard<std::mutex> urgent_lock(urgent_mutex_);
+		for (lane* records : { &batched_, &urgent_ }) {
+			collect_locked(*records);
+			release_locked(*records);
+		}
+	}
+
+	size_t logsdir::unacked()
+	{
+		std::lock_guard<std::mutex> lock(flush_mutex_);
+		std::lock_guard<std::mutex> urgent_lock(urgent_mutex_);
+		return batched_.unacked_count_ + urgent_.unacked_count_;
+	}
+
+	size_t logsdir::memory_used() const
+	{
+		return budget_.used_.load(std::memory_order_relaxed);
+	}
+
+	size_t logsdir::dropped() const
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+	size_t logsdir::spilled() const
+	{
+		return spilled_.load(std::memory_order_relaxed);
+	}
+}
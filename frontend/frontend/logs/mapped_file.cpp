@@ -0,0 +1,183 @@
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <cstring>
+#include "logs/mapped_file.h"
+#include "log.h"
+
+namespace logs {
+	static const char file_magic[8] = { 'L', 'O', 'G', 'S', 'B', 'U', 'F', '1' };
+	static constexpr unsigned file_version = 1;
+
+	size_t mapped_file::layout_size(size_t slot_size, size_t slot_count, size_t& slots_offset)
+	{
+		size_t links_end = sizeof(file_header) + slot_count * sizeof(std::atomic<unsigned>);
+		slots_offset = (links_end + 63) & ~size_t(63);
+		return slots_offset + slot_size * slot_count;
+	}
+
+	mapped_file::~mapped_file()
+	{
+		close();
+	}
+
+	bool mapped_file::open(const std::string& path, size_t slot_size, size_t slot_count)
+	{
+		close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+			nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			LOGE("CreateFile failed with error: " << GetLastError());
+			return false;
+		}
+		file_ = file;
+
+		LARGE_INTEGER existing;
+		if (!GetFileSizeEx(file, &existing))
+			existing.QuadPart = 0;
+
+		if (!slot_count) {
+			// layout of the existing file, for recovery tools
+			file_header header;
+			DWORD was_read = 0;
+			if (existing.QuadPart < static_cast<long long>(sizeof(header))
+				|| !ReadFile(file, &header, sizeof(header), &was_read, nullptr)
+				|| was_read != sizeof(header)
+				|| memcmp(header.magic_, file_magic, sizeof(file_magic)) != 0) {
+				LOGE("not a logs buffer file: " << path);
+				close();
+				return false;
+			}
+			slot_size = static_cast<size_t>(header.slot_size_);
+			slot_count = header.slot_count_;
+		}
+
+		size_t slots_offset;
+		size_ = layout_size(slot_size, slot_count, slots_offset);
+		if (static_cast<unsigned long long>(existing.QuadPart) > size_)
+			size_ = static_cast<size_t>(existing.QuadPart);
+
+		unsigned long long size = size_;
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xffffffff), nullptr);
+		if (!mapping) {
+			LOGE("CreateFileMapping failed with error: " << GetLastError());
+			close();
+			return false;
+		}
+		mapping_ = mapping;
+
+		view_ = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size_));
+		if (!view_) {
+			LOGE("MapViewOfFile failed with error: " << GetLastError());
+			close();
+			return false;
+		}
+
+		header_ = reinterpret_cast<file_header*>(view_);
+		links_ = reinterpret_cast<std::atomic<unsigned>*>(view_ + sizeof(file_header));
+		slots_ = view_ + slots_offset;
+		slot_size_ = slot_size;
+		slot_count_ = slot_count;
+		return true;
+	}
+
+	void mapped_file::close()
+	{
+		if (view_) {
+			FlushViewOfFile(view_, 0);
+			UnmapViewOfFile(view_);
+		}
+		if (mapping_)
+			CloseHandle(static_cast<HANDLE>(mapping_));
+		if (file_)
+			CloseHandle(static_cast<HANDLE>(file_));
+
+		file_ = mapping_ = nullptr;
+		view_ = slots_ = nullptr;
+		header_ = nullptr;
+		links_ = nullptr;
+		size_ = slot_size_ = slot_count_ = 0;
+	}
+
+	bool mapped_file::is_open() const
+	{
+		return view_ != nullptr;
+	}
+
+	bool mapped_file::has_previous_run() const
+	{
+		return header_
+			&& memcmp(header_->magic_, file_magic, sizeof(file_magic)) == 0
+			&& header_->version_ == file_version
+			&& header_->slot_size_ == slot_size_
+			&& header_->slot_count_ == slot_count_;
+	}
+
+	void mapped_file::previous_anchor(long long& system_ns, long long& ticks) const
+	{
+		system_ns = header_->anchor_system_ns_;
+		ticks = header_->anchor_ticks_;
+	}
+
+	size_t mapped_file::slot_count() const
+	{
+		return slot_count_;
+	}
+
+	const char* mapped_file::slot(size_t index) const
+	{
+		return slots_ + index * slot_size_;
+	}
+
+	void mapped_file::reset(long long anchor_system_ns, long long anchor_ticks)
+	{
+		memset(view_, 0, slots_ - view_);
+		for (size_t i = 0; i < slot_count_; i++)
+			memset(slots_ + i * slot_size_, 0, 64); // slot headers only, the payload is not read when free
+
+		memcpy(header_->magic_, file_magic, sizeof(file_magic));
+		header_->version_ = file_version;
+		header_->slot_count_ = static_cast<unsigned>(slot_count_);
+		header_->slot_size_ = slot_size_;
+		header_->anchor_system_ns_ = anchor_system_ns;
+		header_->anchor_ticks_ = anchor_ticks;
+		header_->next_sequence_.store(1, std::memory_order_relaxed);
+
+		for (size_t i = 0; i < slot_count_; i++)
+			links_[i].store(i + 1 < slot_count_ ? static_cast<unsigned>(i + 2) : 0, std::memory_order_relaxed);
+		header_->free_top_.store(slot_count_ ? 1 : 0, std::memory_order_release);
+	}
+
+	void* mapped_file::allocate()
+	{
+		unsigned long long top = header_->free_top_.load(std::memory_order_acquire);
+		while (true) {
+			unsigned index = static_cast<unsigned>(top & 0xffffffff);
+			if (!index) return nullptr;
+
+			// the tag changes on every pop, so a slot freed and reused in between fails the exchange
+			unsigned long long next = ((top >> 32) + 1) << 32 | links_[index - 1].load(std::memory_order_relaxed);
+			if (header_->free_top_.compare_exchange_weak(top, next, std::memory_order_acquire))
+				return slots_ + (index - 1) * slot_size_;
+		}
+	}
+
+	void mapped_file::free(void* slot)
+	{
+		unsigned index = static_cast<unsigned>((static_cast<char*>(slot) - slots_) / slot_size_) + 1;
+
+		unsigned long long top = header_->free_top_.load(std::memory_order_relaxed);
+		while (true) {
+			links_[index - 1].store(static_cast<unsigned>(top & 0xffffffff), std::memory_order_relaxed);
+			unsigned long long next = ((top >> 32) + 1) << 32 | index;
+			if (header_->free_top_.compare_exchange_weak(top, next, std::memory_order_release))
+				return;
+		}
+	}
+
+	unsigned long long mapped_file::next_sequence()
+	{
+		return header_->next_sequence_.fetch_add(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <chrono>
+#include "logs/logger.h"
+
+// producer contention: every thread logs into the same logsdir
+void logs_bench() {
+	constexpr int logs_per_thread = 20000;
+	const std::string message = "benchmark message with some payload";
+
+	std::cout << "==== logs::logsdir contention ====\n";
+	for (int threads_count = 1; threads_count <= 64; threads_count *= 2) {
+		logs::logsdir dir;
+		logs::logger log(dir);
+
+		std::atomic<bool> start{ false };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threads_count; t++) {
+			threads.emplace_back([&] {
+				while (!start.load(std::memory_order_acquire))
+					std::this_thread::yield();
+				for (int i = 0; i < logs_per_thread; i++)
+					log.add(logs::I, message);
+			});
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		start.store(true, std::memory_order_release);
+		for (auto& thread : threads)
+			thread.join();
+		auto end = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(end - begin).count();
+		double total = static_cast<double>(logs_per_thread) * threads_count;
+
+		std::cout << threads_count << " threads: "
+			<< total / seconds / 1e6 << " M logs/s, "
+			<< seconds * 1e9 * threads_count / total << " ns/log per thread, "
+			<< "collected " << dir.collect() << "\n";
+	}
+
+	// caller side cost of one log: formatting on the caller vs deferred
+	constexpr int calls = 200000;
+	logs::logsdir dir;
+	logs::logger log(dir);
+
+	auto begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < calls; i++)
+		log.add(logs::I, "request " + std::to_string(i) + " took " + std::to_string(i * 0.5) + " ms");
+	auto end = std::chrono::steady_clock::now();
+	std::cout << "formatted on caller: "
+		<< std::chrono::duration<double, std::nano>(end - begin).count() / calls << " ns/log\n";
+	dir.collect();
+
+	begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < calls; i++)
+		LOGS_FMT(log, logs::I, "request {} took {} ms", i, i * 0.5);
+	end = std::chrono::steady_clock::now();
+	std::cout << "deferred formatting: "
+		<< std::chrono::duration<double, std::nano>(end - begin).count() / calls << " ns/log\n";
+}
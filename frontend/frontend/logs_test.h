@@ -1,6 +1,30 @@
 #pragma once
+#include <thread>
+#include <cstdlib>
+#include <filesystem>
 #include "logs/logger.h"
 
+// counts heap calls of the whole test binary, used to check the logs arena
+static std::atomic<size_t> allocations_count{ 0 };
+
+void* operator new(size_t size)
+{
+	allocations_count.fetch_add(1, std::memory_order_relaxed);
+	if (void* memory = std::malloc(size ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
 void logs_test() {
 	logs::logsdir dir;
 
@@ -16,4 +40,201 @@ void logs_test() {
 	log.add(logs::E, "this is an error log");
 
 	dir.send_logs();
-}
\ No newline at end of file
+
+	// disabled levels must not evaluate their arguments
+	int evaluated = 0;
+	auto message = [&evaluated] {
+		evaluated++;
+		return std::string("this is an call site log");
+	};
+	LOGS_D(log, message());
+	LOGS_E(log, message());
+	std::cout << "evaluated call sites: " << evaluated
+		<< " (expected " << (logs::enabled(logs::D) ? 2 : 1) << ")\n";
+
+	// deferred formatting, the text is produced in send_logs
+	LOGS_FMT(log, logs::I, "sent {} bytes to {}:{} in {} ms, ok: {}", 1024, "127.0.0.1", 8080, 0.5, true);
+	LOGS_FMT(log, logs::W, "plain format without arguments");
+
+	logs::format_site site{ "{} + {} = {}", logs::I };
+	char args[64];
+	logs::encode_args(args, 2, 2u, 4.0f);
+	std::string text;
+	logs::format_record(text, site, args, logs::encoded_size(2, 2u, 4.0f));
+	std::cout << "formatted: " << text << " (expected 2 + 2 = 4)\n";
+
+	// call site ids depend on the file name, line and format only
+	constexpr logs::format_site built_here{ "x = {}", logs::I, "C:\\build\\frontend\\worker.cpp", "run", 42 };
+	constexpr logs::format_site built_there{ "x = {}", logs::I, "/home/ci/frontend/worker.cpp", "run", 42 };
+	constexpr logs::format_site next_line{ "x = {}", logs::I, "worker.cpp", "run", 43 };
+	static_assert(built_here.id_ == built_there.id_, "site id must not depend on the build path");
+	std::cout << "site ids: " << built_here.id_ << " == " << built_there.id_ << ", next line " << next_line.id_
+		<< " (expected different)\n";
+
+	// many producers into one logsdir; the records above are still queued, no
+	// backend took them, so the count starts from an empty one
+	dir.collect();
+	dir.clear();
+	constexpr int threads_count = 4;
+	constexpr int logs_per_thread = 1000;
+
+	std::thread threads[threads_count];
+	for (int t = 0; t < threads_count; t++) {
+		threads[t] = std::thread([&log, t] {
+			for (int i = 0; i < logs_per_thread; i++)
+				log.add(logs::I, "thread " + std::to_string(t) + " log " + std::to_string(i));
+		});
+	}
+	for (auto& thread : threads)
+		thread.join();
+
+	std::cout << "collected from threads: " << dir.collect()
+		<< " (expected " << threads_count * logs_per_thread << ")\n";
+
+	dir.send_logs();
+
+	// a thread that exits leaves its buffer to the next new one
+	{
+		logs::logsdir churn_dir;
+		logs::logger churn_log(churn_dir);
+		constexpr int short_lived = 50;
+		for (int t = 0; t < short_lived; t++)
+			std::thread([&churn_log, t] { LOGS_FMT(churn_log, logs::I, "short-lived thread {}", t); }).join();
+		std::cout << short_lived << " short-lived threads: " << churn_dir.memory_used() / logs::thread_buffer::chunk_size
+			<< " chunks used (expected 1), collected " << churn_dir.collect() << " (expected " << short_lived << ")\n";
+	}
+
+	// a thread logging into two logsdirs in turn keeps a cached buffer in each
+	{
+		logs::logsdir first_dir, second_dir;
+		logs::logger first_log(first_dir), second_log(second_dir);
+		for (int i = 0; i < 1000; i++) {
+			LOGS_FMT(first_log, logs::I, "first dir {}", i);
+			LOGS_FMT(second_log, logs::I, "second dir {}", i);
+		}
+		std::cout << "two dirs in turn: collected " << first_dir.collect() << " and " << second_dir.collect()
+			<< " (expected 1000 and 1000)\n";
+	}
+
+	// steady state logging reuses the arena chunks, no heap calls after warm up
+	logs::logsdir arena_dir;
+	logs::logger arena_log(arena_dir);
+	for (int round = 0; round < 3; round++) {
+		size_t before = allocations_count.load();
+		for (int i = 0; i < 10000; i++)
+			LOGS_FMT(arena_log, logs::I, "arena log {} of round {}", i, round);
+		arena_dir.collect();
+		arena_dir.clear();
+		std::cout << "round " << round << " heap allocations: " << allocations_count.load() - before
+			<< (round ? " (expected 0)" : "") << "\n";
+	}
+
+	// the flusher lingers longer on a slow link and while the backend is backlogged
+	logs::batch_pacer pacer;
+	for (int i = 0; i < 20; i++)
+		pacer.on_sent(pacer.batch_bytes(), std::chrono::microseconds(100), true, 0, 1 << 20);
+	long long fast_linger = pacer.linger().count();
+	size_t grown_batch = pacer.batch_bytes();
+	for (int i = 0; i < 20; i++)
+		pacer.on_sent(1024, std::chrono::microseconds(20000), true, 0, 1 << 20);
+	long long slow_linger = pacer.linger().count();
+	for (int i = 0; i < 3; i++)
+		pacer.on_sent(1024, std::chrono::microseconds(20000), true, 50000, 0);
+	long long backlogged_linger = pacer.linger().count();
+	std::cout << "pacer linger: fast link " << fast_linger << " us, slow link " << slow_linger
+		<< " us, backlogged " << backlogged_linger << " us (expected growing), full batches grew to "
+		<< grown_batch << " bytes, idle shrank to " << pacer.batch_bytes() << "\n";
+
+	// bounded memory, every policy keeps the storage under the limit
+	constexpr size_t limit = 4 * logs::thread_buffer::chunk_size;
+	const std::string payload(200, 'x');
+
+	logs::logsdir_config config;
+	config.memory_limit_ = limit;
+	config.urgent_lane_ = false; // every record stays queued
+
+	config.overflow_ = logs::overflow_policy::drop_oldest;
+	{
+		logs::logsdir bounded_dir(config);
+		logs::logger bounded_log(bounded_dir);
+		for (int i = 0; i < 20000; i++)
+			LOGS_FMT(bounded_log, logs::I, "drop oldest {} {}", i, payload);
+		std::cout << "drop_oldest: used " << bounded_dir.memory_used() << " of " << limit
+			<< ", dropped " << bounded_dir.dropped() << ", queued " << bounded_dir.collect() << "\n";
+	}
+
+	config.overflow_ = logs::overflow_policy::drop_by_level;
+	{
+		logs::logsdir bounded_dir(config);
+		logs::logger bounded_log(bounded_dir);
+		for (int i = 0; i < 20000; i++)
+			LOGS_FMT(bounded_log, logs::I, "drop by level {} {}", i, payload);
+		size_t queued = bounded_dir.collect();
+		size_t dropped = bounded_dir.dropped();
+		LOGS_FMT(bounded_log, logs::E, "error over the limit {}", payload);
+		size_t made_room = bounded_dir.dropped() - dropped;
+		std::cout << "drop_by_level: used " << bounded_dir.memory_used() << " of " << limit
+			<< ", info dropped " << dropped << ", error kept: "
+			<< (bounded_dir.collect() == queued - made_room + 1 ? "true" : "false") << " (expected true)\n";
+	}
+
+	config.overflow_ = logs::overflow_policy::block;
+	{
+		logs::logsdir bounded_dir(config);
+		logs::logger bounded_log(bounded_dir);
+		std::atomic<bool> done{ false };
+		std::thread producer([&] {
+			for (int i = 0; i < 20000; i++)
+				LOGS_FMT(bounded_log, logs::I, "block {} {}", i, payload);
+			done = true;
+		});
+		while (!done) {
+			bounded_dir.clear(); // stands in for a successful send_logs
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		producer.join();
+		std::cout << "block: used " << bounded_dir.memory_used() << " of " << limit
+			<< ", dropped " << bounded_dir.dropped() << " (expected 0)\n";
+	}
+
+	config.overflow_ = logs::overflow_policy::spill;
+	config.spool_path_ = "logs_test.spool";
+	{
+		logs::logsdir bounded_dir(config);
+		logs::logger bounded_log(bounded_dir);
+		for (int i = 0; i < 20000; i++)
+			LOGS_FMT(bounded_log, logs::I, "spill {} {}", i, payload);
+		size_t queued = bounded_dir.collect();
+		std::cout << "spill: used " << bounded_dir.memory_used() << " of " << limit
+			<< ", spilled " << bounded_dir.spilled() << " + queued " << queued << " (expected 20000), spool "
+			<< std::filesystem::file_size(config.spool_path_) << " bytes\n";
+		bounded_dir.clear();
+	}
+	std::filesystem::remove(config.spool_path_);
+
+	std::cout << "\n*** Crash-surviving buffer\n";
+	logs::logsdir_config mapped_config;
+	mapped_config.memory_limit_ = 8 * logs::thread_buffer::chunk_size;
+	mapped_config.spool_path_ = "logs_test.spool";
+	mapped_config.buffer_path_ = "logs_test.buf";
+	mapped_config.urgent_lane_ = false;
+	{
+		// never sent, the records stay in the file as after a crash
+		logs::logsdir mapped_dir(mapped_config);
+		logs::logger mapped_log(mapped_dir);
+		for (int i = 0; i < 100; i++)
+			LOGS_FMT(mapped_log, logs::W, "unsent {} of {}", i, 100);
+	}
+	{
+		std::string recovered;
+		size_t count = logs::recover_buffer_file(mapped_config.buffer_path_, recovered);
+		std::cout << "recover_buffer_file: " << count << " records (expected 100), last: "
+			<< recovered.substr(recovered.rfind('\n', recovered.size() - 2) + 1);
+
+		logs::logsdir mapped_dir(mapped_config);
+		std::cout << "spooled on restart: " << std::filesystem::file_size(mapped_config.spool_path_)
+			<< " bytes (expected " << recovered.size() << ")\n";
+	}
+	std::filesystem::remove(mapped_config.spool_path_);
+	std::filesystem::remove(mapped_config.buffer_path_);
+}
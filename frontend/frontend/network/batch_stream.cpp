@@ -0,0 +1,90 @@
+#include "network/batch_stream.h"
+#include "log.h"
+
+namespace network {
+	// acks are small, anything longer is not one
+	static constexpr unsigned max_ack_frame = 4096;
+
+	batch_stream::batch_stream(endpoint_pool& pool)
+		: pool_(pool)
+	{
+	}
+
+	bool batch_stream::send(const char* data, size_t size)
+	{
+		if (!client_) {
+			client_ = pool_.connect();
+			if (!client_)
+				return false;
+			inbox_.clear();
+		}
+
+		if (client_->send(data, static_cast<int>(size)) != static_cast<int>(size)) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	bool batch_stream::take_acks(nstd::array<protocol::ack>& acks)
+	{
+		size_t offset = 0;
+		while (inbox_.size() - offset >= sizeof(protocol::frame_header)) {
+			protocol::frame_header header;
+			memcpy(&header, inbox_.data() + offset, sizeof(header));
+			if (!protocol::is_framed(header.magic_, sizeof(header.magic_)) || header.length_ > max_ack_frame)
+				return false;
+
+			size_t frame_size = sizeof(header) + header.length_;
+			if (inbox_.size() - offset < frame_size)
+				break;
+
+			protocol::ack ack;
+			if (!protocol::read_ack(inbox_.data() + offset, frame_size, ack))
+				return false;
+			acks.push_back(ack);
+			offset += frame_size;
+		}
+
+		inbox_.erase(0, offset);
+		return true;
+	}
+
+	bool batch_stream::receive(std::chrono::milliseconds timeout, nstd::array<protocol::ack>& acks)
+	{
+		if (!client_)
+			return false;
+
+		size_t before = acks.size();
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (true) {
+			// once an ack is in, only what already arrived is taken
+			std::chrono::milliseconds wait(0);
+			if (acks.size() == before)
+				wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+			char buffer[1024];
+			int result = client_->recv_some(buffer, sizeof(buffer), wait);
+			if (result < 0) {
+				LOGW("batch stream closed by the backend");
+				close();
+				return false;
+			}
+			if (result == 0)
+				return true;
+
+			inbox_.append(buffer, result);
+			if (!take_acks(acks)) {
+				LOGE("malformed ack on the batch stream");
+				close();
+				return false;
+			}
+		}
+	}
+
+	void batch_stream::close()
+	{
+		client_.reset();
+		inbox_.clear();
+	}
+}
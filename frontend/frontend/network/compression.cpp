@@ -0,0 +1,292 @@
+#include "network/compression.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace network {
+	namespace compression {
+		static unsigned read32(const char* at)
+		{
+			unsigned value;
+			memcpy(&value, at, sizeof(value));
+			return value;
+		}
+
+		static unsigned hash(const char* at)
+		{
+			return (read32(at) * 2654435761u) >> (32 - hash_bits);
+		}
+
+		static void put_length(std::string& out, size_t length)
+		{
+			for (; length >= 255; length -= 255)
+				out += static_cast<char>(255);
+			out += static_cast<char>(length);
+		}
+
+		static void put_varint(std::string& out, size_t value)
+		{
+			for (; value >= 0x80; value >>= 7)
+				out += static_cast<char>((value & 0x7f) | 0x80);
+			out += static_cast<char>(value);
+		}
+
+		// match_length 0 - the last pair, literals only
+		static void put_pair(std::string& out, const char* literals, size_t literal_count, size_t distance, size_t match_length)
+		{
+			size_t match_code = match_length ? match_length - min_match : 0;
+			out += static_cast<char>((std::min<size_t>(literal_count, 15) << 4) | std::min<size_t>(match_code, 15));
+			if (literal_count >= 15)
+				put_length(out, literal_count - 15);
+			out.append(literals, literal_count);
+
+			if (!match_length)
+				return;
+
+			put_varint(out, distance);
+			if (match_code >= 15)
+				put_length(out, match_code - 15);
+		}
+
+		static bool get_length(const char*& in, const char* end, size_t& length)
+		{
+			unsigned char byte;
+			do {
+				if (in >= end) return false;
+				byte = static_cast<unsigned char>(*in++);
+				length += byte;
+			} while (byte == 255);
+			return true;
+		}
+
+		static bool get_varint(const char*& in, const char* end, size_t& value)
+		{
+			value = 0;
+			for (unsigned shift = 0; shift < 64; shift += 7) {
+				if (in >= end) return false;
+				unsigned char byte = static_cast<unsigned char>(*in++);
+				value |= static_cast<size_t>(byte & 0x7f) << shift;
+				if (!(byte & 0x80)) return true;
+			}
+			return false;
+		}
+
+		dictionary::dictionary(std::string content)
+			: content_(std::move(content))
+		{
+			prepare();
+		}
+
+		void dictionary::prepare()
+		{
+			table_.clear();
+			id_ = 0;
+			if (content_.empty())
+				return;
+
+			// the same FNV-1a as the call site ids, 0 stays reserved for no dictionary
+			unsigned hash_value = 2166136261u;
+			for (char c : content_) {
+				hash_value ^= static_cast<unsigned char>(c);
+				hash_value *= 16777619u;
+			}
+			id_ = hash_value ? hash_value : 1;
+
+			table_.assign(size_t(1) << hash_bits, no_position);
+			for (size_t pos = 0; pos + min_match <= content_.size(); pos++)
+				table_[hash(content_.data() + pos)] = static_cast<unsigned>(pos);
+		}
+
+		bool dictionary::load(const std::string& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file.is_open())
+				return false;
+
+			content_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			prepare();
+			return !content_.empty();
+		}
+
+		bool dictionary::save(const std::string& path) const
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(content_.data(), content_.size());
+			return file.good();
+		}
+
+		dictionary train(const std::vector<std::string>& samples, size_t max_size)
+		{
+			constexpr size_t dmer = 8;     // bytes a repeat is counted by
+			constexpr size_t segment = 64; // bytes taken into the dictionary at once
+
+			std::string data;
+			for (const std::string& sample : samples)
+				data += sample;
+			if (data.size() < segment || max_size < segment)
+				return dictionary(data.substr(0, max_size));
+
+			auto key = [&data](size_t pos) {
+				unsigned long long value;
+				memcpy(&value, data.data() + pos, sizeof(value));
+				return value;
+			};
+
+			std::unordered_map<unsigned long long, unsigned> counts;
+			for (size_t pos = 0; pos + dmer <= data.size(); pos++)
+				counts[key(pos)]++;
+
+			// every slice of the samples offers its best segment, so the dictionary
+			// covers all kinds of batches rather than the most frequent one only
+			struct candidate {
+				size_t score_;
+				size_t start_;
+			};
+			std::vector<candidate> picked;
+			size_t wanted = max_size / segment;
+			size_t slice = std::max(data.size() / wanted, segment);
+
+			for (size_t begin = 0; begin + segment <= data.size() && picked.size() < wanted; begin += slice) {
+				size_t last = std::min(begin + slice, data.size()) - segment;
+
+				size_t score = 0;
+				for (size_t pos = begin; pos + dmer <= begin + segment; pos++)
+					score += counts[key(pos)];
+
+				candidate best = { score, begin };
+				for (size_t start = begin + 1; start <= last; start++) {
+					score -= counts[key(start - 1)];
+					score += counts[key(start + segment - dmer)];
+					if (score > best.score_)
+						best = { score, start };
+				}
+
+				// a segment of unique bytes saves nothing
+				if (best.score_ <= segment - dmer + 1)
+					continue;
+
+				picked.push_back(best);
+				for (size_t pos = best.start_; pos + dmer <= best.start_ + segment; pos++)
+					counts[key(pos)] = 0;
+			}
+
+			std::sort(picked.begin(), picked.end(), [](const candidate& a, const candidate& b) {
+				return a.score_ < b.score_;
+			});
+
+			std::string content;
+			for (const candidate& c : picked)
+				content.append(data, c.start_, segment);
+			return dictionary(std::move(content));
+		}
+
+		void compressor::compress(const char* data, size_t size, const dictionary* dict, std::string& out)
+		{
+			if (dict && dict->empty())
+				dict = nullptr;
+
+			window_.clear();
+			if (dict) {
+				window_ = dict->content();
+				table_ = dict->table();
+			}
+			else {
+				table_.assign(size_t(1) << hash_bits, no_position);
+			}
+			window_.append(data, size);
+
+			const char* w = window_.data();
+			size_t end = window_.size();
+			size_t anchor = dict ? dict->content().size() : 0;
+			size_t pos = anchor;
+
+			while (pos + min_match <= end) {
+				unsigned& slot = table_[hash(w + pos)];
+				size_t candidate = slot;
+				slot = static_cast<unsigned>(pos);
+
+				if (candidate == no_position || read32(w + candidate) != read32(w + pos)) {
+					// steps grow through data that does not repeat
+					pos += 1 + ((pos - anchor) >> 5);
+					continue;
+				}
+
+				size_t length = min_match;
+				while (pos + length < end && w[candidate + length] == w[pos + length])
+					length++;
+
+				put_pair(out, w + anchor, pos - anchor, pos - candidate, length);
+				pos += length;
+				anchor = pos;
+				if (pos + min_match <= end)
+					table_[hash(w + pos - 2)] = static_cast<unsigned>(pos - 2);
+			}
+
+			put_pair(out, w + anchor, end - anchor, 0, 0);
+		}
+
+		bool decompress(const char* data, size_t size, size_t raw_size, const dictionary* dict, std::string& out)
+		{
+			const char* dict_data = dict ? dict->content().data() : nullptr;
+			size_t dict_size = dict ? dict->content().size() : 0;
+
+			size_t base = out.size();
+			out.resize(base + raw_size);
+			char* dst = &out[0] + base;
+			size_t produced = 0;
+
+			const char* in = data;
+			const char* end = data + size;
+			while (true) {
+				if (in >= end)
+					break;
+
+				unsigned token = static_cast<unsigned char>(*in++);
+				size_t literals = token >> 4;
+				if (literals == 15 && !get_length(in, end, literals))
+					break;
+				if (literals > static_cast<size_t>(end - in) || literals > raw_size - produced)
+					break;
+
+				memcpy(dst + produced, in, literals);
+				in += literals;
+				produced += literals;
+
+				if (in == end) {
+					if (produced != raw_size)
+						break;
+					return true;
+				}
+
+				size_t distance;
+				size_t length = (token & 15) + min_match;
+				if (!get_varint(in, end, distance) || ((token & 15) == 15 && !get_length(in, end, length)))
+					break;
+				if (distance == 0 || distance > produced + dict_size || length > raw_size - produced)
+					break;
+
+				if (distance > produced) {
+					size_t from_dict = std::min(distance - produced, length);
+					memcpy(dst + produced, dict_data + dict_size - (distance - produced), from_dict);
+					produced += from_dict;
+					length -= from_dict;
+				}
+
+				// an overlapping copy repeats the last distance bytes
+				char* to = dst + produced;
+				const char* from = to - distance;
+				if (distance >= length)
+					memcpy(to, from, length);
+				else
+					for (size_t i = 0; i < length; i++)
+						to[i] = from[i];
+				produced += length;
+			}
+
+			out.resize(base);
+			return false;
+		}
+	}
+}
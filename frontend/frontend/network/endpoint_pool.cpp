@@ -0,0 +1,267 @@
+#include "network/endpoint_pool.h"
+#include "network/tcp.h"
+#include "network/protocol.h"
+#include "log.h"
+#include <random>
+
+namespace network {
+	static long long steady_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// half fixed, half random, so clients that lost the same backend do not retry in step
+	static long long jittered(long long delay)
+	{
+		thread_local std::minstd_rand random(std::random_device{}());
+		std::uniform_int_distribution<long long> half(0, delay / 2);
+		return delay - delay / 2 + half(random);
+	}
+
+	endpoint_pool::endpoint_pool(const endpoint_pool_config& config)
+		: balance_(config.balance_),
+		timeouts_(config.timeouts_),
+		backoff_min_(config.backoff_min_),
+		backoff_max_(config.backoff_max_),
+		health_interval_(config.health_interval_)
+	{
+		count_ = config.endpoints_.size() ? config.endpoints_.size() : 1;
+		states_.reset(new endpoint_state[count_]);
+
+		if (config.endpoints_.size()) {
+			for (size_t i = 0; i < count_; i++)
+				states_[i].endpoint_ = config.endpoints_[i];
+		}
+		else {
+			states_[0].endpoint_ = { "127.0.0.1", 8080 };
+		}
+	}
+
+	endpoint_pool::~endpoint_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(health_mutex_);
+			stopping_ = true;
+		}
+		health_cv_.notify_all();
+		if (health_thread_.joinable())
+			health_thread_.join();
+	}
+
+	size_t endpoint_pool::pick()
+	{
+		size_t turn = next_.fetch_add(1, std::memory_order_relaxed);
+		size_t start = turn % count_;
+
+		if (balance_ == balance_policy::round_robin) {
+			// the turn counts healthy endpoints only, an ejected one does not double its neighbour's share
+			size_t healthy = healthy_count();
+			if (!healthy)
+				return start;
+
+			size_t skip = turn % healthy;
+			for (size_t i = 0; i < count_; i++) {
+				if (states_[i].healthy_.load(std::memory_order_relaxed) && skip-- == 0)
+					return i;
+			}
+			return start;
+		}
+
+		// the turn breaks ties, so idle endpoints still share the load
+		size_t best = start;
+		size_t best_outstanding = static_cast<size_t>(-1);
+		for (size_t k = 0; k < count_; k++) {
+			size_t i = (start + k) % count_;
+			if (!states_[i].healthy_.load(std::memory_order_relaxed))
+				continue;
+
+			size_t outstanding = states_[i].outstanding_.load(std::memory_order_relaxed);
+			if (outstanding < best_outstanding) {
+				best = i;
+				best_outstanding = outstanding;
+			}
+		}
+		return best;
+	}
+
+	// reads one frame, the answer of a backend that has nothing to say is the connection closing
+	static void read_reply(tcp_client& client, std::string& reply)
+	{
+		constexpr unsigned max_reply = 4096;
+
+		network::protocol::frame_header header;
+		reply.clear();
+		if (!client.shutdown_send()
+			|| client.recv(reinterpret_cast<char*>(&header), sizeof(header)) != static_cast<int>(sizeof(header))
+			|| !network::protocol::is_framed(header.magic_, sizeof(header.magic_))
+			|| header.length_ > max_reply)
+			return;
+
+		reply.resize(sizeof(header) + header.length_);
+		memcpy(&reply[0], &header, sizeof(header));
+		if (header.length_ && client.recv(&reply[sizeof(header)], static_cast<int>(header.length_)) != static_cast<int>(header.length_))
+			reply.clear();
+	}
+
+	bool endpoint_pool::send_to(endpoint_state& state, const char* data, size_t size, std::string* reply)
+	{
+		state.outstanding_.fetch_add(size, std::memory_order_relaxed);
+
+		tcp_client client(state.endpoint_.ip_.c_str(), state.endpoint_.port_, timeouts_);
+		bool sent = client.connect() && client.send(data, static_cast<int>(size)) == static_cast<int>(size);
+		if (sent && reply) {
+			// a backend that takes the bytes but never answers is as dead as one that refuses them
+			read_reply(client, *reply);
+			network::protocol::ack ack;
+			sent = network::protocol::read_ack(reply->data(), reply->size(), ack);
+			if (!sent)
+				LOGW("no ack from " << state.endpoint_.ip_ << ":" << state.endpoint_.port_);
+		}
+
+		state.outstanding_.fetch_sub(size, std::memory_order_relaxed);
+		return sent;
+	}
+
+	void endpoint_pool::eject(endpoint_state& state)
+	{
+		unsigned failures = state.failures_.fetch_add(1, std::memory_order_relaxed) + 1;
+		long long min_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(backoff_min_).count();
+		long long max_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(backoff_max_).count();
+		long long delay = min_ns << (failures - 1 < 20 ? failures - 1 : 20);
+		if (delay > max_ns || delay <= 0)
+			delay = max_ns;
+		state.retry_at_.store(steady_ns() + jittered(delay), std::memory_order_relaxed);
+
+		if (!state.healthy_.exchange(false, std::memory_order_relaxed))
+			return;
+
+		LOGW("endpoint " << state.endpoint_.ip_ << ":" << state.endpoint_.port_ << " ejected");
+
+		std::lock_guard<std::mutex> lock(health_mutex_);
+		if (!health_thread_.joinable() && !stopping_)
+			health_thread_ = std::thread(&endpoint_pool::health_loop, this);
+	}
+
+	void endpoint_pool::restore(endpoint_state& state)
+	{
+		state.failures_.store(0, std::memory_order_relaxed);
+		if (!state.healthy_.exchange(true, std::memory_order_relaxed))
+			LOGI("endpoint " << state.endpoint_.ip_ << ":" << state.endpoint_.port_ << " is back");
+	}
+
+	bool endpoint_pool::try_probe(endpoint_state& state)
+	{
+		if (steady_ns() < state.retry_at_.load(std::memory_order_relaxed))
+			return false;
+		return !state.probing_.exchange(true, std::memory_order_acquire);
+	}
+
+	template<class Attempt>
+	bool endpoint_pool::try_endpoints(Attempt attempt)
+	{
+		size_t start = pick();
+
+		for (size_t k = 0; k < count_; k++) {
+			endpoint_state& state = states_[(start + k) % count_];
+			if (!state.healthy_.load(std::memory_order_relaxed))
+				continue;
+
+			if (attempt(state)) {
+				if (state.failures_.load(std::memory_order_relaxed))
+					state.failures_.store(0, std::memory_order_relaxed);
+				return true;
+			}
+			eject(state);
+		}
+
+		// every endpoint is ejected: only those due a probe are tried, the rest fail fast
+		for (size_t k = 0; k < count_; k++) {
+			endpoint_state& state = states_[(start + k) % count_];
+			if (state.healthy_.load(std::memory_order_relaxed) || !try_probe(state))
+				continue;
+
+			bool succeeded = attempt(state);
+			if (succeeded)
+				restore(state);
+			else
+				eject(state);
+			state.probing_.store(false, std::memory_order_release);
+			if (succeeded)
+				return true;
+		}
+
+		return false;
+	}
+
+	bool endpoint_pool::send(const char* data, size_t size, std::string* reply)
+	{
+		return try_endpoints([&](endpoint_state& state) {
+			return send_to(state, data, size, reply);
+		});
+	}
+
+	std::unique_ptr<tcp_client> endpoint_pool::connect()
+	{
+		std::unique_ptr<tcp_client> client;
+		try_endpoints([&](endpoint_state& state) {
+			client.reset(new tcp_client(state.endpoint_.ip_.c_str(), state.endpoint_.port_, timeouts_));
+			if (client->connect())
+				return true;
+			client.reset();
+			return false;
+		});
+		return client;
+	}
+
+	void endpoint_pool::health_loop()
+	{
+		std::unique_lock<std::mutex> lock(health_mutex_);
+		while (!stopping_) {
+			health_cv_.wait_for(lock, health_interval_);
+			if (stopping_)
+				break;
+
+			lock.unlock();
+			for (size_t i = 0; i < count_; i++) {
+				endpoint_state& state = states_[i];
+				if (state.healthy_.load(std::memory_order_relaxed) || !try_probe(state))
+					continue;
+
+				tcp_client probe(state.endpoint_.ip_.c_str(), state.endpoint_.port_, timeouts_);
+				if (probe.connect()) {
+					probe.disconnect();
+					restore(state);
+				}
+				else {
+					eject(state);
+				}
+				state.probing_.store(false, std::memory_order_release);
+			}
+			lock.lock();
+		}
+	}
+
+	size_t endpoint_pool::size() const
+	{
+		return count_;
+	}
+
+	size_t endpoint_pool::healthy_count() const
+	{
+		size_t healthy = 0;
+		for (size_t i = 0; i < count_; i++)
+			healthy += states_[i].healthy_.load(std::memory_order_relaxed) ? 1 : 0;
+		return healthy;
+	}
+
+	const endpoint& endpoint_pool::at(size_t index) const
+	{
+		return states_[index].endpoint_;
+	}
+
+	bool endpoint_pool::is_healthy(size_t index) const
+	{
+		return states_[index].healthy_.load(std::memory_order_relaxed);
+	}
+}
@@ -3,19 +3,63 @@
 #include "log.h"
 
 namespace network {
-	tcp_client::tcp_client(const char* ip, unsigned short port)
+	static bool would_block(int error)
+	{
+		return error == WSAEWOULDBLOCK || error == WSAEINPROGRESS;
+	}
+
+	tcp_client::tcp_client(const char* ip, unsigned short port, const tcp_timeouts& timeouts)
 	{
 		ip_ = ip;
 		port_ = port;
-		sock_fd_ = -1;
+		timeouts_ = timeouts;
+		sock_fd_ = INVALID_SOCKET;
 	}
 
 	tcp_client::~tcp_client()
 	{
-		if (sock_fd_)
+		if (sock_fd_ != INVALID_SOCKET)
 			disconnect();
 	}
 
+	bool tcp_client::wait(bool writable, std::chrono::steady_clock::time_point deadline)
+	{
+		// select, not WSAPoll: before Windows 10 2004 WSAPoll does not report a refused
+		// non-blocking connect, which then takes the whole connect timeout; select
+		// reports it in the except set
+		while (true) {
+			auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now());
+			if (left.count() <= 0)
+				return false;
+
+			fd_set ready, failed;
+			FD_ZERO(&ready);
+			FD_ZERO(&failed);
+			FD_SET(sock_fd_, &ready);
+			FD_SET(sock_fd_, &failed);
+			timeval timeout;
+			timeout.tv_sec = static_cast<long>(left.count() / 1000000);
+			timeout.tv_usec = static_cast<long>(left.count() % 1000000);
+
+			// the first argument is ignored by Winsock
+			int result = select(static_cast<int>(sock_fd_ + 1), writable ? nullptr : &ready, writable ? &ready : nullptr, &failed, &timeout);
+			if (result == SOCKET_ERROR) {
+				LOGE("select function failed with error: " << WSAGetLastError());
+				return false;
+			}
+			if (result > 0)
+				return true; // errors and hang-ups surface in the next call
+		}
+	}
+
+	void tcp_client::close_socket()
+	{
+		if (closesocket(sock_fd_) == SOCKET_ERROR)
+			LOGE("closesocket function failed with error: " << WSAGetLastError());
+		sock_fd_ = INVALID_SOCKET;
+		WSACleanup();
+	}
+
 	bool tcp_client::connect()
 	{
 		WSADATA wsaData;
@@ -32,20 +76,47 @@ namespace network {
 			return false;
 		}
 
+		// non-blocking from here on, every wait is bounded by a deadline
+		u_long non_blocking = 1;
+		if (ioctlsocket(sock_fd_, FIONBIO, &non_blocking) == SOCKET_ERROR) {
+			LOGE("ioctlsocket function failed with error: " << WSAGetLastError());
+			close_socket();
+			return false;
+		}
+
+		// a pipelined batch must not wait in the socket until the one before it is acked
+		int no_delay = 1;
+		if (setsockopt(sock_fd_, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay)) == SOCKET_ERROR)
+			LOGW("setsockopt function failed with error: " << WSAGetLastError());
+
 		sockaddr_in client_service;
 		client_service.sin_family = AF_INET;
 		client_service.sin_addr.s_addr = inet_addr(ip_);
 		client_service.sin_port = htons(port_);
 
+		auto deadline = std::chrono::steady_clock::now() + timeouts_.connect_;
 		result = ::connect(sock_fd_, (SOCKADDR*)&client_service, sizeof(client_service));
 		if (result == SOCKET_ERROR) {
-			LOGE("connect function failed with error: " << WSAGetLastError());
-			result = closesocket(sock_fd_);
-			if (result == SOCKET_ERROR)
-				LOGE("closesocket function failed with error: " << WSAGetLastError());
-			sock_fd_ = 0;
-			WSACleanup();
-			return false;
+			int error = WSAGetLastError();
+			if (!would_block(error)) {
+				LOGE("connect function failed with error: " << error);
+				close_socket();
+				return false;
+			}
+
+			if (!wait(true, deadline)) {
+				LOGE("connect to " << ip_ << ":" << port_ << " timed out");
+				close_socket();
+				return false;
+			}
+
+			int socket_error = 0;
+			socklen_t length = sizeof(socket_error);
+			if (getsockopt(sock_fd_, SOL_SOCKET, SO_ERROR, (char*)&socket_error, &length) == SOCKET_ERROR || socket_error) {
+				LOGE("connect function failed with error: " << socket_error);
+				close_socket();
+				return false;
+			}
 		}
 
 		return true;
@@ -53,11 +124,19 @@ namespace network {
 
 	int tcp_client::send(const char* data, int size)
 	{
-		if (sock_fd_ == -1) return -1;
+		if (sock_fd_ == INVALID_SOCKET) return -1;
 		int was_sent = 0;
 
+		auto deadline = std::chrono::steady_clock::now() + timeouts_.send_;
 		while (was_sent < size) {
 			int result = ::send(sock_fd_, data + was_sent, size - was_sent, 0);
+			if (result == SOCKET_ERROR && would_block(WSAGetLastError())) {
+				if (!wait(true, deadline)) {
+					LOGE("send to " << ip_ << ":" << port_ << " timed out after " << was_sent << " bytes");
+					return -1;
+				}
+				continue;
+			}
 			if (result < 1) return -1;
 
 			was_sent += result;
@@ -68,12 +147,20 @@ namespace network {
 
 	int tcp_client::recv(char* buffer, int size)
 	{
-		if (sock_fd_ == -1) return -1;
+		if (sock_fd_ == INVALID_SOCKET) return -1;
 
 		int was_recv = 0;
 
+		auto deadline = std::chrono::steady_clock::now() + timeouts_.recv_;
 		while (was_recv < size) {
 			int result = ::recv(sock_fd_, buffer + was_recv, size - was_recv, 0);
+			if (result == SOCKET_ERROR && would_block(WSAGetLastError())) {
+				if (!wait(false, deadline)) {
+					LOGE("recv from " << ip_ << ":" << port_ << " timed out after " << was_recv << " bytes");
+					return -1;
+				}
+				continue;
+			}
 
 			if (result < 1) return -1;
 			was_recv += result;
@@ -82,13 +169,36 @@ namespace network {
 		return was_recv;
 	}
 
-	void tcp_client::disconnect()
+	int tcp_client::recv_some(char* buffer, int size, std::chrono::milliseconds timeout)
 	{
-		if (closesocket(sock_fd_) == SOCKET_ERROR)
-			LOGE("closesocket function failed with error: " << WSAGetLastError());
+		if (sock_fd_ == INVALID_SOCKET) return -1;
+
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (true) {
+			int result = ::recv(sock_fd_, buffer, size, 0);
+			if (result == SOCKET_ERROR && would_block(WSAGetLastError())) {
+				if (!wait(false, deadline))
+					return 0;
+				continue;
+			}
+
+			return result < 1 ? -1 : result;
+		}
+	}
 
-		WSACleanup();
+	bool tcp_client::shutdown_send()
+	{
+		if (sock_fd_ == INVALID_SOCKET) return false;
+
+		if (shutdown(sock_fd_, SD_SEND) == SOCKET_ERROR) {
+			LOGE("shutdown function failed with error: " << WSAGetLastError());
+			return false;
+		}
+		return true;
+	}
 
-		sock_fd_ = -1;
+	void tcp_client::disconnect()
+	{
+		close_socket();
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "network/batch_stream.h"
+#include "network_test.h"
+
+// a service log: a few call sites with a mix of numbers and short strings
+static void log_service_batch(logs::logger& log, int records, int seed)
+{
+	static const char* users[] = { "alice", "bob", "carol", "dave", "client-7" };
+	static const char* paths[] = { "/api/orders", "/api/users", "/health", "/api/cart/items" };
+
+	for (int i = 0; i < records; i++) {
+		int n = seed * records + i;
+		switch (n % 4) {
+		case 0: LOGS_FMT(log, logs::I, "request {} {} from {} took {} ms", n, paths[n % 4], users[n % 5], (n % 97) * 0.25); break;
+		case 1: LOGS_FMT(log, logs::D, "cache {} hit ratio {} after {} lookups", "sessions", (n % 100) / 100.0, n); break;
+		case 2: LOGS_FMT(log, logs::I, "user {} opened {} items in cart {}", users[n % 5], n % 13, n * 7); break;
+		default: LOGS_FMT(log, logs::W, "retrying {} after {} attempts, status {}", paths[n % 4], n % 5, 503); break;
+		}
+	}
+}
+
+// raw framed batches exactly as logsdir puts them on the wire
+static std::vector<std::string> capture_batches(unsigned short port, int batches, int records, int seed)
+{
+	test_server backend(port, test_server::mode::capture);
+	logs::logsdir_config config;
+	config.network_.endpoints_.push_back({ "127.0.0.1", port });
+	config.urgent_lane_ = false;
+	logs::logsdir dir(config);
+	logs::logger log(dir);
+
+	for (int batch = 0; batch < batches; batch++) {
+		log_service_batch(log, records, seed + batch);
+		dir.send_logs();
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	return backend.received();
+}
+
+// bytes on the wire and CPU cost per MB of raw batches, raw vs compressed vs compressed with a dictionary
+void network_bench() {
+	std::cout << "==== network::compression ====\n";
+
+	network::compression::dictionary dictionary = network::compression::train(capture_batches(18100, 50, 100, 0), 16 * 1024);
+	std::cout << "dictionary: " << dictionary.content().size() << " bytes trained on 50 batches\n";
+
+	network::compression::compressor compressor;
+	for (int records : { 10, 100, 1000, 10000 }) {
+		std::vector<std::string> batches = capture_batches(18101, 20, records, 1000);
+
+		const network::compression::dictionary* dictionaries[] = { nullptr, &dictionary };
+		for (const network::compression::dictionary* dict : dictionaries) {
+			size_t raw_bytes = 0, wire_bytes = 0;
+			double compress_seconds = 0, decompress_seconds = 0;
+			std::string stream, restored;
+
+			for (const std::string& batch : batches) {
+				constexpr int rounds = 10;
+				auto begin = std::chrono::steady_clock::now();
+				for (int i = 0; i < rounds; i++) {
+					stream.clear();
+					compressor.compress(batch.data(), batch.size(), dict, stream);
+				}
+				auto middle = std::chrono::steady_clock::now();
+				for (int i = 0; i < rounds; i++) {
+					restored.clear();
+					network::compression::decompress(stream.data(), stream.size(), batch.size(), dict, restored);
+				}
+				auto end = std::chrono::steady_clock::now();
+
+				compress_seconds += std::chrono::duration<double>(middle - begin).count() / rounds;
+				decompress_seconds += std::chrono::duration<double>(end - middle).count() / rounds;
+				raw_bytes += batch.size();
+				wire_bytes += stream.size() + sizeof(network::protocol::frame_header) + 2 * sizeof(unsigned);
+			}
+
+			double raw_mb = raw_bytes / (1024.0 * 1024.0);
+			std::cout << records << " records/batch" << (dict ? ", dictionary: " : ":             ")
+				<< raw_bytes / batches.size() << " -> " << wire_bytes / batches.size() << " bytes ("
+				<< 100.0 * wire_bytes / raw_bytes << "%), compress " << compress_seconds * 1e3 / raw_mb
+				<< " ms/MB, decompress " << decompress_seconds * 1e3 / raw_mb << " ms/MB\n";
+		}
+	}
+
+	// whole sends to a local backend: what compression costs the flusher against raw sends
+	size_t raw_bytes = 0;
+	for (bool compress : { false, true }) {
+		test_server backend(18102, test_server::mode::capture);
+		backend.ack_dictionary_ = dictionary.id();
+		dictionary.save("network_bench.dict");
+
+		logs::logsdir_config config;
+		config.network_.endpoints_.push_back({ "127.0.0.1", 18102 });
+		config.urgent_lane_ = false;
+		config.compress_ = compress;
+		config.dictionary_path_ = "network_bench.dict";
+		logs::logsdir dir(config);
+		logs::logger log(dir);
+
+		double seconds = 0;
+		for (int batch = 0; batch < 50; batch++) {
+			log_service_batch(log, 1000, 2000 + batch);
+			auto begin = std::chrono::steady_clock::now();
+			dir.send_logs();
+			seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		if (!compress)
+			raw_bytes = backend.bytes_; // the same records in both runs
+
+		std::cout << (compress ? "compressed sends: " : "raw sends:        ") << backend.bytes_ << " bytes on the wire, send_logs "
+			<< seconds * 1e3 / (raw_bytes / (1024.0 * 1024.0)) << " ms per raw MB\n";
+		std::remove("network_bench.dict");
+	}
+
+	// batches of 100 records against a backend that acks each one a while after it
+	// came, as the real one does once the batch passed its reorder window and was
+	// written: one connection per batch waits that long for every batch, a stream
+	// only once its window of batches is in flight
+	std::cout << "\n==== pipelined batches ====\n";
+	std::vector<std::string> batches = capture_batches(18103, 10, 100, 3000);
+	for (size_t window : { 0, 1, 2, 4, 8, 16, 32 }) {
+		test_server backend(18104);
+		backend.write_delay_ms_ = 5;
+		network::endpoint_pool_config config;
+		config.endpoints_.push_back({ "127.0.0.1", 18104 });
+		network::endpoint_pool pool(config);
+		network::batch_stream stream(pool);
+
+		constexpr size_t count = 400;
+		size_t sent = 0, acked = 0, bytes = 0;
+		std::string reply;
+		nstd::array<network::protocol::ack> acks;
+		auto begin = std::chrono::steady_clock::now();
+		while (acked < count) {
+			if (!window) {
+				const std::string& batch = batches[sent++ % batches.size()];
+				if (pool.send(batch.data(), batch.size(), &reply))
+					acked++;
+				bytes += batch.size();
+				continue;
+			}
+
+			for (; sent < count && sent - acked < window; sent++) {
+				const std::string& batch = batches[sent % batches.size()];
+				stream.send(batch.data(), batch.size());
+				bytes += batch.size();
+			}
+			acks.resize(0);
+			if (!stream.receive(std::chrono::milliseconds(1000), acks) || !acks.size())
+				break;
+			acked += acks.size();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		std::cout << (window ? "window " + std::to_string(window) + ": " : "one per connection: ") << acked / seconds
+			<< " batches/s, " << bytes / (1024.0 * 1024.0) / seconds << " MB/s on " << backend.connections_ << " connections\n";
+	}
+}
@@ -0,0 +1,618 @@
+#pragma once
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "network/tcp.h"
+#include "network/endpoint_pool.h"
+#include "network/compression.h"
+#include "network/protocol.h"
+#include "logs/logger.h"
+
+// Local stand-in for a backend: accepts connections and counts what it receives,
+// or stalls like a hung backend. Every batch is acked like the backend does once
+// it wrote it, write_delay_ms_ after it arrived, naming ack_dictionary_; other
+// framed data is acked when the client closes its side. acks_ off loses the acks.
+class test_server {
+public:
+	enum class mode {
+		read,      // reads every connection to the end
+		stall,     // accepts and never reads
+		no_accept, // never accepts, the accept queue fills up
+		capture,   // reads like read and keeps every batch (or the whole connection without one)
+	};
+
+	test_server(unsigned short port, mode server_mode = mode::read)
+	{
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+
+		listen_fd_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		int reuse = 1;
+		setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+		sockaddr_in server_addr;
+		server_addr.sin_family = AF_INET;
+		server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+		server_addr.sin_port = htons(port);
+		if (bind(listen_fd_, (SOCKADDR*)&server_addr, sizeof(server_addr)) == SOCKET_ERROR
+			|| ::listen(listen_fd_, server_mode == mode::no_accept ? 0 : SOMAXCONN) == SOCKET_ERROR) {
+			std::cout << "test_server: failed to listen on " << port << "\n";
+			return;
+		}
+
+		if (server_mode == mode::no_accept)
+			return;
+
+		thread_ = std::thread([this, server_mode] {
+			while (!stopping_) {
+				WSAPOLLFD fd = { listen_fd_, POLLIN, 0 };
+				if (WSAPoll(&fd, 1, 10) < 1)
+					continue;
+
+				SOCKET client_fd = ::accept(listen_fd_, nullptr, nullptr);
+				if (client_fd == INVALID_SOCKET)
+					continue;
+
+				connections_++;
+				int no_delay = 1;
+				setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&no_delay, sizeof(no_delay));
+				if (server_mode == mode::stall) {
+					stalled_.push_back(client_fd);
+					continue;
+				}
+
+				// a pipelining client keeps its connection, the next one must not wait for it
+				connection_threads_.emplace_back(&test_server::serve, this, client_fd, server_mode == mode::capture);
+			}
+		});
+	}
+
+	~test_server()
+	{
+		stopping_ = true;
+		if (thread_.joinable())
+			thread_.join();
+		for (std::thread& connection : connection_threads_)
+			connection.join();
+		for (SOCKET client_fd : stalled_)
+			closesocket(client_fd);
+		closesocket(listen_fd_);
+		WSACleanup();
+	}
+
+	std::vector<std::string> received()
+	{
+		std::lock_guard<std::mutex> lock(received_mutex_);
+		return received_;
+	}
+
+	std::atomic<size_t> connections_{ 0 };
+	std::atomic<size_t> bytes_{ 0 };
+	std::atomic<unsigned> ack_dictionary_{ 0 };
+	std::atomic<bool> acks_{ true };
+	std::atomic<size_t> acked_{ 0 };
+	std::atomic<int> write_delay_ms_{ 0 };
+
+private:
+	SOCKET listen_fd_;
+	std::atomic<bool> stopping_{ false };
+	std::vector<SOCKET> stalled_;
+	std::vector<std::thread> connection_threads_;
+	std::mutex received_mutex_;
+	std::vector<std::string> received_;
+	std::thread thread_;
+
+	void send_ack(SOCKET client_fd, unsigned long long sequence)
+	{
+		if (!acks_)
+			return;
+
+		network::protocol::ack ack = { 0, 0, 1u << 30, ack_dictionary_.load(), sequence };
+		std::string reply;
+		network::protocol::append_ack(reply, ack);
+		::send(client_fd, reply.data(), static_cast<int>(reply.size()), 0);
+		if (sequence)
+			acked_++;
+	}
+
+	void serve(SOCKET client_fd, bool capture)
+	{
+		namespace protocol = network::protocol;
+		struct due_ack {
+			std::chrono::steady_clock::time_point due_;
+			unsigned long long sequence_;
+		};
+		std::vector<due_ack> due;
+		std::string data;
+		size_t parsed = 0;
+		bool framed = true;
+		bool closed = false;
+
+		while (!stopping_ && (!closed || !due.empty())) {
+			// the acks go out in order as they fall due, reading goes on meanwhile
+			auto now = std::chrono::steady_clock::now();
+			size_t sent = 0;
+			for (; sent < due.size() && due[sent].due_ <= now; sent++)
+				send_ack(client_fd, due[sent].sequence_);
+			due.erase(due.begin(), due.begin() + sent);
+
+			int wait_ms = 10;
+			if (!due.empty())
+				wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(due[0].due_ - now).count()) + 1;
+			if (closed) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+				continue;
+			}
+
+			WSAPOLLFD fd = { client_fd, POLLIN, 0 };
+			if (WSAPoll(&fd, 1, wait_ms) < 1)
+				continue;
+
+			char buffer[4096];
+			int result = ::recv(client_fd, buffer, sizeof(buffer), 0);
+			if (result < 1) {
+				closed = true;
+				continue;
+			}
+			bytes_ += result;
+			data.append(buffer, result);
+
+			framed = framed && (data.size() < sizeof(protocol::magic) || protocol::is_framed(data.data(), data.size()));
+			while (framed && data.size() - parsed >= sizeof(protocol::frame_header)) {
+				protocol::frame_header header;
+				memcpy(&header, data.data() + parsed, sizeof(header));
+				size_t frame_size = sizeof(header) + header.length_;
+				if (data.size() - parsed < frame_size)
+					break;
+
+				protocol::reader payload(data.data() + parsed + sizeof(header), header.length_);
+				unsigned long long client_id, sequence;
+				if (header.type_ == protocol::frame_type::batch && payload.get(client_id) && payload.get(sequence)) {
+					due.push_back({ std::chrono::steady_clock::now() + std::chrono::milliseconds(write_delay_ms_.load()), sequence });
+					if (capture) {
+						std::lock_guard<std::mutex> lock(received_mutex_);
+						received_.push_back(data.substr(parsed, frame_size));
+					}
+					data.erase(parsed, frame_size);
+				}
+				else {
+					parsed += frame_size;
+				}
+			}
+		}
+
+		// what was not in a batch
+		if (!stopping_ && framed && !data.empty())
+			send_ack(client_fd, 0);
+		closesocket(client_fd);
+
+		if (capture && !data.empty()) {
+			std::lock_guard<std::mutex> lock(received_mutex_);
+			received_.push_back(std::move(data));
+		}
+	}
+};
+
+// the batch opens with a sites frame, it defines call sites before its records
+static bool defines_sites(const std::string& batch)
+{
+	size_t inner = sizeof(network::protocol::frame_header) + 2 * sizeof(unsigned long long);
+	if (batch.size() < inner + sizeof(network::protocol::frame_header))
+		return false;
+	const network::protocol::frame_header* header = reinterpret_cast<const network::protocol::frame_header*>(batch.data() + inner);
+	return header->type_ == network::protocol::frame_type::sites;
+}
+
+void network_test() {
+	std::cout << "\n*** Endpoint pool failover\n";
+
+	network::endpoint_pool_config config;
+	config.endpoints_.push_back({ "127.0.0.1", 18081 }); // nobody listens yet
+	config.endpoints_.push_back({ "127.0.0.1", 18082 });
+	config.endpoints_.push_back({ "127.0.0.1", 18083 });
+	config.health_interval_ = std::chrono::milliseconds(20);
+
+	const char batch[] = "batch of logs\n";
+	{
+		test_server second(18082);
+		test_server third(18083);
+		network::endpoint_pool pool(config);
+
+		size_t sent = 0;
+		for (int i = 0; i < 30; i++)
+			sent += pool.send(batch, sizeof(batch) - 1) ? 1 : 0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100)); // the servers finish reading
+		std::cout << "round_robin: sent " << sent << " of 30, healthy " << pool.healthy_count()
+			<< " of 3 (expected 2), split " << second.bytes_ / (sizeof(batch) - 1)
+			<< "/" << third.bytes_ / (sizeof(batch) - 1) << "\n";
+
+		test_server first(18081);
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		std::cout << "health check: healthy " << pool.healthy_count() << " of 3 (expected 3)\n";
+	}
+
+	config.balance_ = network::balance_policy::least_outstanding;
+	{
+		test_server third(18083);
+		network::endpoint_pool pool(config);
+
+		size_t sent = 0;
+		for (int i = 0; i < 10; i++)
+			sent += pool.send(batch, sizeof(batch) - 1) ? 1 : 0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::cout << "least_outstanding: sent " << sent << " of 10 to the only live endpoint, received "
+			<< third.bytes_ / (sizeof(batch) - 1) << "\n";
+	}
+
+	std::cout << "\n*** Deadlines against a stalled server\n";
+	network::tcp_timeouts timeouts;
+	timeouts.connect_ = std::chrono::milliseconds(100);
+	timeouts.send_ = std::chrono::milliseconds(100);
+	timeouts.recv_ = std::chrono::milliseconds(100);
+
+	auto elapsed_ms = [](std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	};
+	{
+		test_server stalled(18084, test_server::mode::stall);
+		network::tcp_client client("127.0.0.1", 18084, timeouts);
+		std::cout << "connect: " << (client.connect() ? "true" : "false") << " (expected true)\n";
+
+		std::string payload(64 * 1024 * 1024, 'x'); // far more than the socket buffers hold
+		auto start = std::chrono::steady_clock::now();
+		int result = client.send(payload.data(), static_cast<int>(payload.size()));
+		std::cout << "send: " << result << " after " << elapsed_ms(start) << " ms (expected -1 after ~100 ms)\n";
+
+		char reply[16];
+		start = std::chrono::steady_clock::now();
+		result = client.recv(reply, sizeof(reply));
+		std::cout << "recv: " << result << " after " << elapsed_ms(start) << " ms (expected -1 after ~100 ms)\n";
+	}
+	{
+		test_server full(18085, test_server::mode::no_accept);
+
+		// the first connections fill the accept queue, the next one is left unanswered
+		std::vector<std::unique_ptr<network::tcp_client>> fillers;
+		long long last_ms = 0;
+		bool connected = true;
+		for (int i = 0; i < 16 && connected; i++) {
+			fillers.emplace_back(new network::tcp_client("127.0.0.1", 18085, timeouts));
+			auto start = std::chrono::steady_clock::now();
+			connected = fillers.back()->connect();
+			last_ms = elapsed_ms(start);
+		}
+		std::cout << "connect to a full queue: " << (connected ? "true" : "false")
+			<< " after " << last_ms << " ms (expected false after ~100 ms)\n";
+
+		network::endpoint_pool_config breaker_config;
+		breaker_config.endpoints_.push_back({ "127.0.0.1", 18085 });
+		breaker_config.timeouts_ = timeouts;
+		breaker_config.backoff_min_ = std::chrono::milliseconds(1000);
+		network::endpoint_pool pool(breaker_config);
+
+		const char batch[] = "batch of logs\n";
+		auto start = std::chrono::steady_clock::now();
+		bool sent = pool.send(batch, sizeof(batch) - 1);
+		std::cout << "breaker closed: sent " << (sent ? "true" : "false") << " after " << elapsed_ms(start) << " ms\n";
+
+		start = std::chrono::steady_clock::now();
+		size_t failed = 0;
+		for (int i = 0; i < 100; i++)
+			failed += pool.send(batch, sizeof(batch) - 1) ? 0 : 1;
+		std::cout << "breaker open: " << failed << " of 100 failed in " << elapsed_ms(start) << " ms (expected ~0 ms)\n";
+	}
+
+	std::cout << "\n*** Urgent lane\n";
+	{
+		test_server backend(18087);
+		logs::logsdir_config urgent_config;
+		urgent_config.network_.endpoints_.push_back({ "127.0.0.1", 18087 });
+		logs::logsdir urgent_dir(urgent_config);
+		logs::logger urgent_log(urgent_dir);
+
+		for (int i = 0; i < 100; i++)
+			LOGS_FMT(urgent_log, logs::I, "batched {}", i);
+		LOGS_FMT(urgent_log, logs::E, "shipped at once");
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::cout << "before send_logs: connections " << backend.connections_
+			<< " (expected 1), queued " << urgent_dir.collect() << " (expected 100)\n";
+
+		urgent_dir.send_logs();
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		std::cout << "after send_logs: connections " << backend.connections_
+			<< " (expected 2), queued " << urgent_dir.collect() << " (expected 0)\n";
+	}
+
+	std::cout << "\n*** Adaptive flusher\n";
+	{
+		test_server backend(18088);
+		logs::logsdir_config paced_config;
+		paced_config.network_.endpoints_.push_back({ "127.0.0.1", 18088 });
+		paced_config.auto_flush_ = true;
+		logs::logsdir paced_dir(paced_config);
+		logs::logger paced_log(paced_dir);
+
+		for (int i = 0; i < 1000; i++)
+			LOGS_FMT(paced_log, logs::I, "paced {}", i);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		std::cout << "without send_logs: queued " << paced_dir.collect() << " (expected 0), connections "
+			<< backend.connections_ << "\n";
+	}
+
+	std::cout << "\n*** Compression\n";
+	{
+		// raw batches of a typical service log to train on and compare with
+		test_server backend(18089, test_server::mode::capture);
+		logs::logsdir_config raw_config;
+		raw_config.network_.endpoints_.push_back({ "127.0.0.1", 18089 });
+		raw_config.urgent_lane_ = false;
+		logs::logsdir raw_dir(raw_config);
+		logs::logger raw_log(raw_dir);
+
+		for (int batch = 0; batch < 20; batch++) {
+			for (int i = 0; i < 50; i++)
+				LOGS_FMT(raw_log, logs::I, "request {} from {} took {} ms", batch * 50 + i, "client-7", i * 0.25);
+			raw_dir.send_logs();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+		std::vector<std::string> batches = backend.received();
+		std::vector<std::string> samples(batches.begin(), batches.begin() + batches.size() / 2);
+		network::compression::dictionary dictionary = network::compression::train(samples, 4096);
+
+		network::compression::compressor compressor;
+		size_t raw_bytes = 0, plain_bytes = 0, dictionary_bytes = 0, intact = 0;
+		for (size_t i = samples.size(); i < batches.size(); i++) {
+			std::string plain, with_dictionary, restored, restored_with_dictionary;
+			compressor.compress(batches[i].data(), batches[i].size(), nullptr, plain);
+			compressor.compress(batches[i].data(), batches[i].size(), &dictionary, with_dictionary);
+			raw_bytes += batches[i].size();
+			plain_bytes += plain.size();
+			dictionary_bytes += with_dictionary.size();
+
+			bool same = network::compression::decompress(plain.data(), plain.size(), batches[i].size(), nullptr, restored)
+				&& network::compression::decompress(with_dictionary.data(), with_dictionary.size(), batches[i].size(), &dictionary, restored_with_dictionary)
+				&& restored == batches[i] && restored_with_dictionary == batches[i];
+			intact += same ? 1 : 0;
+		}
+		std::cout << "batches: " << raw_bytes << " bytes raw, " << plain_bytes << " compressed, "
+			<< dictionary_bytes << " with a " << dictionary.content().size() << " byte dictionary (expected smaller), intact "
+			<< intact << " of " << batches.size() - samples.size() << "\n";
+
+		std::string stream, restored;
+		compressor.compress(batches.back().data(), batches.back().size(), nullptr, stream);
+		stream.resize(stream.size() / 2);
+		std::cout << "truncated stream rejected: "
+			<< (network::compression::decompress(stream.data(), stream.size(), batches.back().size(), nullptr, restored) ? "false" : "true")
+			<< " (expected true)\n";
+
+		// the client starts without the dictionary and takes it up once the ack names it
+		dictionary.save("network_test.dict");
+		test_server compressing_backend(18090, test_server::mode::capture);
+		compressing_backend.ack_dictionary_ = dictionary.id();
+
+		logs::logsdir_config compressed_config = raw_config;
+		compressed_config.network_.endpoints_[0].port_ = 18090;
+		compressed_config.compress_ = true;
+		compressed_config.dictionary_path_ = "network_test.dict";
+		logs::logsdir compressed_dir(compressed_config);
+		logs::logger compressed_log(compressed_dir);
+
+		auto dictionary_of = [](const std::string& data) {
+			// the batch frame comes first, then the compressed one
+			size_t offset = 2 * sizeof(network::protocol::frame_header) + 2 * sizeof(unsigned long long);
+			unsigned id = ~0u;
+			if (data.size() >= offset + sizeof(id))
+				memcpy(&id, data.data() + offset, sizeof(id));
+			return id;
+		};
+
+		for (int batch = 0; batch < 2; batch++) {
+			for (int i = 0; i < 50; i++)
+				LOGS_FMT(compressed_log, logs::I, "request {} from {} took {} ms", batch * 50 + i, "client-7", i * 0.25);
+			compressed_dir.send_logs();
+		}
+
+		// a backend that lost the dictionary gets the batch again without it
+		compressing_backend.ack_dictionary_ = 0;
+		LOGS_FMT(compressed_log, logs::I, "request {} from {} took {} ms", 100, "client-7", 0.25);
+		compressed_dir.send_logs();
+
+		std::vector<std::string> sent = compressing_backend.received();
+		std::cout << "dictionary ids on the wire:";
+		for (const std::string& data : sent)
+			std::cout << " " << (dictionary_of(data) == dictionary.id() ? "shared" : dictionary_of(data) == 0 ? "none" : "?");
+		std::cout << " (expected none shared shared none)\n";
+		std::remove("network_test.dict");
+	}
+
+	std::cout << "\n*** At-least-once delivery\n";
+	{
+		test_server backend(18091, test_server::mode::capture);
+		backend.acks_ = false; // written, but the ack is lost
+		logs::logsdir_config config;
+		config.network_.endpoints_.push_back({ "127.0.0.1", 18091 });
+		config.urgent_lane_ = false;
+		logs::logsdir dir(config);
+		logs::logger log(dir);
+
+		for (int i = 0; i < 10; i++)
+			LOGS_FMT(log, logs::I, "delivered {}", i);
+		bool sent = dir.send_logs();
+		std::cout << "without an ack: sent " << (sent ? "true" : "false") << " (expected false), unacked "
+			<< dir.unacked() << " (expected 1), queued " << dir.collect() << " (expected 0)\n";
+
+		// the endpoint that did not ack is ejected, it gets the batch again once its backoff ran out
+		backend.acks_ = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		LOGS_FMT(log, logs::I, "delivered {}", 10);
+		sent = dir.send_logs();
+
+		auto sequence_of = [](const std::string& data) {
+			unsigned long long sequence = 0;
+			size_t offset = sizeof(network::protocol::frame_header) + sizeof(unsigned long long);
+			if (data.size() >= offset + sizeof(sequence))
+				memcpy(&sequence, data.data() + offset, sizeof(sequence));
+			return sequence;
+		};
+
+		std::vector<std::string> received = backend.received();
+		std::cout << "after the retransmit: sent " << (sent ? "true" : "false") << ", unacked " << dir.unacked()
+			<< " (expected 0), sequences on the wire:";
+		for (const std::string& data : received)
+			std::cout << " " << sequence_of(data);
+		std::cout << " (expected n n n+1)\n";
+	}
+	{
+		// with a buffer file a batch keeps its records in it until the ack,
+		// a crash before the ack leaves them for recovery
+		test_server backend(18092, test_server::mode::capture);
+		backend.acks_ = false;
+		logs::logsdir_config config;
+		config.network_.endpoints_.push_back({ "127.0.0.1", 18092 });
+		config.urgent_lane_ = false;
+		config.buffer_path_ = "network_test.buf";
+		config.spool_path_ = "network_test.spool";
+		{
+			logs::logsdir dir(config);
+			logs::logger log(dir);
+			for (int i = 0; i < 10; i++)
+				LOGS_FMT(log, logs::I, "unacked {}", i);
+			dir.send_logs();
+		}
+		std::string recovered;
+		size_t unacked_records = logs::recover_buffer_file(config.buffer_path_, recovered);
+		std::remove(config.buffer_path_.c_str());
+
+		backend.acks_ = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		{
+			logs::logsdir dir(config);
+			logs::logger log(dir);
+			for (int i = 0; i < 10; i++)
+				LOGS_FMT(log, logs::I, "acked {}", i);
+			dir.send_logs();
+		}
+		recovered.clear();
+		size_t acked_records = logs::recover_buffer_file(config.buffer_path_, recovered);
+		std::cout << "left in the buffer file: unacked batch " << unacked_records << " records (expected 10), acked batch "
+			<< acked_records << " (expected 0)\n";
+		std::remove(config.buffer_path_.c_str());
+		std::remove(config.spool_path_.c_str());
+	}
+	{
+		// the spool is replayed in sequenced batches and kept until they are acked
+		test_server backend(18095, test_server::mode::capture);
+		backend.acks_ = false;
+		logs::logsdir_config config;
+		config.network_.endpoints_.push_back({ "127.0.0.1", 18095 });
+		config.network_.timeouts_.recv_ = std::chrono::milliseconds(100);
+		config.urgent_lane_ = false;
+		config.spool_path_ = "network_test.spool";
+		{
+			std::ofstream spool(config.spool_path_, std::ios::binary | std::ios::trunc);
+			spool << "spooled line 1\nspooled line 2\n";
+		}
+		{
+			logs::logsdir dir(config);
+			dir.send_logs();
+		}
+		std::ifstream kept(config.spool_path_, std::ios::binary);
+		std::string kept_lines((std::istreambuf_iterator<char>(kept)), std::istreambuf_iterator<char>());
+		kept.close();
+
+		backend.acks_ = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(150));
+		{
+			logs::logsdir dir(config);
+			dir.send_logs();
+		}
+		std::ifstream gone(config.spool_path_, std::ios::binary);
+		std::vector<std::string> received = backend.received();
+		bool batched = !received.empty() && received.back().find("spooled line 2") != std::string::npos
+			&& received.back()[offsetof(network::protocol::frame_header, type_)] == static_cast<char>(network::protocol::frame_type::batch);
+		std::cout << "spool without an ack: " << kept_lines.size() << " bytes kept (expected 30), after the ack: kept "
+			<< (gone.is_open() ? "true" : "false") << " (expected false), replayed in a batch " << (batched ? "true" : "false")
+			<< " (expected true), acked " << backend.acked_ << " (expected 1)\n";
+		gone.close();
+		std::remove(config.spool_path_.c_str());
+	}
+
+	std::cout << "\n*** Pipelined batches\n";
+	{
+		// acks take a while, the flusher goes on sending into the window meanwhile
+		test_server backend(18093, test_server::mode::capture);
+		backend.write_delay_ms_ = 100;
+		logs::logsdir_config config;
+		config.network_.endpoints_.push_back({ "127.0.0.1", 18093 });
+		config.urgent_lane_ = false;
+		config.auto_flush_ = true;
+		config.pipeline_ = true;
+		config.retransmit_window_ = 4;
+		logs::logsdir dir(config);
+		logs::logger log(dir);
+
+		size_t most_in_flight = 0;
+		for (int burst = 0; burst < 8; burst++) {
+			for (int i = 0; i < 10; i++)
+				LOGS_FMT(log, logs::I, "pipelined {}", burst * 10 + i);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			most_in_flight = std::max(most_in_flight, dir.unacked());
+		}
+		bool sent = dir.send_logs();
+		std::vector<std::string> received = backend.received();
+		size_t defining = 0;
+		for (const std::string& data : received)
+			defining += defines_sites(data) ? 1 : 0;
+		std::cout << "in flight at most " << most_in_flight << " (expected above 1, window 4), send_logs " << (sent ? "true" : "false")
+			<< ", unacked " << dir.unacked() << " (expected 0), connections " << backend.connections_
+			<< " (expected 1), acked " << backend.acked_ << " of " << received.size() << " batches\n";
+		std::cout << "batches defining the call site: " << defining << " of " << received.size() << " (expected 1, once per connection)\n";
+	}
+	{
+		// a connection that stops acking is replaced, what was in flight goes again on the new one
+		test_server backend(18094, test_server::mode::capture);
+		backend.acks_ = false;
+		logs::logsdir_config config;
+		config.network_.endpoints_.push_back({ "127.0.0.1", 18094 });
+		config.network_.timeouts_.recv_ = std::chrono::milliseconds(100);
+		config.urgent_lane_ = false;
+		config.pipeline_ = true;
+		logs::logsdir dir(config);
+		logs::logger log(dir);
+		auto log_one = [&log](int i) { LOGS_FMT(log, logs::I, "pipelined {}", i); }; // one call site
+
+		for (int i = 0; i < 10; i++)
+			log_one(i);
+		bool sent = dir.send_logs();
+		std::cout << "without acks: sent " << (sent ? "true" : "false") << " (expected false), unacked "
+			<< dir.unacked() << " (expected 1)\n";
+
+		backend.acks_ = true;
+		log_one(10);
+		sent = dir.send_logs();
+
+		std::vector<std::string> received = backend.received();
+		std::cout << "after reconnecting: sent " << (sent ? "true" : "false") << ", unacked " << dir.unacked()
+			<< " (expected 0), connections " << backend.connections_ << " (expected 2), sequences on the wire:";
+		for (const std::string& data : received) {
+			unsigned long long sequence = 0;
+			memcpy(&sequence, data.data() + sizeof(network::protocol::frame_header) + sizeof(unsigned long long), sizeof(sequence));
+			std::cout << " " << sequence;
+		}
+		std::cout << " (expected n n n+1), defining the call site:";
+		for (const std::string& data : received)
+			std::cout << " " << (defines_sites(data) ? "yes" : "no");
+		std::cout << " (expected yes yes no)\n";
+	}
+}
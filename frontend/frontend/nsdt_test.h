@@ -1,7 +1,28 @@
 #pragma once
 #include "nstd/array.h"
+#include "nstd/small_array.h"
 #include "nstd/list.h"
 #include "nstd/unordered_map.h"
+#include "nstd/swiss_map.h"
+#include "nstd/node_pool.h"
+#include "nstd/arena.h"
+#include "nstd/concurrent_unordered_map.h"
+#include "nstd/spsc_ring.h"
+#include "nstd/mpmc_ring.h"
+#include "nstd/flat_map.h"
+#include "nstd/flat_set.h"
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string_view>
+
+//  ,  ,  rehash    
+struct counting_hash {
+    static inline size_t calls_ = 0;
+    size_t operator()(int key) const { calls_++; return std::hash<int>{}(key); }
+};
 
 void nstd_test() {
     std::cout << "====   nstd::array ====\n";
@@ -29,6 +50,57 @@ void nstd_test() {
     }
     std::cout << "\n\n";
 
+    //   :  ,       
+    nstd::array<std::string> strings;
+    strings.reserve(2);
+    std::cout << " reserve(2):  " << strings.capacity() << " ( 2)\n";
+    for (int i = 0; i < 128; i++)
+        strings.emplace_back(40, static_cast<char>('a' + i % 26));
+    strings.push_back(strings[0]); //   ,      128
+    size_t intact = 0;
+    for (size_t i = 0; i < 128; i++)
+        intact += strings[i] == std::string(40, static_cast<char>('a' + i % 26));
+    std::cout << " " << strings.size() << " ( 129),  " << intact << " ( 128),  "
+        << (strings[128] == strings[0] ? " " : "") << "\n";
+    strings.resize(10);
+    strings.shrink_to_fit();
+    std::cout << " resize(10)  shrink_to_fit:  " << strings.size() << ",  " << strings.capacity() << " ( 10)\n";
+
+    nstd::array<std::unique_ptr<int>> owners;
+    for (int i = 0; i < 20; i++)
+        owners.emplace_back(new int(i));
+    owners.pop_back();
+    int owned_sum = 0;
+    for (auto& owner : owners)
+        owned_sum += *owner;
+    std::cout << "unique_ptr  : " << owners.size() << " ,  " << owned_sum << " ( 171)\n\n";
+
+    std::cout << "====   nstd::small_array ====\n";
+    nstd::small_array<std::string, 4> fields;
+    fields.push_back("time");
+    fields.push_back("level");
+    fields.emplace_back("message");
+    std::cout << "3 :   " << (fields.on_heap() ? "true" : "false") << " ( false),  " << fields.capacity() << "\n";
+
+    nstd::small_array<std::string, 4> fields_moved(std::move(fields));
+    std::cout << ": " << fields_moved.size() << " ,  " << fields_moved[0] << ",  : "
+        << (fields.empty() ? "true" : "false") << "\n";
+
+    for (int i = 0; i < 10; i++)
+        fields_moved.push_back(fields_moved[0]);
+    nstd::small_array<std::string, 4> fields_copy(fields_moved);
+    nstd::small_array<std::string, 4> fields_heap_moved(std::move(fields_moved));
+    std::cout << "13 :   " << (fields_heap_moved.on_heap() ? "true" : "false") << " ( true),  "
+        << fields_copy.size() << ",  " << fields_heap_moved[12] << "\n";
+
+    fields_heap_moved.resize(2);
+    fields_heap_moved.shrink_to_fit();
+    std::cout << " resize(2)  shrink_to_fit:   " << (fields_heap_moved.on_heap() ? "true" : "false")
+        << " ( false), : ";
+    for (auto& field : fields_heap_moved)
+        std::cout << field << " ";
+    std::cout << "\n\n";
+
     std::cout << "====   nstd::list ====\n";
     nstd::list<int, int> my_list(1, 100);
     my_list.insert(2, 200);
@@ -83,4 +155,397 @@ void nstd_test() {
 
     my_map.clear();
     std::cout << "   : " << my_map.size() << "\n";
+
+    std::cout << "\n====   nstd::swiss_map ====\n";
+
+    nstd::swiss_map<int, std::string> swiss;
+    swiss.insert({ 1, "one" });
+    swiss.insert({ 2, "two" });
+    swiss.insert({ 3, "three" });
+    swiss[4] = "four";
+    swiss[2] = "TWO";
+    swiss.insert({ 3, "THREE" });
+
+    std::cout << " :\n";
+    for (auto it = swiss.begin(); it != swiss.end(); ++it) {
+        std::cout << ": " << it->key_ << ", : " << it->value_ << "\n";
+    }
+
+    std::cout << "   3: " << (swiss.contains(3) ? "true" : "false") << "\n";
+    std::cout << "   5: " << (swiss.contains(5) ? "true" : "false") << "\n";
+
+    swiss.erase(1);
+    std::cout << "   1, : " << swiss.size() << " ( 3)\n";
+
+    //      std::unordered_map: ,   
+    // ,    ,     
+    nstd::swiss_map<int, int> grown;
+    std::unordered_map<int, int> expected;
+    unsigned seed = 1;
+    for (int i = 0; i < 200000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int key = static_cast<int>((seed >> 8) % 5000);
+        if (seed & 0x10000) {
+            grown.erase(key);
+            expected.erase(key);
+        }
+        else {
+            grown[key] = i;
+            expected[key] = i;
+        }
+    }
+    size_t matched = 0, visited = 0;
+    for (auto it = grown.begin(); it != grown.end(); ++it) {
+        auto found = expected.find(it->key_);
+        if (found != expected.end() && found->second == it->value_)
+            matched++;
+        visited++;
+    }
+    std::cout << " 200000 :  " << grown.size() << " ( " << expected.size()
+        << "),  " << matched << ",  " << visited << ",  " << grown.bucket_count() << "\n";
+
+    nstd::swiss_map<int, int> copied(grown);
+    nstd::swiss_map<int, int> moved(std::move(copied));
+    moved.reserve(100000);
+    size_t kept = 0;
+    for (const auto& item : expected) {
+        if (moved.contains(item.first) && moved[item.first] == item.second)
+            kept++;
+    }
+    std::cout << "  reserve: " << kept << "  " << expected.size() << " ( ),  " << moved.bucket_count() << "\n";
+
+    swiss.clear();
+    std::cout << "   : " << swiss.size() << "\n";
+
+    std::cout << "\n====   nstd::node_pool ====\n";
+
+    //    :            
+    nstd::node_pool<nstd::Node<int, std::string>> pool;
+    nstd::list<int, std::string> pooled(&pool);
+    for (int i = 0; i < 1000; i++)
+        pooled.insert(i, std::to_string(i));
+    size_t slabs = pool.slabs();
+    pooled.clear();
+    std::cout << "  :    " << pool.size() << " ( 0),  " << slabs << "\n";
+    for (int i = 0; i < 1000; i++)
+        pooled.insert(i, std::to_string(i));
+    std::cout << "  1000 :  " << pool.slabs() << " ( " << slabs << ")\n";
+    pooled.clear();
+    pool.release();
+    std::cout << " release:  " << pool.slabs() << " ( 0)\n";
+
+    //  rehash :    ,   
+    nstd::unordered_map<int, std::string> relinked;
+    std::unordered_map<int, std::string> relinked_expected;
+    for (int i = 0; i < 50000; i++) {
+        relinked[i * 7] = std::to_string(i);
+        relinked_expected[i * 7] = std::to_string(i);
+        if (i % 3 == 0) {
+            relinked.erase(i * 7 / 2);
+            relinked_expected.erase(i * 7 / 2);
+        }
+    }
+    size_t same = 0;
+    for (auto it = relinked.begin(); it != relinked.end(); ++it) {
+        auto found = relinked_expected.find(it->key_);
+        if (found != relinked_expected.end() && found->second == it->value_)
+            same++;
+    }
+    nstd::unordered_map<int, std::string> relinked_copy(relinked);
+    relinked.clear();
+    std::cout << " 50000 :  " << relinked_copy.size() << " ( " << relinked_expected.size()
+        << "),  " << same << ",  " << relinked_copy.bucket_count() << "\n";
+
+    std::cout << "\n====    rehash ====\n";
+
+    //      ,  , ,      
+    nstd::unordered_map<int, std::string> gradual;
+    gradual.set_incremental_rehash(4);
+    std::unordered_map<int, std::string> gradual_expected;
+    size_t rehashing_seen = 0, iterated_while_rehashing = 0, size_while_rehashing = 0;
+    for (int i = 0; i < 30000; i++) {
+        gradual[i] = std::to_string(i);
+        gradual_expected[i] = std::to_string(i);
+        if (i % 5 == 0) {
+            gradual.erase(i / 2);
+            gradual_expected.erase(i / 2);
+        }
+        if (gradual.rehashing()) {
+            rehashing_seen++;
+            if (!iterated_while_rehashing && gradual.bucket_count() > 1000) {
+                for (auto it = gradual.begin(); it != gradual.end(); ++it)
+                    iterated_while_rehashing++;
+                size_while_rehashing = gradual.size();
+            }
+        }
+    }
+    nstd::unordered_map<int, std::string> gradual_copy(gradual);
+    size_t gradual_same = 0;
+    for (const auto& item : gradual_expected) {
+        if (gradual.contains(item.first) && gradual_copy.contains(item.first) && gradual_copy[item.first] == item.second)
+            gradual_same++;
+    }
+    std::cout << "   rehash: " << rehashing_seen << " (  0),    rehash "
+        << iterated_while_rehashing << "  " << size_while_rehashing << "\n";
+    std::cout << " " << gradual.size() << " ( " << gradual_expected.size() << "),   ﳿ "
+        << gradual_same << "  " << gradual_expected.size() << "\n";
+
+    std::cout << "\n====   nstd::arena ====\n";
+
+    //      :   ,   free
+    nstd::arena batch_arena(16 * 1024);
+    {
+        using entry = nstd::pair<int, std::string>;
+        nstd::arena_allocator<entry> alloc(batch_arena);
+        nstd::unordered_map<int, std::string, nstd::arena_allocator<entry>> per_batch(alloc);
+        nstd::array<std::string, nstd::arena_allocator<std::string>> lines{ nstd::arena_allocator<std::string>(batch_arena) };
+        nstd::list<int, int, nstd::arena_allocator<nstd::pair<int, int>>> ids{ nstd::arena_allocator<nstd::pair<int, int>>(batch_arena) };
+        for (int i = 0; i < 5000; i++) {
+            per_batch[i] = "line " + std::to_string(i);
+            lines.push_back(per_batch[i]);
+            ids.insert(i % 50, i);
+        }
+        per_batch.erase(7);
+
+        nstd::unordered_map<int, std::string, nstd::arena_allocator<entry>> per_batch_copy(per_batch);
+        size_t same = 0;
+        for (int i = 0; i < 5000; i++)
+            same += per_batch_copy.contains(i) && per_batch_copy[i] == lines[i];
+        std::cout << "  :  " << per_batch.size() << " ( 4999),  ﳿ  " << same
+            << ",  " << lines.size() << ",    " << ids.size() << " ( 50)\n";
+        std::cout << ": " << batch_arena.blocks() << " , " << batch_arena.used() << " \n";
+    }
+    // rewind      
+    for (int batch = 0; batch < 3; batch++) {
+        {
+            nstd::array<long long, nstd::arena_allocator<long long>> values{ nstd::arena_allocator<long long>(batch_arena) };
+            for (int i = 0; i < 20000; i++)
+                values.push_back(i);
+        }
+        batch_arena.rewind();
+    }
+    std::cout << " rewind:  " << batch_arena.blocks() << " ( 1),  " << batch_arena.used() << " ( 0)\n";
+    batch_arena.release();
+    std::cout << " release:  " << batch_arena.blocks() << " ( 0)\n";
+
+    std::cout << "\n====   nstd::concurrent_unordered_map ====\n";
+
+    //      ,     
+    nstd::concurrent_unordered_map<int, long long> shared(8);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&shared, t] {
+            for (int i = 0; i < 20000; i++) {
+                shared.upsert(i % 100, [](long long& counter) { counter++; });
+                int own = 1000 + t * 100000 + i;
+                shared.insert_or_assign(own, i);
+                long long value = 0;
+                if (!shared.find(own, value) || value != i)
+                    std::cout << " " << t << "     " << own << "\n";
+                if (i % 2)
+                    shared.erase(own);
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    long long counted = 0;
+    size_t own_left = 0;
+    shared.for_each([&counted, &own_left](const int& key, const long long& value) {
+        if (key < 100)
+            counted += value;
+        else
+            own_left++;
+    });
+    bool updated = shared.update(5, [](long long& counter) { counter = -1; });
+    bool missing_updated = shared.update(-5, [](long long& counter) { counter = -1; });
+    long long fifth = 0;
+    shared.find(5, fifth);
+    std::cout << " " << shared.shard_count() << ",  " << counted << " ( 80000),   "
+        << own_left << " ( 40000),  " << shared.size() << " ( 40100)\n";
+    std::cout << "update: " << updated << " " << fifth << " ( 1 -1),   " << missing_updated
+        << " ( 0), contains(-5) " << shared.contains(-5) << " ( 0)\n";
+    bool not_erased = shared.erase_if(5, [](const long long& counter) { return counter != -1; });
+    bool erased = shared.erase_if(5, [](const long long& counter) { return counter == -1; });
+    std::cout << "erase_if: " << not_erased << " " << erased << " ( 0 1), contains(5) " << shared.contains(5) << " ( 0)\n";
+
+    std::cout << "\n====   nstd::spsc_ring ====\n";
+
+    //   ,     ,    
+    nstd::spsc_ring<long long, nstd::blocking_wait> pipe(64);
+    long long in_order = 0, received = 0;
+    std::thread spsc_consumer([&pipe, &in_order, &received] {
+        long long batch[32];
+        long long expected = 0;
+        while (expected < 200000) {
+            size_t count = pipe.pop_n(batch, expected % 3 ? 32 : 1);
+            for (size_t i = 0; i < count; i++)
+                in_order += batch[i] == expected++;
+            received += count;
+        }
+    });
+    long long next = 0;
+    while (next < 200000) {
+        long long batch[20];
+        size_t count = next % 7 ? 20 : 1;
+        if (count > static_cast<size_t>(200000 - next))
+            count = static_cast<size_t>(200000 - next);
+        for (size_t i = 0; i < count; i++)
+            batch[i] = next++;
+        pipe.push_n(batch, count);
+    }
+    spsc_consumer.join();
+    std::cout << " " << received << " ( 200000),   " << in_order << ",  " << pipe.size() << " ( 0)\n";
+
+    nstd::spsc_ring<std::string> texts(4);
+    size_t accepted = 0;
+    for (int i = 0; i < 6; i++)
+        accepted += texts.try_push(",      " + std::to_string(i));
+    std::string first;
+    texts.try_pop(first);
+    std::cout << " " << texts.capacity() << ",  " << accepted << " ( 4), : " << first << "\n";
+
+    std::cout << "\n====   nstd::mpmc_ring ====\n";
+
+    //  ,  :       
+    nstd::mpmc_ring<int, nstd::blocking_wait> shared_ring(128);
+    std::vector<long long> consumed_sums(4, 0), consumed_counts(4, 0);
+    std::vector<std::thread> ring_threads;
+    for (int c = 0; c < 4; c++) {
+        ring_threads.emplace_back([&shared_ring, &consumed_sums, &consumed_counts, c] {
+            int batch[16];
+            for (;;) {
+                size_t count = shared_ring.pop_n(batch, c % 2 ? 16 : 1);
+                for (size_t i = 0; i < count; i++) {
+                    if (batch[i] < 0) return;
+                    consumed_sums[c] += batch[i];
+                    consumed_counts[c]++;
+                }
+            }
+        });
+    }
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; p++) {
+        producers.emplace_back([&shared_ring, p] {
+            int batch[8];
+            for (int i = 0; i < 50000; i += 8) {
+                for (int j = 0; j < 8; j++)
+                    batch[j] = p * 50000 + i + j;
+                if (p % 2)
+                    shared_ring.push_n(batch, 8);
+                else
+                    for (int j = 0; j < 8; j++)
+                        shared_ring.push(batch[j]);
+            }
+        });
+    }
+    for (auto& producer : producers)
+        producer.join();
+    //     ',      ,
+    //     ,    
+    for (int c = 0; c < 4 * 16; c++)
+        shared_ring.push(-1);
+    for (auto& consumer : ring_threads)
+        consumer.join();
+
+    long long ring_sum = 0, ring_count = 0;
+    for (int c = 0; c < 4; c++) {
+        ring_sum += consumed_sums[c];
+        ring_count += consumed_counts[c];
+    }
+    std::cout << " " << ring_count << " ( 200000),  " << ring_sum << " ( 19999900000)\n";
+
+    nstd::mpmc_ring<std::string> leftovers(8);
+    leftovers.push("    ,  ");
+    std::cout << " " << leftovers.capacity() << ",  " << leftovers.size() << " ( 1)\n";
+
+    std::cout << "\n====     nstd::unordered_map ====\n";
+
+    //   string_view  const char*   std::string
+    nstd::unordered_map<std::string, int> by_name;
+    for (int i = 0; i < 3000; i++)
+        by_name["client-" + std::to_string(i)] = i;
+    by_name.erase(std::string("client-7"));
+
+    const char buffer[] = "client-42;client-7;client-2999;nobody";
+    std::string_view packet(buffer);
+    size_t found_views = 0;
+    int found_sum = 0;
+    while (!packet.empty()) {
+        size_t end = packet.find(';');
+        std::string_view name = packet.substr(0, end);
+        if (int* value = by_name.find(name)) {
+            found_views++;
+            found_sum += *value;
+        }
+        packet = end == std::string_view::npos ? std::string_view() : packet.substr(end + 1);
+    }
+    nstd::unordered_map<std::string, int> by_name_copy(by_name);
+    std::cout << "  string_view " << found_views << " ( 2),  " << found_sum << " ( 3041), "
+        << "contains(const char*) " << by_name.contains("client-1000") << by_name_copy.contains("client-1000")
+        << by_name.contains("client-7") << " ( 110)\n";
+
+    //      , rehash    
+    nstd::unordered_map<int, int, std::allocator<nstd::pair<int, int>>, counting_hash> counted_map;
+    for (int i = 0; i < 10000; i++)
+        counted_map[i] = i;
+    size_t hashed_on_insert = counting_hash::calls_;
+    counted_map.resize(100000);
+    std::cout << "   10000  " << hashed_on_insert << " ( 10000),  resize "
+        << counting_hash::calls_ << " ( 10000),  " << counted_map.bucket_count() << "\n";
+
+    std::cout << "\n====   nstd::flat_map ====\n";
+
+    //     std::lower_bound,     
+    std::vector<int> sorted_keys;
+    size_t bound_mismatches = 0;
+    for (int count = 0; count < 70; count++) {
+        sorted_keys.clear();
+        for (int i = 0; i < count; i++)
+            sorted_keys.push_back((i * 7 + count) % 23);
+        std::sort(sorted_keys.begin(), sorted_keys.end());
+        for (int key = -1; key < 25; key++) {
+            size_t expected = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), key) - sorted_keys.begin();
+            if (nstd::detail::branchless_lower_bound(sorted_keys.data(), sorted_keys.size(), key, std::less<int>()) != expected)
+                bound_mismatches++;
+        }
+    }
+    std::cout << "  std::lower_bound " << bound_mismatches << " ( 0)\n";
+
+    //   ,     
+    nstd::flat_map<int, std::string> codes = { { 30, "" }, { 10, "" }, { 20, "" }, { 10, "" } };
+    codes.insert(25, " '");
+    codes[5] = "'";
+    std::cout << " " << codes.size() << " ( 5),  :";
+    for (auto entry : codes)
+        std::cout << " " << entry.key_ << "=" << entry.value_;
+    std::cout << "\n";
+    std::cout << "  " << codes.insert(20, " ") << ", erase(20) " << codes.erase(20) << ", erase(21) " << codes.erase(21)
+        << ", find(20) " << (codes.find(20) != nullptr) << ", 10=" << *codes.find(10) << " ( 010, 10=)\n";
+
+    //     ,    
+    std::vector<nstd::pair<int, std::string>> batch_codes;
+    for (int i = 0; i < 40; i += 3)
+        batch_codes.emplace_back(i, "");
+    codes.insert(batch_codes.begin(), batch_codes.end());
+    bool codes_sorted = true;
+    for (size_t i = 1; i < codes.keys().size(); i++)
+        codes_sorted = codes_sorted && codes.keys()[i - 1] < codes.keys()[i];
+    std::cout << "   " << codes.size() << " ( 17),  " << codes_sorted
+        << ", 30=" << *codes.find(30) << " ( )\n";
+
+    //   string_view   
+    nstd::flat_map<std::string, int, std::less<>> commands = { { "move", 1 }, { "chat", 2 }, { "login", 3 } };
+    std::string_view command_view("login;");
+    int* command = commands.find(command_view.substr(0, 5));
+    std::cout << "login=" << (command ? *command : 0) << ", contains(\"quit\") " << commands.contains("quit") << " ( 3, 0)\n";
+
+    nstd::flat_set<int> ids = { 8, 3, 8, 1, 5, 3 };
+    ids.insert(4);
+    ids.erase(8);
+    std::cout << ":";
+    for (int id : ids)
+        std::cout << " " << id;
+    std::cout << " ( 1 3 4 5), contains(5) " << ids.contains(5) << " contains(8) " << ids.contains(8) << "\n";
 }
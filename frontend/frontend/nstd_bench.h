@@ -0,0 +1,650 @@
+#pragma once
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "nstd/array.h"
+#include "nstd/small_array.h"
+#include "nstd/unordered_map.h"
+#include "nstd/swiss_map.h"
+#include "nstd/node_pool.h"
+#include "nstd/arena.h"
+#include "nstd/concurrent_unordered_map.h"
+#include "nstd/spsc_ring.h"
+#include "nstd/mpmc_ring.h"
+#include "nstd/flat_map.h"
+
+// the same calls on nstd and std maps, std::unordered_map spells insert and lookup differently
+template<class Map, class K>
+static void map_put(Map& map, const K& key, int value) { map[key] = value; }
+
+template<class Map, class K>
+static bool map_has(Map& map, const K& key) { return map.contains(key); }
+
+template<class K>
+static bool map_has(std::unordered_map<K, int>& map, const K& key) { return map.find(key) != map.end(); }
+
+template<class Map>
+static long long map_sum(Map& map)
+{
+	long long sum = 0;
+	for (auto it = map.begin(); it != map.end(); ++it)
+		sum += it->value_;
+	return sum;
+}
+
+template<class K>
+static long long map_sum(std::unordered_map<K, int>& map)
+{
+	long long sum = 0;
+	for (auto& item : map)
+		sum += item.second;
+	return sum;
+}
+
+// ns per operation for insert, lookups that hit, lookups that miss, iteration and erase
+template<class Map, class K>
+static void bench_map(const char* name, const std::vector<K>& keys, const std::vector<K>& missing)
+{
+	using clock = std::chrono::steady_clock;
+	auto ns = [](clock::time_point begin, clock::time_point end, size_t count) {
+		return std::chrono::duration<double, std::nano>(end - begin).count() / count;
+	};
+
+	Map map;
+	auto begin = clock::now();
+	for (size_t i = 0; i < keys.size(); i++)
+		map_put(map, keys[i], static_cast<int>(i));
+	auto inserted = clock::now();
+
+	size_t found = 0;
+	for (int round = 0; round < 4; round++) {
+		for (const K& key : keys)
+			found += map_has(map, key);
+	}
+	auto hit = clock::now();
+
+	for (int round = 0; round < 4; round++) {
+		for (const K& key : missing)
+			found += map_has(map, key);
+	}
+	auto missed = clock::now();
+
+	long long sum = 0;
+	for (int round = 0; round < 4; round++)
+		sum += map_sum(map);
+	auto iterated = clock::now();
+
+	for (const K& key : keys)
+		map.erase(key);
+	auto erased = clock::now();
+
+	std::cout << name << ": insert " << ns(begin, inserted, keys.size())
+		<< " ns, hit " << ns(inserted, hit, 4 * keys.size())
+		<< " ns, miss " << ns(hit, missed, 4 * missing.size())
+		<< " ns, iterate " << ns(missed, iterated, 4 * keys.size())
+		<< " ns, erase " << ns(iterated, erased, keys.size())
+		<< " ns (found " << found << ", sum " << sum << ")\n";
+}
+
+template<class K>
+static void bench_maps(const std::vector<K>& keys, const std::vector<K>& missing)
+{
+	bench_map<nstd::unordered_map<K, int>>("nstd::unordered_map", keys, missing);
+	bench_map<nstd::swiss_map<K, int>>("nstd::swiss_map    ", keys, missing);
+	bench_map<std::unordered_map<K, int>>("std::unordered_map ", keys, missing);
+}
+
+// fill and clear cycles: nodes from new/delete vs from a node_pool, and a map
+// that rehashes its way up from the default bucket count every cycle
+static void bench_node_pool()
+{
+	using clock = std::chrono::steady_clock;
+	constexpr int cycles = 50;
+	constexpr int lists_count = 10000;
+	constexpr int nodes = 8; // about what a bucket holds
+
+	nstd::node_pool<nstd::Node<int, int>> pool;
+	for (bool pooled : { false, true }) {
+		std::vector<nstd::list<int, int>> lists;
+		for (int i = 0; i < lists_count; i++)
+			lists.emplace_back(pooled ? &pool : nullptr);
+
+		auto begin = clock::now();
+		for (int cycle = 0; cycle < cycles; cycle++) {
+			for (int node = 0; node < nodes; node++) {
+				for (auto& list : lists)
+					list.insert(node, cycle);
+			}
+			for (auto& list : lists)
+				list.clear();
+		}
+		double ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+		std::cout << (pooled ? "lists, node_pool:  " : "lists, new/delete: ") << ns / cycles / lists_count / nodes << " ns per node\n";
+	}
+
+	for (size_t count : { 1000, 100000, 1000000 }) {
+		nstd::unordered_map<int, int> map;
+		int rounds = static_cast<int>(2000000 / count);
+		auto begin = clock::now();
+		for (int round = 0; round < rounds; round++) {
+			for (size_t i = 0; i < count; i++)
+				map[static_cast<int>(i * 2654435761u)] = static_cast<int>(i);
+			map.clear();
+		}
+		double ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+		std::cout << "unordered_map fill to " << count << " and clear: " << ns / rounds / count << " ns per element\n";
+	}
+}
+
+// latency of every single insert while a map grows to 1M keys: with a rehash inside
+// the insert that fills the table, and spread over the operations that follow it
+static void bench_rehash_latency()
+{
+	using clock = std::chrono::steady_clock;
+	constexpr size_t count = 1000000;
+
+	for (size_t step : { 0, 1, 4, 16 }) {
+		nstd::unordered_map<int, int> map;
+		map.set_incremental_rehash(step);
+		std::vector<double> latencies(count);
+
+		auto total_begin = clock::now();
+		for (size_t i = 0; i < count; i++) {
+			auto begin = clock::now();
+			map[static_cast<int>(i * 2654435761u)] = static_cast<int>(i);
+			latencies[i] = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+		}
+		double total = std::chrono::duration<double, std::milli>(clock::now() - total_begin).count();
+
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (count - 1))]; };
+		std::cout << (step ? "incremental, " + std::to_string(step) + " buckets/op: " : "rehash in one insert:     ")
+			<< "p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, p99.9 " << percentile(0.999)
+			<< " ns, p99.99 " << percentile(0.9999) << " ns, p99.999 " << percentile(0.99999) / 1e3 << " us, max " << latencies.back() / 1e3 << " us, total " << total << " ms\n";
+	}
+}
+
+// a record like the ones logsdir batches: a few numbers and an owned string
+struct bench_record {
+	long long time_stamp_ = 0;
+	int level_ = 0;
+	std::string text_;
+
+	bench_record() = default;
+	bench_record(long long time_stamp, int level, const std::string& text)
+		: time_stamp_(time_stamp), level_(level), text_(text) {}
+};
+
+// ns per element to fill an array from empty, growth included, and to copy it once
+template<class Array, class T, class Make>
+static void bench_array(const char* name, size_t count, Make make)
+{
+	using clock = std::chrono::steady_clock;
+	constexpr int rounds = 20;
+
+	double push = 0, emplace = 0, copy = 0;
+	size_t check = 0;
+	for (int round = 0; round < rounds; round++) {
+		auto begin = clock::now();
+		Array pushed;
+		for (size_t i = 0; i < count; i++) {
+			T value = make(i);
+			pushed.push_back(value);
+		}
+		auto pushed_end = clock::now();
+
+		Array emplaced;
+		for (size_t i = 0; i < count; i++)
+			emplaced.emplace_back(make(i));
+		auto emplaced_end = clock::now();
+
+		Array copied(emplaced);
+		auto copied_end = clock::now();
+
+		push += std::chrono::duration<double, std::nano>(pushed_end - begin).count();
+		emplace += std::chrono::duration<double, std::nano>(emplaced_end - pushed_end).count();
+		copy += std::chrono::duration<double, std::nano>(copied_end - emplaced_end).count();
+		check += pushed.size() + copied.size();
+	}
+
+	double per = static_cast<double>(rounds) * count;
+	std::cout << name << ": push_back " << push / per << " ns, emplace_back " << emplace / per
+		<< " ns, copy " << copy / per << " ns (" << check << ")\n";
+}
+
+template<class T, class Make>
+static void bench_arrays(const char* type, size_t count, Make make)
+{
+	std::cout << count << " " << type << ":\n";
+	bench_array<nstd::array<T>, T>("nstd::array", count, make);
+	bench_array<std::vector<T>, T>("std::vector", count, make);
+}
+
+// many short-lived arrays of a few elements, like the fields of one log line
+template<class Array>
+static void bench_short_lived(const char* name, size_t elements)
+{
+	using clock = std::chrono::steady_clock;
+	constexpr size_t count = 1000000;
+
+	long long sum = 0;
+	auto begin = clock::now();
+	for (size_t i = 0; i < count; i++) {
+		Array fields;
+		for (size_t e = 0; e < elements; e++)
+			fields.push_back(static_cast<long long>(i + e));
+		for (size_t e = 0; e < fields.size(); e++)
+			sum += fields[e];
+	}
+	double ns = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+	std::cout << name << ", " << elements << " elements: " << ns / count << " ns per array (" << sum << ")\n";
+}
+
+// per-batch containers: a map of the batch's records and the fields of every record,
+// built for one batch and dropped after it, from the heap and from an arena that
+// is rewound once per batch instead of freeing every field array on its own
+static void bench_arena()
+{
+	using clock = std::chrono::steady_clock;
+	using entry = nstd::pair<int, int>;
+	using arena_fields = nstd::array<int, nstd::arena_allocator<int>>;
+
+	for (size_t count : { 100, 1000, 10000 }) {
+		size_t batches = 1000000 / count;
+		long long check = 0;
+
+		auto begin = clock::now();
+		for (size_t batch = 0; batch < batches; batch++) {
+			nstd::unordered_map<int, int> map;
+			nstd::array<nstd::array<int>> fields;
+			for (size_t i = 0; i < count; i++) {
+				map[static_cast<int>(i * 7)] = static_cast<int>(i);
+				nstd::array<int>& record = fields.emplace_back();
+				for (int field = 0; field < 6; field++)
+					record.push_back(field);
+			}
+			check += map.size() + fields.size();
+		}
+		auto heap_end = clock::now();
+
+		nstd::arena arena;
+		for (size_t batch = 0; batch < batches; batch++) {
+			{
+				nstd::unordered_map<int, int, nstd::arena_allocator<entry>> map{ nstd::arena_allocator<entry>(arena) };
+				nstd::array<arena_fields, nstd::arena_allocator<arena_fields>> fields{ nstd::arena_allocator<arena_fields>(arena) };
+				for (size_t i = 0; i < count; i++) {
+					map[static_cast<int>(i * 7)] = static_cast<int>(i);
+					arena_fields& record = fields.emplace_back(nstd::arena_allocator<int>(arena));
+					for (int field = 0; field < 6; field++)
+						record.push_back(field);
+				}
+				check += map.size() + fields.size();
+			}
+			arena.rewind();
+		}
+		auto arena_end = clock::now();
+
+		double per = static_cast<double>(batches) * count;
+		std::cout << count << " records per batch: heap " << std::chrono::duration<double, std::nano>(heap_end - begin).count() / per
+			<< " ns, arena " << std::chrono::duration<double, std::nano>(arena_end - heap_end).count() / per
+			<< " ns per record (" << check << ")\n";
+	}
+}
+
+// per-client counters shared by connection threads: 9 lookups to 1 increment over
+// 100000 keys, the same total work split over 1..N threads. One mutex around an
+// nstd::unordered_map against the sharded map.
+template<class Find, class Bump>
+static double run_shared_map(unsigned threads, size_t operations, Find find, Bump bump)
+{
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (unsigned t = 0; t < threads; t++) {
+		workers.emplace_back([=] {
+			unsigned seed = 17 + t;
+			for (size_t i = 0; i < operations / threads; i++) {
+				seed = seed * 1103515245u + 12345u;
+				int key = static_cast<int>((seed >> 8) % 100000);
+				if (i % 10)
+					find(key);
+				else
+					bump(key);
+			}
+		});
+	}
+	for (auto& worker : workers)
+		worker.join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return operations / seconds / 1e6;
+}
+
+static void bench_concurrent()
+{
+	constexpr size_t operations = 4000000;
+	unsigned hardware = std::thread::hardware_concurrency();
+	std::cout << "hardware threads: " << hardware << "\n";
+
+	for (unsigned threads = 1; threads <= (hardware > 8 ? hardware : 8); threads *= 2) {
+		std::mutex mutex;
+		nstd::unordered_map<int, long long> locked;
+		nstd::concurrent_unordered_map<int, long long> sharded;
+		for (int key = 0; key < 100000; key++) {
+			locked[key] = 0;
+			sharded.insert_or_assign(key, 0);
+		}
+
+		double one_mutex = run_shared_map(threads, operations,
+			[&](int key) { std::lock_guard<std::mutex> lock(mutex); return locked.find(key) != nullptr; },
+			[&](int key) { std::lock_guard<std::mutex> lock(mutex); locked[key]++; });
+		double striped = run_shared_map(threads, operations,
+			[&](int key) { long long value; return sharded.find(key, value); },
+			[&](int key) { sharded.upsert(key, [](long long& counter) { counter++; }); });
+
+		std::cout << threads << " threads: one mutex " << one_mutex << " Mops/s, concurrent_unordered_map (" << sharded.shard_count()
+			<< " shards) " << striped << " Mops/s\n";
+	}
+}
+
+// the queue every pipeline used before the rings: a deque behind a mutex and a condition variable
+template<class T>
+class locked_queue {
+private:
+	std::mutex mutex_;
+	std::condition_variable ready_;
+	std::deque<T> items_;
+
+public:
+	void push_n(T* items, size_t count)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			items_.insert(items_.end(), items, items + count);
+		}
+		ready_.notify_all();
+	}
+
+	size_t pop_n(T* out, size_t max)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		ready_.wait(lock, [this] { return !items_.empty(); });
+		size_t count = 0;
+		while (count < max && !items_.empty()) {
+			out[count++] = items_.front();
+			items_.pop_front();
+		}
+		return count;
+	}
+};
+
+// millions of elements per second from producers to consumers, batch elements per call
+template<class Queue>
+static void bench_ring_throughput(const char* name, Queue& queue, int producers, int consumers, size_t batch)
+{
+	constexpr long long count = 2000000;
+	long long per_producer = count / producers;
+
+	auto begin = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	std::vector<long long> sums(consumers, 0);
+	for (int c = 0; c < consumers; c++) {
+		threads.emplace_back([&queue, &sums, c, batch] {
+			long long items[64];
+			for (;;) {
+				size_t popped = queue.pop_n(items, batch);
+				for (size_t i = 0; i < popped; i++) {
+					if (items[i] < 0) return;
+					sums[c] += items[i];
+				}
+			}
+		});
+	}
+	for (int p = 0; p < producers; p++) {
+		threads.emplace_back([&queue, per_producer, batch] {
+			long long items[64];
+			for (long long i = 0; i < per_producer; i += batch) {
+				size_t n = static_cast<size_t>(std::min<long long>(batch, per_producer - i));
+				for (size_t j = 0; j < n; j++)
+					items[j] = i + j;
+				queue.push_n(items, n);
+			}
+		});
+	}
+	for (int p = 0; p < producers; p++)
+		threads[consumers + p].join();
+	// a consumer stops at the first stop mark, but one pop_n may carry several of them
+	std::vector<long long> stops(consumers * batch, -1);
+	queue.push_n(stops.data(), stops.size());
+	for (int c = 0; c < consumers; c++)
+		threads[c].join();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+	long long sum = 0;
+	for (long long part : sums)
+		sum += part;
+	std::cout << name << " " << producers << "p/" << consumers << "c, batch " << batch << ": "
+		<< count / seconds / 1e6 << " M/s (" << sum << ")\n";
+}
+
+// round trip of one element over a pair of rings, ping and pong on two threads
+template<class Ring>
+static void bench_ring_latency(const char* name)
+{
+	constexpr size_t rounds = 100000;
+	Ring ping(64), pong(64);
+	std::vector<double> latencies(rounds);
+
+	std::thread echo([&ping, &pong] {
+		for (size_t i = 0; i < rounds; i++) {
+			long long value = 0;
+			ping.pop(value);
+			pong.push(value);
+		}
+	});
+	for (size_t i = 0; i < rounds; i++) {
+		auto begin = std::chrono::steady_clock::now();
+		long long value = static_cast<long long>(i);
+		ping.push(value);
+		pong.pop(value);
+		latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+	}
+	echo.join();
+
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) { return latencies[static_cast<size_t>(p * (rounds - 1))] / 1e3; };
+	std::cout << name << ": round trip p50 " << percentile(0.5) << " us, p99 " << percentile(0.99)
+		<< " us, p99.9 " << percentile(0.999) << " us\n";
+}
+
+static void bench_rings()
+{
+	std::cout << "hardware threads: " << std::thread::hardware_concurrency() << "\n";
+	for (size_t batch : { 1, 32 }) {
+		nstd::spsc_ring<long long> spin_spsc(1024);
+		bench_ring_throughput("spsc_ring, spin_wait    ", spin_spsc, 1, 1, batch);
+		nstd::spsc_ring<long long, nstd::blocking_wait> blocking_spsc(1024);
+		bench_ring_throughput("spsc_ring, blocking_wait", blocking_spsc, 1, 1, batch);
+		nstd::mpmc_ring<long long, nstd::blocking_wait> blocking_mpmc(1024);
+		bench_ring_throughput("mpmc_ring, blocking_wait", blocking_mpmc, 1, 1, batch);
+		locked_queue<long long> locked;
+		bench_ring_throughput("mutex + std::deque      ", locked, 1, 1, batch);
+	}
+	for (size_t batch : { 1, 32 }) {
+		nstd::mpmc_ring<long long, nstd::blocking_wait> blocking_mpmc(1024);
+		bench_ring_throughput("mpmc_ring, blocking_wait", blocking_mpmc, 4, 4, batch);
+		locked_queue<long long> locked;
+		bench_ring_throughput("mutex + std::deque      ", locked, 4, 4, batch);
+	}
+
+	bench_ring_latency<nstd::spsc_ring<long long>>("spsc_ring, spin_wait    ");
+	bench_ring_latency<nstd::spsc_ring<long long, nstd::blocking_wait>>("spsc_ring, blocking_wait");
+	bench_ring_latency<nstd::mpmc_ring<long long, nstd::blocking_wait>>("mpmc_ring, blocking_wait");
+}
+
+// string keys as a parser sees them, views into a received buffer: looked up through a
+// temporary std::string and directly, then the whole table rehashed to 4x the buckets
+static void bench_string_lookup()
+{
+	using clock = std::chrono::steady_clock;
+
+	for (size_t count : { 1000, 100000 }) {
+		nstd::unordered_map<std::string, int> map;
+		std::string buffer;
+		std::vector<std::pair<size_t, size_t>> names;
+		for (size_t i = 0; i < count; i++) {
+			std::string name = "client-" + std::to_string(i * 7919) + "-connected-from-a-long-enough-address";
+			map[name] = static_cast<int>(i);
+			names.emplace_back(buffer.size(), name.size());
+			buffer += name;
+		}
+
+		constexpr int rounds = 10;
+		long long sum = 0;
+		auto begin = clock::now();
+		for (int round = 0; round < rounds; round++) {
+			for (auto& name : names) {
+				std::string_view view(buffer.data() + name.first, name.second);
+				sum += *map.find(std::string(view));
+			}
+		}
+		auto through_string = clock::now();
+		for (int round = 0; round < rounds; round++) {
+			for (auto& name : names) {
+				std::string_view view(buffer.data() + name.first, name.second);
+				sum += *map.find(view);
+			}
+		}
+		auto direct = clock::now();
+		map.resize(map.bucket_count() * 4);
+		auto rehashed = clock::now();
+
+		double per = static_cast<double>(rounds) * count;
+		std::cout << count << " keys: find(std::string(view)) " << std::chrono::duration<double, std::nano>(through_string - begin).count() / per
+			<< " ns, find(view) " << std::chrono::duration<double, std::nano>(direct - through_string).count() / per
+			<< " ns, rehash " << std::chrono::duration<double, std::nano>(rehashed - direct).count() / count << " ns per key (" << sum << ")\n";
+	}
+}
+
+// ns per lookup on one map, the probes are half hits and half misses in random order
+template<class Map, class K>
+static double time_lookups(Map& map, const std::vector<K>& probes, size_t lookups, long long& found)
+{
+	using clock = std::chrono::steady_clock;
+
+	auto begin = clock::now();
+	for (size_t done = 0; done < lookups; done += probes.size())
+		for (const K& key : probes)
+			found += map_has(map, key);
+	auto end = clock::now();
+
+	size_t rounds = (lookups + probes.size() - 1) / probes.size();
+	return std::chrono::duration<double, std::nano>(end - begin).count() / (rounds * probes.size());
+}
+
+template<class K, class Make>
+static void bench_flat_lookup(const char* type, Make make)
+{
+	constexpr size_t lookups = 1 << 20;
+
+	for (size_t count : { 4, 8, 16, 32, 64, 128, 256, 512, 1024, 4096 }) {
+		nstd::flat_map<K, int> flat;
+		nstd::unordered_map<K, int> chained;
+		nstd::swiss_map<K, int> swiss;
+		std::vector<K> probes;
+		unsigned seed = 11;
+		for (size_t i = 0; i < count; i++) {
+			seed = seed * 1103515245u + 12345u;
+			K key = make(seed | 1);
+			map_put(flat, key, static_cast<int>(i));
+			map_put(chained, key, static_cast<int>(i));
+			map_put(swiss, key, static_cast<int>(i));
+			probes.push_back(key);
+			probes.push_back(make(seed & ~1u));
+		}
+		for (size_t i = probes.size() - 1; i > 0; i--) {
+			seed = seed * 1103515245u + 12345u;
+			std::swap(probes[i], probes[(seed >> 8) % (i + 1)]);
+		}
+
+		long long found = 0;
+		double flat_ns = time_lookups(flat, probes, lookups, found);
+		double chained_ns = time_lookups(chained, probes, lookups, found);
+		double swiss_ns = time_lookups(swiss, probes, lookups, found);
+		std::cout << count << " " << type << " keys: flat_map " << flat_ns << " ns, unordered_map " << chained_ns
+			<< " ns, swiss_map " << swiss_ns << " ns per lookup (" << found << ")\n";
+	}
+}
+
+// chained nstd::unordered_map vs open addressing nstd::swiss_map vs std::unordered_map
+void nstd_bench() {
+	std::cout << "==== nstd::unordered_map vs nstd::swiss_map ====\n";
+
+	for (size_t count : { 1000, 100000, 1000000 }) {
+		std::vector<int> keys, missing;
+		unsigned seed = 7;
+		for (size_t i = 0; i < count; i++) {
+			seed = seed * 1103515245u + 12345u;
+			keys.push_back(static_cast<int>(seed & 0x7fffffff) | 1);
+			missing.push_back(static_cast<int>(seed & 0x7fffffff) & ~1);
+		}
+
+		std::cout << count << " int keys:\n";
+		bench_maps(keys, missing);
+	}
+
+	for (size_t count : { 1000, 100000 }) {
+		std::vector<std::string> keys, missing;
+		for (size_t i = 0; i < count; i++) {
+			keys.push_back("session-" + std::to_string(i * 7919));
+			missing.push_back("session-" + std::to_string(i * 7919 + 1));
+		}
+
+		std::cout << count << " string keys:\n";
+		bench_maps(keys, missing);
+	}
+
+	std::cout << "\n==== nstd::node_pool ====\n";
+	bench_node_pool();
+
+	std::cout << "\n==== nstd::unordered_map insert latency ====\n";
+	bench_rehash_latency();
+
+	std::cout << "\n==== nstd::array vs std::vector ====\n";
+	for (size_t count : { 1000, 100000 }) {
+		bench_arrays<int>("ints", count, [](size_t i) { return static_cast<int>(i); });
+		bench_arrays<std::string>("strings", count, [](size_t i) { return "client-" + std::to_string(i) + " connected from a long enough address"; });
+		bench_arrays<bench_record>("records", count, [](size_t i) {
+			return bench_record(static_cast<long long>(i), static_cast<int>(i % 5), "request " + std::to_string(i) + " took a while to complete");
+		});
+	}
+
+	std::cout << "\n==== nstd::arena ====\n";
+	bench_arena();
+
+	std::cout << "\n==== nstd::concurrent_unordered_map ====\n";
+	bench_concurrent();
+
+	std::cout << "\n==== nstd::unordered_map string_view lookups ====\n";
+	bench_string_lookup();
+
+	std::cout << "\n==== nstd::spsc_ring / nstd::mpmc_ring ====\n";
+	bench_rings();
+
+	std::cout << "\n==== nstd::small_array ====\n";
+	for (size_t elements : { 2, 6, 8, 16 }) {
+		bench_short_lived<nstd::array<long long>>("nstd::array            ", elements);
+		bench_short_lived<nstd::small_array<long long, 8>>("nstd::small_array<T, 8>", elements);
+		bench_short_lived<std::vector<long long>>("std::vector            ", elements);
+	}
+
+	std::cout << "\n==== nstd::flat_map vs hash maps by size ====\n";
+	bench_flat_lookup<int>("int", [](unsigned seed) { return static_cast<int>(seed & 0x7fffffff); });
+	bench_flat_lookup<std::string>("string", [](unsigned seed) { return "player-" + std::to_string(seed & 0x7fffffff); });
+}